@@ -0,0 +1,248 @@
+#include "Affinity.hpp"
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+
+static const char *__NODE_DIR__ = "/sys/devices/system/node";
+
+// "0-3,8,10-11" 같은 sysfs의 CPU 목록을 파싱.
+static std::vector<int> __parseCpuList (const std::string &str) {
+  std::vector<int> ret;
+  std::stringstream ss(str);
+  std::string token;
+
+  while (std::getline(ss, token, ',')) {
+    const auto dash = token.find('-');
+    int first, last;
+
+    if (token.empty() || token == "\n") {
+      continue;
+    }
+    first = std::atoi(token.c_str());
+    last = dash == std::string::npos ? first : std::atoi(token.c_str() + dash + 1);
+    for (int cpu = first; cpu <= last; cpu += 1) {
+      ret.push_back(cpu);
+    }
+  }
+
+  return ret;
+}
+
+CpuTopology::CpuTopology () {
+  std::map<int, std::vector<int>> nodes;
+  std::vector<int> allowed;
+  cpu_set_t set;
+  DIR *dir;
+
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu += 1) {
+      if (CPU_ISSET(cpu, &set)) {
+        allowed.push_back(cpu);
+      }
+    }
+  }
+
+  // 노드마다 "nodeN/cpulist". 쓸 수 없는 CPU는 뺌.
+  dir = ::opendir(__NODE_DIR__);
+  if (dir != nullptr) {
+    struct dirent *ent;
+
+    while ((ent = ::readdir(dir)) != nullptr) {
+      std::string line;
+      int node;
+
+      if (std::strncmp(ent->d_name, "node", 4) != 0 ||
+          ent->d_name[4] < '0' || ent->d_name[4] > '9') {
+        continue;
+      }
+      node = std::atoi(ent->d_name + 4);
+
+      std::ifstream in(std::string(__NODE_DIR__) + '/' + ent->d_name + "/cpulist");
+
+      if (!std::getline(in, line)) {
+        continue;
+      }
+      for (const auto &cpu : __parseCpuList(line)) {
+        if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+          nodes[node].push_back(cpu);
+        }
+      }
+    }
+    ::closedir(dir);
+  }
+
+  // 어느 노드에도 없는 CPU는 노드 0에 있는 것으로 봄.
+  for (const auto &cpu : allowed) {
+    bool found = false;
+
+    for (const auto &p : nodes) {
+      if (std::find(p.second.begin(), p.second.end(), cpu) != p.second.end()) {
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      nodes[0].push_back(cpu);
+    }
+  }
+
+  for (auto &p : nodes) {
+    if (p.second.empty()) {
+      continue;
+    }
+    std::sort(p.second.begin(), p.second.end());
+    for (const auto &cpu : p.second) {
+      this->__cpus.push_back(std::make_pair(cpu, p.first));
+    }
+    this->__nodes.push_back(std::move(p));
+  }
+  std::sort(this->__cpus.begin(), this->__cpus.end());
+}
+
+const CpuTopology &CpuTopology::get () {
+  static const CpuTopology instance;
+
+  return instance;
+}
+
+CpuPlacement CpuTopology::place (const AffinityPolicy policy, const size_t slot) const {
+  CpuPlacement ret;
+
+  if (this->__cpus.empty()) {
+    return ret;
+  }
+
+  switch (policy) {
+  case AFFINITY_ROUND_ROBIN:
+    ret.cpu = this->__cpus[slot % this->__cpus.size()].first;
+    ret.node = this->__cpus[slot % this->__cpus.size()].second;
+    break;
+  case AFFINITY_COMPACT: {
+    // 노드 순으로 늘어놓은 CPU에서 `slot`번째.
+    auto i = slot % this->__cpus.size();
+
+    for (const auto &p : this->__nodes) {
+      if (i < p.second.size()) {
+        ret.cpu = p.second[i];
+        ret.node = p.first;
+        break;
+      }
+      i -= p.second.size();
+    }
+    break;
+  }
+  case AFFINITY_SCATTER: {
+    const auto &p = this->__nodes[slot % this->__nodes.size()];
+
+    ret.cpu = p.second[(slot / this->__nodes.size()) % p.second.size()];
+    ret.node = p.first;
+    break;
+  }
+  default:
+    break;
+  }
+
+  return ret;
+}
+
+bool CpuTopology::pin (const CpuPlacement &at, const AffinityScope scope) const {
+  cpu_set_t set;
+  int ec;
+
+  if (at.cpu < 0) {
+    errno = EINVAL;
+    return false;
+  }
+
+  CPU_ZERO(&set);
+  if (scope == AFFINITY_SCOPE_NODE) {
+    for (const auto &p : this->__nodes) {
+      if (p.first == at.node) {
+        for (const auto &cpu : p.second) {
+          CPU_SET(cpu, &set);
+        }
+      }
+    }
+  } else {
+    CPU_SET(at.cpu, &set);
+  }
+
+  ec = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+  if (ec != 0) {
+    errno = ec;
+    return false;
+  }
+  return true;
+}
+
+CpuPlacement placeThread (const size_t slot) {
+  return CpuTopology::get().place(::affinityPolicy, slot);
+}
+
+bool pinThread (const CpuPlacement &at) {
+  static std::atomic<bool> reported(false);
+
+  if (at.cpu < 0 || CpuTopology::get().pin(at, ::affinityScope)) {
+    return true;
+  }
+
+  if (!reported.exchange(true)) {
+    const auto err = errno;
+    std::lock_guard<std::mutex> lg(::stdioLock);
+
+    std::cerr << "* Could not pin a thread to CPU " << at.cpu << ": "
+              << std::strerror(err) << std::endl;
+  }
+  return false;
+}
+
+bool bindMemory (void *addr, const size_t len, const int node) {
+  const auto page = (uintptr_t)::sysconf(_SC_PAGESIZE);
+  const auto start = (uintptr_t)addr & ~(page - 1);
+  const auto end = ((uintptr_t)addr + len + page - 1) & ~(page - 1);
+  const size_t bits = sizeof(unsigned long) * 8;
+  std::vector<unsigned long> mask;
+
+  if (node < 0) {
+    errno = EINVAL;
+    return false;
+  }
+
+  mask.assign((size_t)node / bits + 1, 0);
+  mask[(size_t)node / bits] |= 1UL << ((size_t)node % bits);
+  // 다른 노드의 메모리가 모자라도 실패하지 않도록 `MPOL_BIND` 대신 선호만 함.
+  return ::syscall(SYS_mbind, (void*)start, end - start, MPOL_PREFERRED,
+                   mask.data(), mask.size() * bits + 1, MPOL_MF_MOVE) == 0;
+}
+
+void *PageAligned::operator new (const size_t size) {
+  const auto page = (size_t)::sysconf(_SC_PAGESIZE);
+  void *ret;
+
+  if (::posix_memalign(&ret, page, (size + page - 1) & ~(page - 1)) != 0) {
+    throw std::bad_alloc();
+  }
+  return ret;
+}
+
+void PageAligned::operator delete (void *ptr) noexcept {
+  std::free(ptr);
+}
@@ -0,0 +1,65 @@
+#ifndef AFFINITY_H_
+#define AFFINITY_H_
+#include "Globals.hpp"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// 스레드 하나를 둘 자리.
+struct CpuPlacement {
+  // -1이면 묶지 않음.
+  int cpu = -1;
+  // `cpu`가 있는 NUMA 노드 번호(sysfs의 번호).
+  int node = -1;
+};
+
+// 이 프로세스가 쓸 수 있는 CPU와 그 NUMA 노드. 처음 `get()`할 때
+// `sched_getaffinity()`와 sysfs(`/sys/devices/system/node`)를 한 번 읽는다. NUMA
+// 정보가 없으면 모든 CPU가 노드 0에 있는 것으로 본다.
+class CpuTopology {
+protected:
+  // 노드 번호 순으로 (노드, 쓸 수 있는 CPU들). CPU는 번호 순. 빈 노드는 뺌.
+  std::vector<std::pair<int, std::vector<int>>> __nodes;
+  // CPU 번호 순으로 (CPU, 노드).
+  std::vector<std::pair<int, int>> __cpus;
+
+  CpuTopology ();
+
+public:
+  static const CpuTopology &get ();
+
+  size_t cpuCount () const {
+    return this->__cpus.size();
+  }
+
+  size_t nodeCount () const {
+    return this->__nodes.size();
+  }
+
+  // `slot`번째 스레드를 `policy`대로 둘 자리. 자리보다 스레드가 많으면 처음부터 다시
+  // 돈다. `AFFINITY_NONE`이면 묶지 않는 자리.
+  CpuPlacement place (const AffinityPolicy policy, const size_t slot) const;
+  // 지금 스레드를 `at`에 묶음. `scope`가 `AFFINITY_SCOPE_NODE`면 그 노드의 모든
+  // CPU에. 실패하면 `errno`를 남기고 거짓.
+  bool pin (const CpuPlacement &at, const AffinityScope scope) const;
+};
+
+// `::affinityPolicy`대로 `slot`번째 스레드를 둘 자리.
+CpuPlacement placeThread (const size_t slot);
+// 지금 스레드를 `::affinityScope`대로 `at`에 묶음. 묶지 않는 자리면 아무것도 하지
+// 않음. 실패하면 처음 한 번만 표준 에러로 알리고 거짓.
+bool pinThread (const CpuPlacement &at);
+// `[addr, addr + len)`의 페이지를 NUMA 노드 `node`에 두도록 하고, 이미 다른 노드에
+// 있는 페이지는 옮김. 페이지 단위로 할당한 메모리여야 한다(`PageAligned`). 커널이
+// NUMA를 지원하지 않으면 `errno`를 남기고 거짓.
+bool bindMemory (void *addr, const size_t len, const int node);
+
+// 상속하면 `new`가 객체를 페이지 경계에서 시작해 페이지 단위로 할당하므로,
+// `bindMemory()`로 객체만 다른 노드로 옮길 수 있다.
+struct PageAligned {
+  static void *operator new (const size_t size);
+  static void operator delete (void *ptr) noexcept;
+};
+
+#endif /* end of include guard: AFFINITY_H_ */
@@ -0,0 +1,32 @@
+// 힙 할당 횟수를 세기 위해 전역 `operator new`/`operator delete`를 바꿔 끼움.
+// 스레드별 카운터라 할당 경로에 경쟁을 더하지 않는다.
+#include "Globals.hpp"
+
+#include <cstdlib>
+#include <new>
+
+static thread_local uint64_t __allocCount = 0;
+
+uint64_t threadAllocCount () {
+  return __allocCount;
+}
+
+void *operator new (std::size_t size) {
+  void *ret;
+
+  __allocCount += 1;
+  while ((ret = std::malloc(size == 0 ? 1 : size)) == nullptr) {
+    const auto handler = std::get_new_handler();
+
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+
+  return ret;
+}
+
+void operator delete (void *ptr) noexcept {
+  std::free(ptr);
+}
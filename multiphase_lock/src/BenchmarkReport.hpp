@@ -0,0 +1,200 @@
+#ifndef BENCHMARKREPORT_H_
+#define BENCHMARKREPORT_H_
+#include "Globals.hpp"
+#include "LatencyHistogram.hpp"
+#include "ThreadContext.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+// `--benchmark` 실행 결과. `collect()`로 모든 피어의 통계를 모은 뒤 JSON이나 CSV로
+// 출력한다.
+struct BenchmarkReport {
+  double seconds = 0.0;
+  uint64_t seed = 0;
+  uint64_t acquired = 0;
+  uint64_t sent = 0;
+  uint64_t timeouts = 0;
+  // 엔진에 낸 요청을 포기한 횟수와 포기하며 보낸 명령 수.
+  uint64_t abandoned = 0;
+  uint64_t abandonSent = 0;
+  LatencyHistogram latency;
+  // 피어별 락 획득 수. ID 순.
+  std::vector<std::pair<ContextID, uint64_t>> perPeer;
+  // 피어별 획득 지연 시간의 p99(us). `perPeer`와 같은 순서.
+  std::vector<uint64_t> perPeerP99;
+
+  void collect () {
+    ::forEachContext([this](ThreadContext *ctx) {
+      this->perPeer.push_back(std::make_pair(ctx->id(), ctx->acquiredCount()));
+      this->perPeerP99.push_back(ctx->latency().percentile(0.99));
+      this->acquired += ctx->acquiredCount();
+      this->sent += ctx->sentCount();
+      this->timeouts += ctx->timeoutCount();
+      this->abandoned += ctx->abandonedCount();
+      this->abandonSent += ctx->abandonSentCount();
+      this->latency.merge(ctx->latency());
+    });
+  }
+
+  double throughput () const {
+    return this->seconds > 0.0 ? (double)this->acquired / this->seconds : 0.0;
+  }
+
+  double messagesPerAcquisition () const {
+    return this->acquired > 0 ? (double)this->sent / (double)this->acquired : 0.0;
+  }
+
+  double messagesPerAbandon () const {
+    return this->abandoned > 0 ? (double)this->abandonSent / (double)this->abandoned : 0.0;
+  }
+
+  uint64_t minPeer () const {
+    uint64_t ret = this->perPeer.empty() ? 0 : UINT64_MAX;
+
+    for (const auto &p : this->perPeer) {
+      ret = std::min(ret, p.second);
+    }
+    return ret;
+  }
+
+  uint64_t maxPeer () const {
+    uint64_t ret = 0;
+
+    for (const auto &p : this->perPeer) {
+      ret = std::max(ret, p.second);
+    }
+    return ret;
+  }
+
+  // 피어별 p99 중 가장 작은 것과 큰 것. 큰 쪽이 가장 운이 나쁜 피어의 꼬리 지연.
+  uint64_t minPeerP99 () const {
+    return this->perPeerP99.empty() ? 0 :
+      *std::min_element(this->perPeerP99.begin(), this->perPeerP99.end());
+  }
+
+  uint64_t maxPeerP99 () const {
+    return this->perPeerP99.empty() ? 0 :
+      *std::max_element(this->perPeerP99.begin(), this->perPeerP99.end());
+  }
+
+  // 피어별 획득 수의 변동 계수(표준편차 / 평균). 0이면 완전히 공평.
+  double fairnessCV () const {
+    double mean, var = 0.0;
+
+    if (this->perPeer.empty() || this->acquired == 0) {
+      return 0.0;
+    }
+    mean = (double)this->acquired / (double)this->perPeer.size();
+    for (const auto &p : this->perPeer) {
+      var += ((double)p.second - mean) * ((double)p.second - mean);
+    }
+    var /= (double)this->perPeer.size();
+
+    return std::sqrt(var) / mean;
+  }
+
+  // Jain의 공평성 지수. 1이면 완전히 공평, 1/N이면 한 피어가 독차지.
+  double fairnessJain () const {
+    double sq = 0.0;
+
+    if (this->perPeer.empty() || this->acquired == 0) {
+      return 1.0;
+    }
+    for (const auto &p : this->perPeer) {
+      sq += (double)p.second * (double)p.second;
+    }
+
+    return ((double)this->acquired * (double)this->acquired) / ((double)this->perPeer.size() * sq);
+  }
+
+  void writeJSON (std::ostream &os) const {
+    bool first = true;
+
+    os << "{\"duration\":" << this->seconds
+       << ",\"peers\":" << this->perPeer.size()
+       << ",\"lock_keys\":" << ::nbLockKeys
+       << ",\"max_lock_hold_time\":" << ::maxLockHoldTime
+       << ",\"max_acquire_delay\":" << ::maxAcquireDelay
+       << ",\"lock_engine\":\"" << ::lockEngineName(::lockEngine) << '"'
+       << ",\"permission_reuse\":" << (::reusePermissions ? "true" : "false")
+       << ",\"read_ratio\":" << ::readRatio
+       << ",\"acquire_timeout\":" << ::acquireTimeout
+       << ",\"lock_handoff\":" << (::lockHandoff ? "true" : "false")
+       << ",\"affinity\":\"" << ::affinityPolicyName(::affinityPolicy) << '"'
+       << ",\"affinity_scope\":\"" << ::affinityScopeName(::affinityScope) << '"'
+       << ",\"spin_wait\":" << ::spinWait
+       << ",\"seed\":" << this->seed
+       << ",\"acquisitions\":" << this->acquired
+       << ",\"acquisitions_per_sec\":" << this->throughput()
+       << ",\"latency_us\":{\"mean\":" << this->latency.mean()
+       << ",\"p50\":" << this->latency.percentile(0.5)
+       << ",\"p99\":" << this->latency.percentile(0.99)
+       << ",\"p999\":" << this->latency.percentile(0.999)
+       << ",\"max\":" << this->latency.max()
+       << "},\"messages_per_acquisition\":" << this->messagesPerAcquisition()
+       << ",\"timeouts\":" << this->timeouts
+       << ",\"abandoned\":" << this->abandoned
+       << ",\"messages_per_abandon\":" << this->messagesPerAbandon()
+       << ",\"fairness\":{\"min\":" << this->minPeer()
+       << ",\"max\":" << this->maxPeer()
+       << ",\"cv\":" << this->fairnessCV()
+       << ",\"jain\":" << this->fairnessJain()
+       << ",\"p99_min_us\":" << this->minPeerP99()
+       << ",\"p99_max_us\":" << this->maxPeerP99()
+       << "},\"per_peer\":{";
+    for (const auto &p : this->perPeer) {
+      if (!first) {
+        os << ',';
+      }
+      first = false;
+      os << '"' << p.first << "\":" << p.second;
+    }
+    os << "},\"per_peer_p99_us\":{";
+    for (size_t i = 0; i < this->perPeer.size(); i += 1) {
+      if (i > 0) {
+        os << ',';
+      }
+      os << '"' << this->perPeer[i].first << "\":" << this->perPeerP99[i];
+    }
+    os << "}}" << std::endl;
+  }
+
+  // 요약 한 줄. 여러 실행 결과를 이어 붙이기 쉽도록 `header`가 거짓이면 머리줄은 생략.
+  void writeCSV (std::ostream &os, const bool header = true) const {
+    if (header) {
+      os << "duration,peers,lock_keys,max_lock_hold_time,max_acquire_delay,"
+            "lock_engine,permission_reuse,read_ratio,acquire_timeout,lock_handoff,"
+            "affinity,affinity_scope,spin_wait,seed,"
+            "acquisitions,acquisitions_per_sec,latency_mean_us,latency_p50_us,"
+            "latency_p99_us,latency_p999_us,latency_max_us,"
+            "messages_per_acquisition,timeouts,abandoned,messages_per_abandon,"
+            "fairness_min,fairness_max,fairness_cv,"
+            "fairness_jain,fairness_p99_min_us,fairness_p99_max_us"
+         << std::endl;
+    }
+    os << this->seconds << ',' << this->perPeer.size() << ',' << ::nbLockKeys
+       << ',' << ::maxLockHoldTime << ',' << ::maxAcquireDelay << ','
+       << ::lockEngineName(::lockEngine) << ','
+       << (::reusePermissions ? 1 : 0) << ',' << ::readRatio << ','
+       << ::acquireTimeout << ',' << (::lockHandoff ? 1 : 0) << ','
+       << ::affinityPolicyName(::affinityPolicy) << ','
+       << ::affinityScopeName(::affinityScope) << ',' << ::spinWait << ','
+       << this->seed << ',' << this->acquired << ',' << this->throughput()
+       << ',' << this->latency.mean() << ','
+       << this->latency.percentile(0.5) << ','
+       << this->latency.percentile(0.99) << ','
+       << this->latency.percentile(0.999) << ',' << this->latency.max() << ','
+       << this->messagesPerAcquisition() << ',' << this->timeouts << ','
+       << this->abandoned << ',' << this->messagesPerAbandon() << ','
+       << this->minPeer() << ','
+       << this->maxPeer() << ',' << this->fairnessCV() << ','
+       << this->fairnessJain() << ',' << this->minPeerP99() << ','
+       << this->maxPeerP99() << std::endl;
+  }
+};
+
+#endif /* end of include guard: BENCHMARKREPORT_H_ */
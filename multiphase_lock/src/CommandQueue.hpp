@@ -1,24 +1,200 @@
 #ifndef COMMANDQUEUE_H_
 #define COMMANDQUEUE_H_
+#include "EventLoop.hpp"
 #include "Globals.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <thread>
 
-struct CommandQueue {
-  std::mutex mtx;
-  std::condition_variable cv_despatch;
-  std::queue<Command*> q;
+// 다수의 생산자(다른 피어), 하나의 소비자(이 큐를 소유한 피어)를 위한 lock-free 우편함.
+// 생산자는 `Envelope::next`로 연결된 스택에 CAS로 밀어 넣기만 하고, 소비자는 스택을
+// 통째로 떼어내 뒤집어서 FIFO 순서로 꺼낸다.
+// 소비자가 잠들어 있을 때만 깨운다. `attach()`한 `EventLoop`가 있으면 그 초인종을
+// 울리고, 없으면 mutex와 condition variable로 깨운다.
+class CommandQueue {
+protected:
+  // 생산자들이 쌓는 스택. 가장 최근에 들어온 명령이 머리.
+  std::atomic<Envelope*> __head;
+  // 소비자가 떼어낸 명령들. 이미 FIFO 순서로 정렬되어 있음. 소비자만 접근.
+  Envelope *__pending = nullptr;
+  // 소비자가 잠들려는 중인지. 참일 때만 생산자가 깨움.
+  std::atomic<bool> __parked;
+  // 있으면 소비자가 여기서 잠듦.
+  EventLoop *__loop = nullptr;
+  // 소비자가 잠든 뒤 `__loop`를 울렸는지. 잠들 때마다 내리므로, 잠든 동안 여러
+  // 생산자가 몰려 넣어도 한 번만 울린다.
+  std::atomic<bool> __rung;
+  std::mutex __mtx;
+  std::condition_variable __cv;
+
+  void __fetch () {
+    Envelope *p, *next, *rev;
+
+    // `ThreadContext::runTask()`가 상태를 바꾼 뒤 부르므로 순서를 지킴.
+    p = this->__head.exchange(nullptr, std::memory_order_seq_cst);
+    rev = nullptr;
+    while (p != nullptr) {
+      next = p->next;
+      p->next = rev;
+      rev = p;
+      p = next;
+    }
+    this->__pending = rev;
+  }
+
+  bool __hasCommand () {
+    return this->__pending != nullptr ||
+      this->__head.load(std::memory_order_seq_cst) != nullptr;
+  }
+
+public:
+  CommandQueue () : __head(nullptr), __parked(false), __rung(false) {}
 
   ~CommandQueue () {
     this->clear();
   }
 
+  // 생산자 측. 어느 스레드에서든 호출 가능.
+  void push (Envelope *env) {
+    this->pushChain(env, env);
+  }
+
+  // 여러 명령을 한 번에 넣음. `newest`에서 `oldest`까지 `Envelope::next`로 최근 것부터
+  // 연결되어 있어야 함.
+  void pushChain (Envelope *newest, Envelope *oldest) {
+    Envelope *head = this->__head.load(std::memory_order_relaxed);
+
+    do {
+      oldest->next = head;
+    } while (!this->__head.compare_exchange_weak(head, newest,
+      std::memory_order_seq_cst, std::memory_order_relaxed));
+
+    // 소비자가 `__parked`를 세운 뒤 큐를 다시 확인하므로, 여기서 거짓을 읽었다면
+    // 소비자는 방금 넣은 명령을 보고 잠들지 않는다.
+    if (this->__parked.load(std::memory_order_seq_cst)) {
+      if (this->__loop != nullptr) {
+        if (!this->__rung.exchange(true, std::memory_order_acq_rel)) {
+          this->__loop->ring();
+        }
+        return;
+      }
+
+      std::lock_guard<std::mutex> lg(this->__mtx);
+
+      this->__cv.notify_one();
+    }
+  }
+
+  // 이하 소비자 측.
+  bool empty () {
+    return this->__pending == nullptr &&
+      this->__head.load(std::memory_order_acquire) == nullptr;
+  }
+
+  // 큐가 비어 있으면 `nullptr`.
+  Envelope *pop () {
+    Envelope *ret;
+
+    if (this->__pending == nullptr) {
+      this->__fetch();
+      if (this->__pending == nullptr) {
+        return nullptr;
+      }
+    }
+
+    ret = this->__pending;
+    this->__pending = ret->next;
+    ret->next = nullptr;
+
+    return ret;
+  }
+
+  // 쌓인 명령을 모두 떼어내 FIFO 순서로 연결된 목록으로 돌려줌. 비었으면 `nullptr`.
+  Envelope *drain () {
+    Envelope *ret = this->__pending, *last;
+
+    this->__fetch();
+    if (ret == nullptr) {
+      ret = this->__pending;
+    }
+    else {
+      for (last = ret; last->next != nullptr; last = last->next);
+      last->next = this->__pending;
+    }
+    this->__pending = nullptr;
+
+    return ret;
+  }
+
+  // 소비자가 잠들 곳을 정함. 명령이 들어오기 전에 부를 것. 그 뒤로는 `waitUntil()`로
+  // 잠들어야 함.
+  void attach (EventLoop *loop) {
+    this->__loop = loop;
+  }
+
+  // `attach()`한 곳에서 명령이 들어오거나 `deadline`이 될 때까지 잠듦. spurious
+  // wakeup 가능.
+  void waitUntil (const EventLoop::ClockType::time_point &deadline) {
+    this->__rung.store(false, std::memory_order_relaxed);
+    this->__parked.store(true, std::memory_order_seq_cst);
+    if (!this->__hasCommand()) {
+      this->__loop->wait(deadline);
+    }
+    this->__parked.store(false, std::memory_order_relaxed);
+  }
+
+  // 잠들지 않고 명령이 들어오거나 `deadline`이 될 때까지 들여다봄. 들어왔으면 참.
+  // 가끔 CPU를 양보하므로 CPU가 하나여도 보내는 쪽이 돌 수 있다.
+  bool spinUntil (const EventLoop::ClockType::time_point &deadline) {
+    for (unsigned int i = 1; ; i += 1) {
+      if (this->__hasCommand()) {
+        return true;
+      }
+      if (i % 64 == 0) {
+        if (EventLoop::ClockType::now() >= deadline) {
+          return false;
+        }
+        std::this_thread::yield();
+      } else {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+      }
+    }
+  }
+
+  // 이하 `attach()`하지 않았을 때.
+  // 명령이 들어오거나 `timeout`이 지날 때까지 잠듦. spurious wakeup 가능.
+  template <class Rep, class Period>
+  void waitFor (const std::chrono::duration<Rep, Period> &timeout) {
+    std::unique_lock<std::mutex> ul(this->__mtx);
+
+    this->__parked.store(true, std::memory_order_seq_cst);
+    if (!this->__hasCommand()) {
+      this->__cv.wait_for(ul, timeout);
+    }
+    this->__parked.store(false, std::memory_order_relaxed);
+  }
+
+  void wait () {
+    std::unique_lock<std::mutex> ul(this->__mtx);
+
+    this->__parked.store(true, std::memory_order_seq_cst);
+    if (!this->__hasCommand()) {
+      this->__cv.wait(ul);
+    }
+    this->__parked.store(false, std::memory_order_relaxed);
+  }
+
   void clear () {
-    while (!q.empty()) {
-      delete q.front();
-      q.pop();
+    Envelope *env;
+
+    while ((env = this->pop()) != nullptr) {
+      env->cmd->release();
+      Pool<Envelope>::free(env);
     }
   }
 };
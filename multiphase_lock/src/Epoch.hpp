@@ -0,0 +1,109 @@
+#ifndef EPOCH_H_
+#define EPOCH_H_
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// 읽기 위주 자료구조를 위한 epoch 기반 메모리 회수.
+// 읽는 쪽은 `Guard`로 구역을 표시하기만 하므로 서로를 막지 않는다. 쓰는 쪽은 새
+// 버전을 공개한 뒤 `synchronize()`로 옛 버전을 보고 있을 수 있는 읽기 구역이 모두
+// 끝나기를 기다린 다음 옛 버전을 지운다.
+// 읽기 구역은 중첩할 수 없고, 읽기 구역 안에서 `synchronize()`를 부르면 영원히
+// 기다리게 된다.
+class EpochDomain {
+protected:
+  struct __Record {
+    // 0: 읽기 구역 밖. 그 외: 구역에 들어갈 때 본 전역 epoch.
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> inUse;
+    __Record *next = nullptr;
+
+    __Record () : epoch(0), inUse(true) {}
+  };
+
+  struct __Holder {
+    EpochDomain *domain = nullptr;
+    __Record *rec = nullptr;
+
+    ~__Holder () {
+      if (this->rec != nullptr) {
+        this->rec->epoch.store(0, std::memory_order_release);
+        this->rec->inUse.store(false, std::memory_order_release);
+      }
+    }
+  };
+
+  std::atomic<uint64_t> __global;
+  // 기록은 지우지 않음. 스레드가 끝나면 다음 스레드가 재사용.
+  std::atomic<__Record*> __records;
+
+  __Record *__acquireRecord () {
+    __Record *rec;
+    bool expected;
+
+    for (rec = this->__records.load(std::memory_order_acquire); rec != nullptr; rec = rec->next) {
+      expected = false;
+      if (rec->inUse.compare_exchange_strong(expected, true)) {
+        return rec;
+      }
+    }
+
+    rec = new __Record;
+    rec->next = this->__records.load(std::memory_order_relaxed);
+    while (!this->__records.compare_exchange_weak(rec->next, rec,
+      std::memory_order_release, std::memory_order_relaxed));
+
+    return rec;
+  }
+
+  __Record *__myRecord () {
+    // 프로세스 안에 도메인은 하나뿐이라고 가정.
+    static thread_local __Holder holder;
+
+    if (holder.rec == nullptr) {
+      holder.domain = this;
+      holder.rec = this->__acquireRecord();
+    }
+
+    return holder.rec;
+  }
+
+public:
+  class Guard {
+  protected:
+    __Record *__rec;
+
+  public:
+    Guard (EpochDomain &domain) : __rec(domain.__myRecord()) {
+      this->__rec->epoch.store(domain.__global.load(std::memory_order_acquire),
+        std::memory_order_relaxed);
+      // 읽기 구역 진입 표시가 보호 대상 포인터를 읽는 것보다 먼저 보여야 함.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    ~Guard () {
+      this->__rec->epoch.store(0, std::memory_order_release);
+    }
+
+    Guard (const Guard&) = delete;
+    Guard &operator= (const Guard&) = delete;
+  };
+
+  EpochDomain () : __global(1), __records(nullptr) {}
+
+  // 호출 전에 공개된 변경을 못 보고 있을 수 있는 읽기 구역이 모두 끝날 때까지 기다림.
+  void synchronize () {
+    uint64_t target, e;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    target = this->__global.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+    for (auto rec = this->__records.load(std::memory_order_acquire); rec != nullptr; rec = rec->next) {
+      while ((e = rec->epoch.load(std::memory_order_acquire)) != 0 && e < target) {
+        std::this_thread::yield();
+      }
+    }
+  }
+};
+
+#endif /* end of include guard: EPOCH_H_ */
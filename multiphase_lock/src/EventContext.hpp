@@ -1,64 +1,361 @@
 #ifndef EVENTCONTEXT_H_
 #define EVENTCONTEXT_H_
+#include "InplaceFunction.hpp"
+
+#include <algorithm>
 #include <cstdint>
 
 #include <chrono>
-#include <map>
-#include <set>
-#include <list>
+#include <memory>
 #include <vector>
-#include <functional>
 
+// 계층적 타이밍 휠(hierarchical timing wheel).
+// 시간은 `TickType` 단위로 자른다. 휠은 `LEVELS`단이고 단마다 `SLOTS`칸이다. 이벤트는
+// 만료 tick과 현재 tick이 처음으로 달라지는 자리의 단에 들어가며, 시간이 흘러 그 칸에
+// 도달하면 아랫단으로 내려오거나 만료된다. 추가, 취소, 만료가 모두 O(1)이다.
+// 이벤트 노드는 이 컨텍스트가 재사용하며, 콜백은 `InplaceFunction`에 담으므로 안정
+// 상태에서는 힙을 쓰지 않는다.
+// 이벤트는 정해진 시각보다 일찍 발생하지 않는다. 늦어도 한 tick보다 덜 늦는다.
 class EventContext {
 public:
   typedef std::chrono::steady_clock ClockType;
-  typedef std::function<void()> FuncType;
-  typedef uint_fast32_t EventID;
+  typedef InplaceFunction<void(), 32> FuncType;
+  // 0은 ID 없음. 요청마다 새 ID를 쓰는 피어가 오래 돌아도 한 바퀴 돌지 않도록 64비트.
+  typedef uint64_t EventID;
+  // 휠의 시간 단위. 100us.
+  typedef std::chrono::duration<int64_t, std::ratio<1, 10000>> TickType;
 
 protected:
-  enum __Type {
-    T_IMMEDIATE,
-    T_DELAYED
+  static const unsigned int SLOT_BITS = 6;
+  static const unsigned int SLOTS = 1 << SLOT_BITS;
+  static const unsigned int LEVELS = 6;
+  static const size_t SLAB_SIZE = 64;
+
+  struct __Event;
+
+  struct __List {
+    __Event *head = nullptr;
+    __Event *tail = nullptr;
+
+    bool empty () const {
+      return this->head == nullptr;
+    }
+
+    void pushBack (__Event *e) {
+      e->owner = this;
+      e->prev = this->tail;
+      e->next = nullptr;
+      if (this->tail == nullptr) {
+        this->head = e;
+      }
+      else {
+        this->tail->next = e;
+      }
+      this->tail = e;
+    }
+
+    void unlink (__Event *e) {
+      if (e->prev == nullptr) {
+        this->head = e->next;
+      }
+      else {
+        e->prev->next = e->next;
+      }
+      if (e->next == nullptr) {
+        this->tail = e->prev;
+      }
+      else {
+        e->next->prev = e->prev;
+      }
+      e->owner = nullptr;
+    }
+
+    // `x`의 노드를 모두 이 목록 뒤로 옮김.
+    void splice (__List &x) {
+      for (auto e = x.head; e != nullptr; e = e->next) {
+        e->owner = this;
+      }
+      if (x.head == nullptr) {
+        return;
+      }
+      if (this->tail == nullptr) {
+        this->head = x.head;
+      }
+      else {
+        this->tail->next = x.head;
+        x.head->prev = this->tail;
+      }
+      this->tail = x.tail;
+      x.head = x.tail = nullptr;
+    }
   };
+
   struct __Event {
-    bool hasID;
-    __Type type;
+    __Event *prev = nullptr;
+    __Event *next = nullptr;
+    // 이 노드가 들어 있는 목록. 빈 노드면 `nullptr`.
+    __List *owner = nullptr;
+    // 만료 tick. 즉시 이벤트는 0.
+    uint64_t tick = 0;
+    // 같은 tick의 이벤트는 넣은 순서대로 발생.
+    uint64_t seq = 0;
+    EventID id = 0;
+    // 휠에 들어 있을 때의 자리.
+    uint8_t level = 0;
+    uint8_t slot = 0;
     FuncType func;
-    std::list<__Event>::iterator posInList;
-    std::multimap<ClockType::time_point, __Event*>::iterator posInSlot;
+  };
+
+  // `EventID` -> 노드. linear probing 해시 테이블.
+  class __IDTable {
+  protected:
+    std::vector<std::pair<EventID, __Event*>> __tbl;
+    size_t __size = 0;
+
+    size_t __home (const EventID id) const {
+      return (size_t)(((uint64_t)id * 0x9E3779B97F4A7C15ULL) >> 32) & (this->__tbl.size() - 1);
+    }
+
+    void __grow () {
+      std::vector<std::pair<EventID, __Event*>> old(this->__tbl.empty() ? 16 : this->__tbl.size() * 2);
+
+      old.swap(this->__tbl);
+      this->__size = 0;
+      for (const auto &p : old) {
+        if (p.first != 0) {
+          this->put(p.first, p.second);
+        }
+      }
+    }
+
+  public:
+    __Event *get (const EventID id) const {
+      if (this->__tbl.empty()) {
+        return nullptr;
+      }
+      for (size_t i = this->__home(id); this->__tbl[i].first != 0; i = (i + 1) & (this->__tbl.size() - 1)) {
+        if (this->__tbl[i].first == id) {
+          return this->__tbl[i].second;
+        }
+      }
+      return nullptr;
+    }
+
+    // `id`는 테이블에 없어야 함.
+    void put (const EventID id, __Event *e) {
+      size_t i;
+
+      if ((this->__size + 1) * 2 > this->__tbl.size()) {
+        this->__grow();
+      }
+      for (i = this->__home(id); this->__tbl[i].first != 0; i = (i + 1) & (this->__tbl.size() - 1));
+      this->__tbl[i] = std::make_pair(id, e);
+      this->__size += 1;
+    }
+
+    void erase (const EventID id) {
+      const size_t mask = this->__tbl.size() - 1;
+      size_t i, j, h;
+
+      if (this->__tbl.empty()) {
+        return;
+      }
+      for (i = this->__home(id); this->__tbl[i].first != id; i = (i + 1) & mask) {
+        if (this->__tbl[i].first == 0) {
+          return;
+        }
+      }
+      // backward shift 삭제.
+      for (j = (i + 1) & mask; this->__tbl[j].first != 0; j = (j + 1) & mask) {
+        h = this->__home(this->__tbl[j].first);
+        if (((j - h) & mask) >= ((j - i) & mask)) {
+          this->__tbl[i] = this->__tbl[j];
+          i = j;
+        }
+      }
+      this->__tbl[i] = std::make_pair(0, nullptr);
+      this->__size -= 1;
+    }
+
+    void clear () {
+      std::fill(this->__tbl.begin(), this->__tbl.end(), std::make_pair((EventID)0, (__Event*)nullptr));
+      this->__size = 0;
+    }
   };
 
   ClockType::time_point __now = ClockType::now();
-  std::list<__Event> __list;
-  std::set<__Event*> __immediate;
-  std::multimap<ClockType::time_point, __Event*> __slot;
-  std::map<EventID, __Event*> __idEventMap;
-  std::map<__Event*, EventID> __eventIDMap;
+  // 휠이 처리를 마친 tick.
+  uint64_t __curTick = __toTick(__now);
+  uint64_t __seq = 0;
+  size_t __count = 0;
+
+  __List __wheel[LEVELS][SLOTS];
+  uint64_t __occupied[LEVELS] = {};
+  // 휠이 담을 수 있는 범위보다 먼 이벤트.
+  __List __overflow;
+  __List __immediate;
+  // 만료되어 다음 `handle()`에서 발생할 이벤트.
+  __List __due;
+  // `handle()`이 지금 발생시키고 있는 이벤트.
+  __List __firing;
+
+  __IDTable __ids;
+  __Event *__free = nullptr;
+  std::vector<std::unique_ptr<__Event[]>> __slabs;
+  std::vector<__Event*> __sortBuf;
+
+  static uint64_t __toTick (const ClockType::time_point &tp) {
+    return (uint64_t)std::chrono::duration_cast<TickType>(tp.time_since_epoch()).count();
+  }
+
+  static ClockType::time_point __fromTick (const uint64_t tick) {
+    return ClockType::time_point(std::chrono::duration_cast<ClockType::duration>(TickType((int64_t)tick)));
+  }
 
   __Event *__allocEvent () {
-    std::list<__Event>::iterator ret;
+    __Event *ret;
+
+    if (this->__free == nullptr) {
+      __Event *slab = new __Event[SLAB_SIZE];
+
+      this->__slabs.emplace_back(slab);
+      for (size_t i = 0; i < SLAB_SIZE; i += 1) {
+        slab[i].next = this->__free;
+        this->__free = &slab[i];
+      }
+    }
 
-    this->__list.resize(this->__list.size() + 1);
-    ret = std::prev(this->__list.end());
-    ret->posInList = ret;
+    ret = this->__free;
+    this->__free = ret->next;
+    ret->next = nullptr;
+    ret->seq = this->__seq++;
+    this->__count += 1;
+
+    return ret;
+  }
 
-    return &*ret;
+  void __freeEvent (__Event *e) {
+    if (e->id != 0) {
+      this->__ids.erase(e->id);
+      e->id = 0;
+    }
+    e->func.reset();
+    e->prev = nullptr;
+    e->next = this->__free;
+    this->__free = e;
+    this->__count -= 1;
   }
 
-  void __popEvent (__Event *e) {
-    switch (e->type) {
-      case T_IMMEDIATE: this->__immediate.erase(e); break;
-      case T_DELAYED: this->__slot.erase(e->posInSlot); break;
+  void __unlink (__Event *e) {
+    auto owner = e->owner;
+
+    owner->unlink(e);
+    if (owner == &this->__wheel[e->level][e->slot] && owner->empty()) {
+      this->__occupied[e->level] &= ~((uint64_t)1 << e->slot);
     }
+  }
 
-    if (e->hasID) {
-        auto it = this->__eventIDMap.find(e);
+  // 만료 tick에 맞는 자리에 넣음.
+  void __schedule (__Event *e) {
+    uint64_t diff;
+    unsigned int level;
 
-        if (this->__eventIDMap.end() != it) {
-          this->__idEventMap.erase(it->second);
-          this->__eventIDMap.erase(it);
-        }
+    if (e->tick <= this->__curTick) {
+      this->__due.pushBack(e);
+      return;
+    }
+
+    diff = e->tick ^ this->__curTick;
+    level = (63 - __builtin_clzll(diff)) / SLOT_BITS;
+    if (level >= LEVELS) {
+      this->__overflow.pushBack(e);
+      return;
     }
+
+    e->level = (uint8_t)level;
+    e->slot = (uint8_t)((e->tick >> (level * SLOT_BITS)) & (SLOTS - 1));
+    this->__wheel[level][e->slot].pushBack(e);
+    this->__occupied[level] |= (uint64_t)1 << e->slot;
+  }
+
+  // 휠을 `tick`까지 돌림. 만료된 이벤트는 `__due`로 감.
+  void __advance (const uint64_t tick) {
+    __List moved;
+
+    if (tick <= this->__curTick) {
+      return;
+    }
+
+    for (unsigned int level = 0; level < LEVELS; level += 1) {
+      const unsigned int shift = level * SLOT_BITS;
+      const uint64_t from = this->__curTick >> shift, to = tick >> shift;
+      uint64_t mask, taken;
+
+      if (from == to) {
+        break;
+      }
+      if (to - from >= SLOTS) {
+        mask = ~(uint64_t)0;
+      }
+      else {
+        // (from, to] 구간의 칸들.
+        const unsigned int first = (unsigned int)((from + 1) & (SLOTS - 1));
+
+        mask = ((uint64_t)1 << (to - from)) - 1;
+        mask = (mask << first) | (first == 0 ? 0 : (mask >> (SLOTS - first)));
+      }
+
+      taken = mask & this->__occupied[level];
+      this->__occupied[level] &= ~taken;
+      while (taken != 0) {
+        moved.splice(this->__wheel[level][__builtin_ctzll(taken)]);
+        taken &= taken - 1;
+      }
+    }
+    if ((tick >> (LEVELS * SLOT_BITS)) != (this->__curTick >> (LEVELS * SLOT_BITS))) {
+      moved.splice(this->__overflow);
+    }
+
+    this->__curTick = tick;
+    while (!moved.empty()) {
+      auto e = moved.head;
+
+      moved.unlink(e);
+      this->__schedule(e);
+    }
+  }
+
+  // 다음으로 휠을 돌려야 할 tick. 휠이 비었으면 `UINT64_MAX`.
+  // 0단 밖의 이벤트는 그 칸이 시작하는 tick을 돌려주므로 실제 만료보다 이를 수 있다.
+  uint64_t __nextTick () const {
+    for (unsigned int level = 0; level < LEVELS; level += 1) {
+      const unsigned int shift = level * SLOT_BITS;
+      const unsigned int cur = (unsigned int)((this->__curTick >> shift) & (SLOTS - 1));
+      const uint64_t above = cur == SLOTS - 1 ? 0 : (this->__occupied[level] & (~(uint64_t)0 << (cur + 1)));
+
+      if (above != 0) {
+        const uint64_t base = (this->__curTick >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+
+        return base | ((uint64_t)__builtin_ctzll(above) << shift);
+      }
+    }
+    if (!this->__overflow.empty()) {
+      return ((this->__curTick >> (LEVELS * SLOT_BITS)) + 1) << (LEVELS * SLOT_BITS);
+    }
+
+    return UINT64_MAX;
+  }
+
+  __Event *__prepare (const EventID id) {
+    auto e = this->__allocEvent();
+
+    if (id != 0) {
+      this->cancelEvent(id);
+      this->__ids.put(id, e);
+      e->id = id;
+    }
+
+    return e;
   }
 
 public:
@@ -71,107 +368,130 @@ public:
     }
   }
 
+  ClockType::time_point now () const {
+    return this->__now;
+  }
+
   bool hasEvent () {
-    return (!this->__slot.empty()) || (!this->__immediate.empty());
+    return this->__count > 0;
   }
 
   bool hasPendingEvent () {
-    if (!this->__immediate.empty()) {
+    if (!this->__immediate.empty() || !this->__due.empty()) {
       return true;
     }
-    if (this->__slot.empty()) {
-      return false;
-    }
 
-    return this->__slot.cbegin()->first <= this->__now;
+    return this->__nextTick() <= __toTick(this->__now);
   }
 
   ClockType::duration timeToNextEvent () {
-    ClockType::duration ret;
+    uint64_t next;
 
-    if (this->__immediate.empty()) {
-      ret = this->__slot.cbegin()->first - this->__now;
+    if (!this->__immediate.empty() || !this->__due.empty()) {
+      return ClockType::duration(0);
     }
-    else {
-      ret = ClockType::duration(0);
+
+    next = this->__nextTick();
+    if (next == UINT64_MAX) {
+      return ClockType::duration::max();
     }
 
-    return ret;
+    return __fromTick(next) - this->__now;
   }
 
   void cancelEvent (const EventID id) {
-    auto it = this->__idEventMap.find(id);
+    auto e = this->__ids.get(id);
 
-    if (this->__idEventMap.end() != it) {
-      this->__popEvent(it->second);
-      this->__list.erase(it->second->posInList);
+    if (e != nullptr) {
+      this->__unlink(e);
+      this->__freeEvent(e);
     }
   }
 
-  void addDelayedEvent (const ClockType::duration &delay, const FuncType &func, const EventID id = 0) {
-    auto e = this->__allocEvent();
+  void addDelayedEvent (const ClockType::duration &delay, FuncType func, const EventID id = 0) {
+    auto e = this->__prepare(id);
+    const auto deadline = this->__now + delay;
 
-    if (id != 0) {
-      this->cancelEvent(id);
-      this->__idEventMap[id] = e;
-      this->__eventIDMap[e] = id;
-
-      e->hasID = true;
+    e->func = std::move(func);
+    if (deadline <= this->__now) {
+      e->tick = 0;
+      this->__due.pushBack(e);
     }
     else {
-      e->hasID = false;
+      // 올림. 정해진 시각보다 일찍 발생하면 안 됨.
+      e->tick = __toTick(deadline - ClockType::duration(1)) + 1;
+      this->__schedule(e);
     }
-
-    e->type = T_DELAYED;
-    e->func = func;
-    e->posInSlot = this->__slot.insert(std::make_pair(this->__now + delay, e));
   }
 
-  void addImmediateEvent (const FuncType &func, const EventID id = 0) {
-    auto e = this->__allocEvent();
-
-    if (id != 0) {
-      this->cancelEvent(id);
-      this->__idEventMap[id] = e;
-      this->__eventIDMap[e] = id;
+  void addImmediateEvent (FuncType func, const EventID id = 0) {
+    auto e = this->__prepare(id);
 
-      e->hasID = true;
-    }
-    else {
-      e->hasID = false;
-    }
-
-    e->type = T_IMMEDIATE;
-    e->func = func;
-    this->__immediate.insert(e);
+    e->func = std::move(func);
+    e->tick = 0;
+    this->__immediate.pushBack(e);
   }
 
   void clear () {
-    this->__list.clear();
-    this->__immediate.clear();
-    this->__slot.clear();
-    this->__idEventMap.clear();
-    this->__eventIDMap.clear();
+    __List *lists[] = {&this->__overflow, &this->__immediate, &this->__due, &this->__firing};
+
+    for (unsigned int level = 0; level < LEVELS; level += 1) {
+      for (unsigned int slot = 0; slot < SLOTS; slot += 1) {
+        this->__immediate.splice(this->__wheel[level][slot]);
+      }
+      this->__occupied[level] = 0;
+    }
+    for (auto l : lists) {
+      while (!l->empty()) {
+        auto e = l->head;
+
+        l->unlink(e);
+        this->__freeEvent(e);
+      }
+    }
+    this->__ids.clear();
+    this->__curTick = __toTick(this->__now);
   }
 
-  void handle () {
-    std::vector<__Event*> toFire;
+  // 때가 된 이벤트를 발생시키고 그 수를 반환.
+  size_t handle () {
+    size_t ret = 0;
 
-    std::copy(this->__immediate.begin(), this->__immediate.end(), toFire.end());
+    this->__advance(__toTick(this->__now));
 
-    for (const auto &p : this->__slot) {
-      if (p.first > this->__now) {
-        break;
+    // 이번에 발생시킬 것들을 떼어냄. 콜백이 추가하는 이벤트는 다음 차례에 발생.
+    this->__firing.splice(this->__immediate);
+    if (this->__due.head != this->__due.tail) {
+      // 만료 시각 순서대로.
+      this->__sortBuf.clear();
+      for (auto e = this->__due.head; e != nullptr; e = e->next) {
+        this->__sortBuf.push_back(e);
       }
-      toFire.push_back(p.second);
-      this->__popEvent(p.second);
+      std::sort(this->__sortBuf.begin(), this->__sortBuf.end(), [](const __Event *a, const __Event *b) {
+        return a->tick != b->tick ? a->tick < b->tick : a->seq < b->seq;
+      });
+      for (const auto &e : this->__sortBuf) {
+        this->__due.unlink(e);
+        this->__firing.pushBack(e);
+      }
+    }
+    else {
+      this->__firing.splice(this->__due);
     }
 
-    for (const auto &v : toFire) {
-      v->func();
-      this->__list.erase(v->posInList);
+    // 콜백이 아직 발생하지 않은 이벤트를 취소할 수 있으므로 하나씩 꺼냄.
+    while (!this->__firing.empty()) {
+      auto e = this->__firing.head;
+      FuncType func(std::move(e->func));
+
+      this->__firing.unlink(e);
+      this->__freeEvent(e);
+      func();
+      ret += 1;
     }
+
+    return ret;
   }
 };
 
-#endif /* end of include guard: DELAYEDEVENTCONTEXT_H_ */
+#endif /* end of include guard: EVENTCONTEXT_H_ */
@@ -0,0 +1,104 @@
+#include "EventLoop.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+EventLoop::EventLoop () : __waits(0), __arms(0), __rings(0) {}
+
+EventLoop::~EventLoop () {
+  this->close();
+}
+
+bool EventLoop::open () {
+  epoll_event ev;
+  bool ok;
+
+  if (this->__epfd >= 0) {
+    return false;
+  }
+
+  this->__epfd = ::epoll_create1(EPOLL_CLOEXEC);
+  this->__bellfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  this->__timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  ok = this->__epfd >= 0 && this->__bellfd >= 0 && this->__timerfd >= 0;
+
+  // 이벤트의 `data.fd`로 어느 쪽인지 구분함.
+  for (const auto fd : {this->__bellfd, this->__timerfd}) {
+    if (ok) {
+      ev.events = EPOLLIN | EPOLLET;
+      ev.data.fd = fd;
+      ok = ::epoll_ctl(this->__epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+  }
+
+  if (!ok) {
+    const auto err = errno;
+
+    this->close();
+    errno = err;
+  }
+  return ok;
+}
+
+void EventLoop::close () {
+  for (auto fd : {&this->__epfd, &this->__bellfd, &this->__timerfd}) {
+    if (*fd >= 0) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+  this->__armedAt = ClockType::time_point::max();
+}
+
+void EventLoop::ring () {
+  const uint64_t one = 1;
+
+  this->__rings.fetch_add(1, std::memory_order_relaxed);
+  if (::write(this->__bellfd, &one, sizeof(one)) < 0) {
+    // 카운터가 찼어도 읽지 않은 값이 있으므로 깨어남.
+  }
+}
+
+void EventLoop::wait (const ClockType::time_point &deadline) {
+  epoll_event evs[2];
+  int n;
+
+  if (deadline < this->__armedAt) {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      deadline.time_since_epoch()).count();
+    itimerspec spec = {};
+
+    // 0은 타이머를 끄는 값이므로 피함.
+    spec.it_value.tv_sec = (time_t)(ns / 1000000000);
+    spec.it_value.tv_nsec = (long)(ns % 1000000000);
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+      spec.it_value.tv_nsec = 1;
+    }
+    this->__arms.fetch_add(1, std::memory_order_relaxed);
+    if (::timerfd_settime(this->__timerfd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0) {
+      this->__armedAt = deadline;
+    }
+  }
+
+  this->__waits.fetch_add(1, std::memory_order_relaxed);
+  n = ::epoll_wait(this->__epfd, evs, 2, -1);
+  for (int i = 0; i < n; i += 1) {
+    if (evs[i].data.fd == this->__timerfd) {
+      this->__armedAt = ClockType::time_point::max();
+    }
+  }
+}
+
+void raiseFileLimit () {
+  rlimit rl;
+
+  if (::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef EVENTLOOP_H_
+#define EVENTLOOP_H_
+#include "Globals.hpp"
+
+#include <atomic>
+#include <chrono>
+
+// 스레드를 가진 피어 하나가 잠드는 곳. `epoll_wait()` 한 번으로 우편함의 초인종
+// (eventfd)과 가장 이른 타이머(timerfd)를 같이 기다린다. 둘 다 edge-triggered로
+// 등록하고 읽지 않으므로, 깨어나는 쪽은 `epoll_wait()` 말고 시스템 콜을 부르지
+// 않는다. eventfd의 카운터는 2^64번 울려야 찬다.
+// 타이머는 기다릴 시각이 이미 맞춰 둔 것보다 이를 때만 다시 맞춘다. 늦춰진 타이머는
+// 그대로 두었다가 울리면 헛되이 한 번 깨어난다.
+class EventLoop {
+public:
+  typedef std::chrono::steady_clock ClockType;
+
+protected:
+  int __epfd = -1;
+  int __bellfd = -1;
+  int __timerfd = -1;
+  // timerfd를 맞춰 둔 시각. 울렸거나 맞춘 적이 없으면 `time_point::max()`.
+  ClockType::time_point __armedAt = ClockType::time_point::max();
+  // 이하 잠드는 스레드만 씀. 읽기는 어느 스레드에서든.
+  std::atomic<uint64_t> __waits;
+  std::atomic<uint64_t> __arms;
+  // 어느 스레드에서든 씀.
+  std::atomic<uint64_t> __rings;
+
+public:
+  EventLoop ();
+  // `close()`.
+  ~EventLoop ();
+
+  EventLoop (const EventLoop&) = delete;
+  EventLoop &operator= (const EventLoop&) = delete;
+
+  // fd들을 만듦. 실패하면 `errno`를 남기고 거짓.
+  bool open ();
+  void close ();
+
+  // 잠든 스레드를 깨움. 어느 스레드에서든. 깨울 쪽끼리 한 번만 부르도록 묶는 것은
+  // 부르는 쪽(`CommandQueue`)의 일.
+  void ring ();
+  // `ring()`되거나 `deadline`이 될 때까지 잠듦. `time_point::max()`면 시각은 기다리지
+  // 않음. spurious wakeup 가능.
+  void wait (const ClockType::time_point &deadline);
+
+  // `epoll_wait()`에서 깨어난 횟수.
+  uint64_t wakeups () const {
+    return this->__waits.load(std::memory_order_relaxed);
+  }
+
+  // 부른 시스템 콜 수. 깨우는 쪽과 잠드는 쪽 모두 셈.
+  uint64_t syscalls () const {
+    return this->__waits.load(std::memory_order_relaxed) +
+      this->__arms.load(std::memory_order_relaxed) +
+      this->__rings.load(std::memory_order_relaxed);
+  }
+};
+
+// 열 수 있는 파일 수의 소프트 한도를 하드 한도까지 올림. 스레드를 가진 피어는
+// `EventLoop`에 fd를 셋 씀.
+void raiseFileLimit ();
+
+#endif /* end of include guard: EVENTLOOP_H_ */
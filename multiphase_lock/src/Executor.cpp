@@ -0,0 +1,220 @@
+#include "Executor.hpp"
+#include "Affinity.hpp"
+#include "ThreadContext.hpp"
+
+#include <algorithm>
+#include <exception>
+
+thread_local Executor::__Worker *Executor::__current = nullptr;
+
+Executor::Executor (const unsigned int nb_workers) :
+  __sleepers(0), __next(0), __stopFlag(false) {
+  if (nb_workers == 0) {
+    throw std::exception();
+  }
+
+  for (unsigned int i = 0; i < nb_workers; i += 1) {
+    this->__workers.emplace_back(new __Worker());
+  }
+  // 훔칠 곳이 모두 만들어진 뒤에 띄움.
+  for (auto &w : this->__workers) {
+    const auto p = w.get();
+
+    w->th = std::thread([this, p]() { this->__loop(p); });
+  }
+}
+
+Executor::~Executor () {
+  this->__stopFlag.store(true, std::memory_order_seq_cst);
+  for (auto &w : this->__workers) {
+    std::lock_guard<std::mutex> lg(w->mtx);
+
+    w->cv.notify_one();
+  }
+  for (auto &w : this->__workers) {
+    w->th.join();
+  }
+}
+
+uint64_t Executor::steals () const {
+  uint64_t ret = 0;
+
+  for (const auto &w : this->__workers) {
+    ret += w->steals.load(std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+ThreadContext *Executor::__pop (__Worker *w) {
+  std::lock_guard<std::mutex> lg(w->mtx);
+  ThreadContext *ret;
+
+  if (w->queue.empty()) {
+    return nullptr;
+  }
+  ret = w->queue.front();
+  w->queue.pop_front();
+  w->size.fetch_sub(1, std::memory_order_relaxed);
+
+  return ret;
+}
+
+ThreadContext *Executor::__steal (const size_t index) {
+  const auto n = this->__workers.size();
+
+  for (size_t i = 1; i < n; i += 1) {
+    const auto v = this->__workers[(index + i) % n].get();
+    ThreadContext *ret;
+
+    if (v->size.load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lg(v->mtx);
+
+    if (v->queue.empty()) {
+      continue;
+    }
+    // 주인은 앞에서 꺼내므로 뒤에서 가져옴.
+    ret = v->queue.back();
+    v->queue.pop_back();
+    v->size.fetch_sub(1, std::memory_order_relaxed);
+    v->steals.fetch_add(1, std::memory_order_relaxed);
+
+    return ret;
+  }
+
+  return nullptr;
+}
+
+bool Executor::__anyQueued () {
+  for (const auto &w : this->__workers) {
+    if (w->size.load(std::memory_order_seq_cst) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Executor::__wakeOne () {
+  for (auto &w : this->__workers) {
+    std::lock_guard<std::mutex> lg(w->mtx);
+
+    if (w->sleeping) {
+      // 다음에 깨울 때는 다른 작업 스레드를 고르도록.
+      w->sleeping = false;
+      w->cv.notify_one();
+      return;
+    }
+  }
+}
+
+void Executor::__loop (__Worker *w) {
+  const size_t index = (size_t)(std::find_if(this->__workers.begin(),
+    this->__workers.end(),
+    [w](const std::unique_ptr<__Worker> &p) { return p.get() == w; }) -
+    this->__workers.begin());
+  std::vector<ContextID> due;
+  ThreadContext *ctx;
+
+  __current = w;
+  // 피어는 작업 스레드 사이를 옮겨 다니므로 작업 스레드만 묶음.
+  ::pinThread(::placeThread(index));
+
+  while (!this->__stopFlag.load(std::memory_order_relaxed)) {
+    // 만료된 타이머의 피어를 깨움. 깨운 피어는 자기 큐로 들어옴.
+    {
+      const auto now = ClockType::now();
+
+      std::unique_lock<std::mutex> ul(w->mtx);
+
+      while (!w->timers.empty() && w->timers.front().at <= now) {
+        due.push_back(w->timers.front().id);
+        std::pop_heap(w->timers.begin(), w->timers.end(), __Later());
+        w->timers.pop_back();
+      }
+    }
+    if (!due.empty()) {
+      EpochDomain::Guard guard(::peerEpoch);
+      const auto snapshot = ::peers.load(std::memory_order_acquire);
+
+      for (const auto &id : due) {
+        const auto p = snapshot->find(id);
+
+        if (p != nullptr) {
+          p->wakeTask();
+        }
+      }
+      due.clear();
+    }
+
+    ctx = this->__pop(w);
+    if (ctx == nullptr) {
+      ctx = this->__steal(index);
+    }
+    if (ctx != nullptr) {
+      ctx->runTask();
+      continue;
+    }
+
+    // 할 일이 없으면 잠듦. `__sleepers`를 올린 뒤 큐를 다시 보므로, 그 사이에
+    // 넣은 쪽은 `__sleepers`를 보고 깨운다.
+    {
+      std::unique_lock<std::mutex> ul(w->mtx);
+
+      w->sleeping = true;
+      this->__sleepers.fetch_add(1, std::memory_order_seq_cst);
+      if (!this->__anyQueued() &&
+          !this->__stopFlag.load(std::memory_order_seq_cst)) {
+        if (w->timers.empty()) {
+          w->cv.wait(ul);
+        } else {
+          w->cv.wait_until(ul, w->timers.front().at);
+        }
+      }
+      w->sleeping = false;
+      this->__sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  __current = nullptr;
+}
+
+void Executor::submit (ThreadContext *ctx) {
+  auto w = __current;
+
+  if (w == nullptr) {
+    w = this->__workers[this->__next.fetch_add(1, std::memory_order_relaxed) %
+      this->__workers.size()].get();
+  }
+
+  {
+    std::lock_guard<std::mutex> lg(w->mtx);
+
+    w->queue.push_back(ctx);
+    w->size.fetch_add(1, std::memory_order_seq_cst);
+    if (w->sleeping) {
+      w->sleeping = false;
+      w->cv.notify_one();
+      return;
+    }
+  }
+
+  // 다른 작업 스레드가 잠들어 있으면 깨워서 훔쳐 가게 함.
+  if (this->__sleepers.load(std::memory_order_seq_cst) > 0) {
+    this->__wakeOne();
+  }
+}
+
+void Executor::wakeAt (const ContextID id, const ClockType::time_point &at) {
+  const auto w = __current;
+
+  if (w == nullptr) {
+    throw std::exception();
+  }
+
+  std::lock_guard<std::mutex> lg(w->mtx);
+
+  w->timers.push_back(__Timer{at, id});
+  std::push_heap(w->timers.begin(), w->timers.end(), __Later());
+}
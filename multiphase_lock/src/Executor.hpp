@@ -0,0 +1,93 @@
+#ifndef EXECUTOR_H_
+#define EXECUTOR_H_
+#include "Globals.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 피어(`ThreadContext`)를 피어마다 스레드를 두지 않고 정해진 수의 작업 스레드에서
+// 돌리는 M:N 실행기. 피어는 우편함에 명령이 들어오거나 타이머가 만료되면 실행 큐에
+// 들어가고, 작업 스레드가 꺼내 한 번 움직인다(`ThreadContext::runTask()`).
+// 작업 스레드마다 실행 큐와 타이머 힙이 있다. 작업 스레드가 넣는 피어는 자기 큐로,
+// 그 밖의 스레드(전송 계층, main)가 넣는 피어는 돌아가며 고른 큐로 간다. 자기 큐가
+// 비면 다른 작업 스레드의 큐 뒤쪽에서 훔쳐 오고, 그것도 없으면 자기 타이머 중 가장
+// 이른 것까지 잠든다.
+class Executor {
+public:
+  typedef std::chrono::steady_clock ClockType;
+
+protected:
+  struct __Timer {
+    ClockType::time_point at;
+    // 포인터 대신 ID로 찾으므로 그 사이에 사라진 피어는 건너뜀.
+    ContextID id;
+  };
+
+  struct __Later {
+    bool operator() (const __Timer &a, const __Timer &b) const {
+      return a.at > b.at;
+    }
+  };
+
+  struct __Worker {
+    // 이하 `mtx`로 보호.
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<ThreadContext*> queue;
+    // 주인 스레드만 넣고 뺌. `__Later`로 만든 힙.
+    std::vector<__Timer> timers;
+    bool sleeping = false;
+    // `queue`의 길이. 훔칠 곳을 고를 때 잠그지 않고 봄.
+    std::atomic<size_t> size;
+    std::atomic<uint64_t> steals;
+    std::thread th;
+
+    __Worker () : size(0), steals(0) {}
+  };
+
+  std::vector<std::unique_ptr<__Worker>> __workers;
+  // 잠들었거나 잠들려는 작업 스레드 수.
+  std::atomic<unsigned int> __sleepers;
+  std::atomic<unsigned int> __next;
+  std::atomic<bool> __stopFlag;
+
+  // 지금 스레드가 작업 스레드면 그 작업 스레드.
+  static thread_local __Worker *__current;
+
+  void __loop (__Worker *w);
+  ThreadContext *__pop (__Worker *w);
+  ThreadContext *__steal (const size_t index);
+  bool __anyQueued ();
+  void __wakeOne ();
+
+public:
+  // `nb_workers`개의 작업 스레드를 띄움. `::affinityPolicy`대로 번호 순의 자리에
+  // 묶는다. 0이면 예외.
+  Executor (const unsigned int nb_workers);
+  // 작업 스레드를 모두 멈춤. 이 실행기에서 도는 피어가 모두 사라진 뒤에 부를 것.
+  ~Executor ();
+
+  Executor (const Executor&) = delete;
+  Executor &operator= (const Executor&) = delete;
+
+  size_t size () const {
+    return this->__workers.size();
+  }
+
+  // 다른 작업 스레드의 큐에서 훔쳐 온 횟수.
+  uint64_t steals () const;
+
+  // 이하 `ThreadContext`가 부름.
+  // `ctx`를 실행 큐에 넣음. 어느 스레드에서든. 피어 하나는 큐에 한 번만 있어야 함.
+  void submit (ThreadContext *ctx);
+  // `at`에 피어 `id`를 깨움. 작업 스레드에서만 부를 것.
+  void wakeAt (const ContextID id, const ClockType::time_point &at);
+};
+
+#endif /* end of include guard: EXECUTOR_H_ */
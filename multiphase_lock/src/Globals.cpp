@@ -1,92 +1,409 @@
 #include "Globals.hpp"
+#include "Simulator.hpp"
 #include "ThreadContext.hpp"
+#include "Transport.hpp"
 
+#include <algorithm>
 #include <exception>
+#include <set>
 
-std::map<ContextID, ThreadContext*> threads;
+std::atomic<const PeerSnapshot*> peers(new PeerSnapshot);
+EpochDomain peerEpoch;
 std::mutex globalLock;
 
+uint32_t nodeID = 0;
+Transport *transport = nullptr;
+Simulator *simulator = nullptr;
+Executor *executor = nullptr;
+Tracer *tracer = nullptr;
+
+// 다른 노드에 있다고 알려진 피어들. `::globalLock`으로 보호.
+static std::set<ContextID> __remotePeers;
+static std::atomic<size_t> __remotePeerCount(0);
+// 피어 목록이 바뀔 때마다 올림. `::globalLock`을 잡고 씀.
+static std::atomic<uint32_t> __membershipVersion(0);
+
 std::mutex stdioLock;
-std::atomic<uint32_t> resource;
+std::vector<std::atomic<uint32_t>> resources;
+uint32_t nbLockKeys = 1;
 
 uint32_t maxAcquireDelay = 0; // in ms
 uint32_t maxLockHoldTime = 0; // in ms
+bool fixedSeed = false;
+uint64_t rngSeed = 0;
+bool reusePermissions = false;
+bool randomWorkload = true;
+double readRatio = 0.0;
+uint32_t acquireTimeout = 0; // in ms
+bool lockHandoff = false;
+uint32_t spinWait = 0; // in us
+LockEngineKind lockEngine = LOCK_ENGINE_MULTIPHASE;
+AffinityPolicy affinityPolicy = AFFINITY_NONE;
+AffinityScope affinityScope = AFFINITY_SCOPE_CPU;
 
+static const char *__ENGINE_NAMES__[] = {"multiphase", "quorum", "token"};
 
-void addContext (ThreadContext *ctx) {
-  const auto id = ctx->id();
-  Command *cmd;
+const char *lockEngineName (const LockEngineKind kind) {
+  return __ENGINE_NAMES__[kind];
+}
 
-  if (::threads.end() != ::threads.find(id)) {
-    throw std::exception();
+bool parseLockEngine (const std::string &name, LockEngineKind &kind) {
+  for (size_t i = 0; i < sizeof(__ENGINE_NAMES__) / sizeof(__ENGINE_NAMES__[0]); i += 1) {
+    if (name == __ENGINE_NAMES__[i]) {
+      kind = (LockEngineKind)i;
+      return true;
+    }
   }
+  return false;
+}
 
-  {
-    std::lock_guard<std::mutex> lg(::globalLock);
+static const char *__AFFINITY_NAMES__[] = {"none", "round-robin", "compact",
+                                           "scatter"};
+static const char *__SCOPE_NAMES__[] = {"cpu", "node"};
 
-    // 최초에 다른 스레드의 정보를 넘겨줌.
-    for (const auto &p : ::threads) {
-      cmd = new Command;
-      cmd->op_code = OPC_THREAD_SPAWNED;
-      cmd->context_from = p.first;
-      cmd->context_to = id;
+const char *affinityPolicyName (const AffinityPolicy policy) {
+  return __AFFINITY_NAMES__[policy];
+}
 
-      ctx->pushCommand(cmd);
+bool parseAffinityPolicy (const std::string &name, AffinityPolicy &policy) {
+  for (size_t i = 0; i < sizeof(__AFFINITY_NAMES__) / sizeof(__AFFINITY_NAMES__[0]); i += 1) {
+    if (name == __AFFINITY_NAMES__[i]) {
+      policy = (AffinityPolicy)i;
+      return true;
     }
+  }
+  return false;
+}
+
+const char *affinityScopeName (const AffinityScope scope) {
+  return __SCOPE_NAMES__[scope];
+}
 
-    ::threads.insert(std::make_pair(id, ctx));
+bool parseAffinityScope (const std::string &name, AffinityScope &scope) {
+  for (size_t i = 0; i < sizeof(__SCOPE_NAMES__) / sizeof(__SCOPE_NAMES__[0]); i += 1) {
+    if (name == __SCOPE_NAMES__[i]) {
+      scope = (AffinityScope)i;
+      return true;
+    }
   }
+  return false;
 }
 
-ThreadContext *popContext (const ContextID id) {
-  ThreadContext *ret;
+static bool __peerLess (const std::pair<ContextID, ThreadContext*> &a,
+                        const ContextID id) {
+  return a.first < id;
+}
 
-  {
-    std::lock_guard<std::mutex> lg(::globalLock);
-    auto it = ::threads.find(id);
+ThreadContext *PeerSnapshot::find (const ContextID id) const {
+  const auto it = std::lower_bound(this->peers.begin(), this->peers.end(), id, __peerLess);
+
+  if (it == this->peers.end() || it->first != id) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+// `::globalLock`을 잡은 상태에서 호출. 새 목록을 공개하고, 옛 목록을 보고 있을 수
+// 있는 송신자가 없어지면 옛 목록을 지움.
+static void __publish (const PeerSnapshot *next) {
+  const auto prev = ::peers.exchange(next, std::memory_order_seq_cst);
+
+  ::peerEpoch.synchronize();
+  delete prev;
+}
+
+// `::globalLock`을 잡은 상태에서 호출.
+static uint32_t __bumpVersion () {
+  const auto ret = __membershipVersion.load(std::memory_order_relaxed) + 1;
+
+  __membershipVersion.store(ret, std::memory_order_relaxed);
+  return ret;
+}
+
+// `::globalLock`을 잡은 상태에서 호출. 이 노드의 피어들에게 피어들이 생기거나
+// 사라졌다고 통보 하나로 알림.
+static void __deliverDelta (const OPCode op, const std::vector<ContextID> &ids,
+                            const uint32_t version) {
+  auto cmd = Command::make(op, 0, 0, 0, version);
+
+  if (ids.size() == 1) {
+    cmd->context_from = ids.front();
+  } else {
+    cmd->body.assign(ids.begin(), ids.end());
+  }
+  ::deliverCommand(cmd);
+}
 
-    if (it == ::threads.end()) {
-      ret = nullptr;
+void addContext (ThreadContext *ctx) {
+  ::addContexts(std::vector<ThreadContext*>(1, ctx));
+}
+
+void addContexts (const std::vector<ThreadContext*> &ctxs) {
+  std::lock_guard<std::mutex> lg(::globalLock);
+  const auto cur = ::peers.load(std::memory_order_relaxed);
+  std::vector<std::pair<ContextID, ThreadContext*>> added;
+  std::vector<ContextID> ids;
+  PeerSnapshot *next;
+  Command *view;
+  uint32_t version;
+  size_t i;
+
+  if (ctxs.empty()) {
+    return;
+  }
+
+  added.reserve(ctxs.size());
+  for (const auto &ctx : ctxs) {
+    added.push_back(std::make_pair(ctx->id(), ctx));
+  }
+  std::sort(added.begin(), added.end());
+  for (i = 0; i < added.size(); i += 1) {
+    const auto it = std::lower_bound(cur->peers.begin(), cur->peers.end(),
+                                     added[i].first, __peerLess);
+
+    if ((i > 0 && added[i - 1].first == added[i].first) ||
+        (it != cur->peers.end() && it->first == added[i].first)) {
+      throw std::exception();
     }
-    else {
-      ret = it->second;
-      ::threads.erase(it);
+    ids.push_back(added[i].first);
+  }
+
+  next = new PeerSnapshot;
+  next->peers.resize(cur->peers.size() + added.size());
+  std::merge(cur->peers.begin(), cur->peers.end(), added.begin(), added.end(),
+             next->peers.begin());
+  version = __bumpVersion();
+
+  // 최초에 다른 스레드의 정보를 넘겨줌. 새 피어들이 목록 하나를 같이 봄.
+  view = Command::make(OPC_MEMBERSHIP_VIEW, 0, 0, 0, version);
+  view->body.reserve(next->peers.size() + __remotePeers.size());
+  for (const auto &p : next->peers) {
+    view->body.push_back(p.first);
+  }
+  view->body.insert(view->body.end(), __remotePeers.begin(), __remotePeers.end());
+  for (const auto &ctx : ctxs) {
+    view->retain();
+    ctx->pushCommand(view);
+  }
+  view->release();
+
+  __publish(next);
+
+  // 목록에 올린 뒤에 알려야 다른 피어가 보내는 명령이 버려지지 않음. 피어 스레드가
+  // 스스로 알리면 목록에 오르기 전에 알려질 수 있음. 새 피어들은 받은 목록의 버전을
+  // 보고 무시함.
+  __deliverDelta(OPC_THREAD_SPAWNED, ids, version);
+  if (::transport != nullptr) {
+    ::transport->announce(ids);
+  }
+}
+
+ThreadContext *popContext (const ContextID id) {
+  const auto ret = ::popContexts(std::vector<ContextID>(1, id));
+
+  return ret.empty() ? nullptr : ret.front();
+}
+
+std::vector<ThreadContext*> popContexts (const std::vector<ContextID> &ids) {
+  std::lock_guard<std::mutex> lg(::globalLock);
+  const auto cur = ::peers.load(std::memory_order_relaxed);
+  std::vector<ContextID> sorted(ids);
+  std::vector<ThreadContext*> ret;
+  PeerSnapshot *next;
+  uint32_t version;
+
+  std::sort(sorted.begin(), sorted.end());
+  next = new PeerSnapshot;
+  next->peers.reserve(cur->peers.size());
+  for (const auto &p : cur->peers) {
+    if (std::binary_search(sorted.begin(), sorted.end(), p.first)) {
+      ret.push_back(p.second);
+    } else {
+      next->peers.push_back(p);
     }
   }
+  if (ret.empty()) {
+    delete next;
+    return ret;
+  }
+
+  version = __bumpVersion();
+  for (const auto &ctx : ret) {
+    ctx->depart(version);
+  }
+  __publish(next);
 
   return ret;
 }
 
-void clearContexts () {
-  std::map<ContextID, ThreadContext*> map;
+void retireContext (const ContextID id) {
+  ThreadContext *ctx;
 
   {
-    std::lock_guard<std::mutex> lg(::globalLock);
-    map.swap(::threads);
+    EpochDomain::Guard guard(::peerEpoch);
+
+    ctx = ::peers.load(std::memory_order_acquire)->find(id);
+  }
+  // 목록에서 빼는 것은 부르는 쪽뿐이므로 읽기 구역 밖에서 써도 됨.
+  if (ctx != nullptr) {
+    ctx->retire();
   }
+}
+
+void clearContexts () {
+  const auto ids = ::contextIDs();
 
-  for (auto &p : map) {
-    delete p.second;
+  // 넘겨준 차례가 모두 끝난 뒤에 한 번에 뺌. 남는 피어가 없으므로 나가는 피어들이
+  // 서로에게 통보할 필요가 없다.
+  for (const auto &id : ids) {
+    ::retireContext(id);
+  }
+  for (const auto &ctx : ::popContexts(ids)) {
+    delete ctx;
   }
 }
 
-void sendCommand (Command *cmd) {
+void addRemoteContext (const ContextID id) {
+  ::addRemoteContexts(std::vector<ContextID>(1, id));
+}
+
+void addRemoteContexts (const std::vector<ContextID> &ids) {
+  std::lock_guard<std::mutex> lg(::globalLock);
+  std::vector<ContextID> added;
+
+  for (const auto &id : ids) {
+    if (__remotePeers.insert(id).second) {
+      added.push_back(id);
+    }
+  }
+  if (!added.empty()) {
+    __remotePeerCount.store(__remotePeers.size(), std::memory_order_relaxed);
+    __deliverDelta(OPC_THREAD_SPAWNED, added, __bumpVersion());
+  }
+}
+
+void removeRemoteContext (const ContextID id) {
+  std::lock_guard<std::mutex> lg(::globalLock);
+
+  if (__remotePeers.erase(id) > 0) {
+    __remotePeerCount.store(__remotePeers.size(), std::memory_order_relaxed);
+    __deliverDelta(OPC_THREAD_DESPAWNED, std::vector<ContextID>(1, id),
+                   __bumpVersion());
+  }
+}
+
+void removeRemoteNode (const uint32_t node) {
   std::lock_guard<std::mutex> lg(::globalLock);
+  const auto first = __remotePeers.lower_bound(::makeContextID(node, 0));
+  const auto last = node == MAX_NODE_ID ? __remotePeers.end() :
+    __remotePeers.lower_bound(::makeContextID(node + 1, 0));
+  const std::vector<ContextID> ids(first, last);
+
+  if (ids.empty()) {
+    return;
+  }
+  __remotePeers.erase(first, last);
+  __remotePeerCount.store(__remotePeers.size(), std::memory_order_relaxed);
+  __deliverDelta(OPC_THREAD_DESPAWNED, ids, __bumpVersion());
+}
+
+size_t remoteContextCount () {
+  return __remotePeerCount.load(std::memory_order_relaxed);
+}
+
+uint32_t membershipVersion () {
+  return __membershipVersion.load(std::memory_order_relaxed);
+}
+
+size_t contextCount () {
+  EpochDomain::Guard guard(::peerEpoch);
+
+  return ::peers.load(std::memory_order_acquire)->peers.size();
+}
+
+std::vector<ContextID> contextIDs () {
+  std::vector<ContextID> ret;
+  EpochDomain::Guard guard(::peerEpoch);
+  const auto snapshot = ::peers.load(std::memory_order_acquire);
+
+  ret.reserve(snapshot->peers.size());
+  for (const auto &p : snapshot->peers) {
+    ret.push_back(p.first);
+  }
+
+  return ret;
+}
+
+void sendCommand (Command *cmd) {
+  if (::simulator != nullptr) {
+    ::simulator->post(cmd);
+    return;
+  }
+  if (::transport != nullptr) {
+    if (cmd->context_to == 0) {
+      ::transport->forward(*cmd);
+    }
+    else if (::nodeOf(cmd->context_to) != ::nodeID) {
+      ::transport->forward(*cmd);
+      cmd->release();
+      return;
+    }
+  }
+
+  ::deliverCommand(cmd);
+}
+
+void deliverCommand (Command *cmd) {
+  EpochDomain::Guard guard(::peerEpoch);
+  const auto snapshot = ::peers.load(std::memory_order_acquire);
 
   if (cmd->context_to == 0) {
-    for (const auto &p : ::threads) {
+    // 복사하지 않고 모든 수신 피어가 같은 본문을 공유.
+    for (const auto &p : snapshot->peers) {
       if (cmd->context_from != p.first) {
-        p.second->pushCommand(new Command(*cmd));
+        cmd->retain();
+        p.second->pushCommand(cmd);
       }
     }
 
-    delete cmd;
+    cmd->release();
   }
   else {
-    const auto it = ::threads.find(cmd->context_to);
+    const auto ctx = snapshot->find(cmd->context_to);
 
-    if (::threads.end() != it) {
-      it->second->pushCommand(cmd);
+    if (ctx != nullptr) {
+      ctx->pushCommand(cmd);
+    }
+    else {
+      cmd->release();
     }
   }
 }
+
+void sendCommandChain (const ContextID to, Envelope *newest, Envelope *oldest) {
+  Envelope *env, *next;
+
+  if (::simulator != nullptr) {
+    ::simulator->postChain(to, newest, oldest);
+    return;
+  }
+  if (::transport != nullptr && ::nodeOf(to) != ::nodeID) {
+    ::transport->forwardChain(to, newest, oldest);
+  }
+  else {
+    EpochDomain::Guard guard(::peerEpoch);
+    const auto ctx = ::peers.load(std::memory_order_acquire)->find(to);
+
+    if (ctx != nullptr) {
+      ctx->pushCommandChain(newest, oldest);
+      return;
+    }
+  }
+
+  oldest->next = nullptr;
+  for (env = newest; env != nullptr; env = next) {
+    next = env->next;
+    env->cmd->release();
+    Pool<Envelope>::free(env);
+  }
+}
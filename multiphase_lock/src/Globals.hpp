@@ -1,19 +1,93 @@
 #ifndef GLOBALS_H_
 #define GLOBALS_H_
 #include <cstdint>
+#include <string>
 #include <vector>
-#include <map>
 #include <mutex>
 #include <atomic>
+#include <utility>
+
+#include "Epoch.hpp"
+#include "Pool.hpp"
 
 typedef uint32_t ContextID;
+// 피어 ID의 상위 비트는 피어가 사는 노드(프로세스)의 ID. 노드 ID가 다르면 다른
+// 노드끼리도 피어 ID가 겹치지 않는다.
+static const uint32_t NODE_ID_SHIFT = 24;
+static const uint32_t MAX_NODE_ID = (1 << (32 - NODE_ID_SHIFT)) - 1;
+// 이름 붙은 락의 키. 0부터 `nbLockKeys - 1`까지.
+typedef uint32_t LockKey;
+
+// 락을 얻는 방식.
+enum LockMode {
+  // 혼자 가짐.
+  LOCK_EXCLUSIVE,
+  // 다른 공유 요청과 같이 가짐. 배타 요청과는 같이 가지지 않음.
+  LOCK_SHARED
+};
 
+class Executor;
+class Simulator;
 class ThreadContext;
-extern std::map<ContextID, ThreadContext*> threads;
+class Tracer;
+class Transport;
+
+inline ContextID makeContextID (const uint32_t node, const uint32_t local) {
+  return (node << NODE_ID_SHIFT) | local;
+}
+
+inline uint32_t nodeOf (const ContextID id) {
+  return id >> NODE_ID_SHIFT;
+}
+
+inline uint32_t localOf (const ContextID id) {
+  return id & ((1 << NODE_ID_SHIFT) - 1);
+}
+
+// 피어 목록의 한 버전. 공개된 뒤에는 바뀌지 않는다.
+struct PeerSnapshot {
+  // ID 순으로 정렬되어 있음.
+  std::vector<std::pair<ContextID, ThreadContext*>> peers;
+
+  ThreadContext *find (const ContextID id) const;
+};
+
+// 현재 피어 목록. `peerEpoch`의 읽기 구역 안에서만 따라가야 한다.
+extern std::atomic<const PeerSnapshot*> peers;
+extern EpochDomain peerEpoch;
+// 피어 목록을 바꾸는 쪽(`addContext()`, `popContext()`, `clearContexts()`)끼리만
+// 잡는 lock. 메시지를 보내는 쪽은 잡지 않는다.
 extern std::mutex globalLock;
 
+// 이 프로세스의 노드 ID.
+extern uint32_t nodeID;
+// 다른 노드와 이어주는 전송 계층. 없으면 `nullptr`. 피어를 띄우기 전에 정하고, 모든
+// 피어가 사라진 뒤에 치운다.
+extern Transport *transport;
+// 피어를 가상 시계로 돌리는 시뮬레이터. 있으면 피어가 보내는 명령은 모두 여기를
+// 거친다. 피어를 띄우기 전에 정하고, 모든 피어가 사라진 뒤에 치운다.
+extern Simulator *simulator;
+// 피어를 정해진 수의 작업 스레드에서 돌리는 실행기. 없으면 피어마다 스레드를 띄움.
+// 피어를 띄우기 전에 정하고, 모든 피어가 사라진 뒤에 치운다.
+extern Executor *executor;
+// 피어의 사건을 파일에 남기는 기록기. 없으면 `nullptr`. 피어를 띄우기 전에 정하고, 모든
+// 피어가 사라진 뒤에 치운다.
+extern Tracer *tracer;
+
 extern std::mutex stdioLock;
-extern std::atomic<uint32_t> resource;
+// 락 키별로 동시에 락을 가진 수. 배타로 가진 수는 상위 16비트에, 공유로 가진 수는
+// 하위 16비트에 센다(`resourceUnit()`). 배타로 가진 것이 다른 것과 겹치면 경쟁 상태.
+// 피어를 띄우기 전에 `nbLockKeys`개로 만들어 둔다.
+extern std::vector<std::atomic<uint32_t>> resources;
+
+static const uint32_t RESOURCE_SHARED_MASK = 0xFFFF;
+static const uint32_t RESOURCE_EXCLUSIVE_SHIFT = 16;
+
+inline uint32_t resourceUnit (const LockMode mode) {
+  return mode == LOCK_EXCLUSIVE ? 1 << RESOURCE_EXCLUSIVE_SHIFT : 1;
+}
+// 피어들이 나눠 쓰는 락 키의 수.
+extern uint32_t nbLockKeys;
 
 // 피어가 lock을 가지고 있지 않을 때, 다시 lock을 획득하기 전까지 대기할 최대 시간.
 // ms 단위.
@@ -21,34 +95,234 @@ extern uint32_t maxAcquireDelay;
 // 피어가 lock을 가지고 있을 최대 시간. 자원 획득 후 처리 시간을 시뮬레이션하기 위해 존재.
 // ms 단위.
 extern uint32_t maxLockHoldTime;
+// 참이면 피어의 랜덤 엔진을 `rngSeed`와 피어 ID로 초기화해 실행마다 같은 순서의
+// 난수를 쓰게 함.
+extern bool fixedSeed;
+extern uint64_t rngSeed;
+// 참이면 받은 "YourLock"을 상대가 다시 락을 원할 때까지 재사용함(Roucairol-Carvalho).
+// 모든 노드가 같은 값을 써야 함.
+extern bool reusePermissions;
+// 참이면 피어가 스스로 무작위로 락을 얻고 놓음. 거짓이면 락 API로 부를 때만.
+extern bool randomWorkload;
+// 무작위 작업 부하에서 공유 모드로 얻는 비율. 0이면 모두 배타, 1이면 모두 공유.
+extern double readRatio;
+// 무작위 작업 부하에서 락을 기다릴 최대 시간(ms). 넘으면 포기하고 다른 키를 얻으려
+// 함. 0이면 얻을 때까지 기다림.
+extern uint32_t acquireTimeout;
+// 참이면 "multiphase" 엔진이 배타로 가진 락을 놓을 때 기다리는 피어에게 바로 넘김.
+extern bool lockHandoff;
+// 0이 아니면 스레드를 가진 피어가 우편함이 비었을 때 바로 잠들지 않고 최대 이만큼(us)
+// 명령을 기다리며 돎. 실제로 도는 시간은 최근 명령 사이의 빈 시간에 맞춰 정함.
+extern uint32_t spinWait;
+
+// 락을 얻는 방식. 모든 노드가 같은 값을 써야 함.
+enum LockEngineKind {
+  // 모든 피어에게 허락을 받음. `MultiphaseEngine` 참고.
+  LOCK_ENGINE_MULTIPHASE,
+  // Maekawa 쿼럼. `QuorumEngine` 참고.
+  LOCK_ENGINE_QUORUM,
+  // Suzuki-Kasami 토큰. `TokenEngine` 참고.
+  LOCK_ENGINE_TOKEN
+};
+extern LockEngineKind lockEngine;
+
+const char *lockEngineName (const LockEngineKind kind);
+// "multiphase", "quorum" 또는 "token". 모르는 이름이면 거짓.
+bool parseLockEngine (const std::string &name, LockEngineKind &kind);
+
+// 피어의 스레드(작업 스레드가 있으면 작업 스레드)를 CPU에 묶는 방식. 피어는 로컬 ID
+// 순, 작업 스레드는 번호 순으로 자리를 받는다. `CpuTopology` 참고.
+enum AffinityPolicy {
+  // 묶지 않음.
+  AFFINITY_NONE,
+  // CPU 번호 순으로 돌아가며.
+  AFFINITY_ROUND_ROBIN,
+  // 한 NUMA 노드의 CPU를 다 채운 뒤 다음 노드로. 이웃한 피어끼리 노드를 나눠 씀.
+  AFFINITY_COMPACT,
+  // NUMA 노드를 돌아가며. 노드 안에서는 CPU를 돌아가며.
+  AFFINITY_SCATTER
+};
+// 묶는 단위.
+enum AffinityScope {
+  // 고른 CPU 하나에.
+  AFFINITY_SCOPE_CPU,
+  // 고른 CPU가 있는 NUMA 노드의 모든 CPU에.
+  AFFINITY_SCOPE_NODE
+};
+extern AffinityPolicy affinityPolicy;
+extern AffinityScope affinityScope;
+
+const char *affinityPolicyName (const AffinityPolicy policy);
+// "none", "round-robin", "compact" 또는 "scatter". 모르는 이름이면 거짓.
+bool parseAffinityPolicy (const std::string &name, AffinityPolicy &policy);
+const char *affinityScopeName (const AffinityScope scope);
+// "cpu" 또는 "node". 모르는 이름이면 거짓.
+bool parseAffinityScope (const std::string &name, AffinityScope &scope);
 
 enum OPCode {
   // 스레드 종료 명령
   OPC_SHUTDOWN,
-  // 스레드가 생성되었다는 통보
+  // 스레드가 생성되었다는 통보. `body`가 비어 있으면 `context_from`이, 아니면
+  // `body`의 피어들이 생김. `stamp`는 바뀐 뒤의 멤버십 버전.
   OPC_THREAD_SPAWNED,
-  // 스레드가 삭제되었다면 통보
+  // 스레드가 삭제되었다면 통보. `body`와 `stamp`는 `OPC_THREAD_SPAWNED`와 같음.
+  // 피어가 멈추며 스스로 보내면 `popContext()`가 정한 버전이거나 0.
   OPC_THREAD_DESPAWNED,
-  // "MyLock" 메시지
+  // "MyLock" 메시지. `stamp`는 요청의 Lamport 시각(31비트)을 한 비트 올리고
+  // `LockMode`를 더한 것.
   OPC_MY_LOCK,
   // "YourLock" 메시지
   OPC_YOUR_LOCK,
-  // "LockReset" 메시지
-  OPC_LOCK_RESET
+  // "LockReset" 메시지. `stamp`는 보낸 피어의 Lamport 시각.
+  OPC_LOCK_RESET,
+  // 이하 쿼럼 엔진. `stamp`는 요청의 Lamport 시각.
+  // 투표자에게 표를 달라고 함.
+  OPC_QUORUM_REQUEST,
+  // 표를 줌.
+  OPC_QUORUM_GRANT,
+  // 더 급한 요청에 표를 줬거나 기다리고 있음.
+  OPC_QUORUM_FAILED,
+  // 더 급한 요청이 왔으니 표를 돌려줄 수 있는지 물음.
+  OPC_QUORUM_INQUIRE,
+  // 받은 표를 돌려줌.
+  OPC_QUORUM_RELINQUISH,
+  // 락을 놓았거나 요청을 거둬들임.
+  OPC_QUORUM_RELEASE,
+  // 이하 토큰 엔진.
+  // 토큰을 달라고 함. `stamp`는 요청 번호.
+  OPC_TOKEN_REQUEST,
+  // 토큰을 넘김. `stamp`와 `body`는 `TokenEngine::__encodeToken()` 참고.
+  OPC_TOKEN,
+  // 토큰을 잃었는지 확인하는 라운드를 시작함. `stamp`는 라운드 세대, `body`는
+  // 사라진 피어(없으면 비어 있음). `key`는 0.
+  OPC_TOKEN_PROBE,
+  // 라운드에 답함. `body`는 키마다 (키, 플래그, 요청 번호).
+  OPC_TOKEN_PROBE_ACK,
+  // 라운드 결과. 얼려 둔 토큰을 계속 씀.
+  OPC_TOKEN_KEEP,
+  // 라운드 결과. 얼려 둔 토큰을 버림.
+  OPC_TOKEN_DROP,
+  // 다른 스레드가 락 API로 맡긴 요청을 처리하라는 신호. `ThreadContext` 참고. 노드
+  // 밖으로 나가지 않음.
+  OPC_CALL,
+  // "LockWaiting" 메시지. 허락해 준 공유 요청에게 내가 배타로 엿들으며 기다리고
+  // 있음을 알림. `stamp`는 내 요청의 시각. `MultiphaseEngine` 참고.
+  OPC_LOCK_WAITING,
+  // "LockHandoff" 메시지. 놓는 락을 기다리던 피어에게 바로 넘김. `stamp`는 몇 번째로
+  // 넘기는지, `body`는 넘기기 시작한 피어, 차례 번호와 남은 차례.
+  OPC_LOCK_HANDOFF,
+  // "LockPassed" 메시지. 넘기기 시작한 피어에게 락이 어디로 갔는지 알림. `stamp`는
+  // 몇 번째인지, `body`는 차례 번호와 받은 피어. 받은 피어가 없으면 차례가 끝남.
+  OPC_LOCK_PASSED,
+  // 새 피어에게 주는 피어 목록. `body`는 이 노드와 다른 노드의 모든 피어(받는 피어
+  // 포함), `stamp`는 목록의 멤버십 버전. 그 버전까지의 변경 통보는 받아도 무시함.
+  // 노드 밖으로 나가지 않음.
+  OPC_MEMBERSHIP_VIEW
 };
 
-struct Command {
+// 메시지 본문. 방송할 때는 하나를 모든 수신 피어가 참조 계수로 공유하므로, 보낸
+// 뒤에는 고치지 않는다. `make()`로 만들고 `release()`로 놓는다.
+struct Command : PoolLink {
   OPCode op_code;
   // 메시지를 보낸 피어의 ID. 0일 경우 피어가 보낸 메시지가 아님을 의미.
   ContextID context_from;
   // 메시지를 수신할 피어의 ID. 0일 경우 모든 피어가 수신하는 메시지를 의미.
   ContextID context_to;
+  // 락 관련 메시지가 가리키는 락.
+  LockKey key;
+  // 엔진이 쓰는 부가 값. 쿼럼 엔진에서는 요청의 시각.
+  uint32_t stamp;
+  // 엔진이 쓰는 가변 길이 본문. 전송 계층으로는 65535 단어까지 보낼 수 있음. 객체를
+  // 다시 쓸 때 용량은 그대로 두므로 안정 상태에서는 할당하지 않음.
+  std::vector<uint32_t> body;
+  std::atomic<uint32_t> refCount;
+
+  static Command *make (const OPCode op_code, const ContextID from, const ContextID to, const LockKey key = 0, const uint32_t stamp = 0) {
+    auto ret = Pool<Command>::alloc();
+
+    ret->op_code = op_code;
+    ret->context_from = from;
+    ret->context_to = to;
+    ret->key = key;
+    ret->stamp = stamp;
+    ret->body.clear();
+    ret->refCount.store(1, std::memory_order_relaxed);
+
+    return ret;
+  }
+
+  void retain () {
+    this->refCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void release () {
+    if (this->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      Pool<Command>::free(this);
+    }
+  }
+};
+
+// 피어의 우편함(`CommandQueue`)에 들어가는 봉투. 수신 피어마다 하나씩이며, 명령의
+// 참조 하나를 가진다.
+struct Envelope : PoolLink {
+  Envelope *next = nullptr;
+  Command *cmd = nullptr;
 };
 
+// 피어 목록에 올림. 새 피어에게는 피어 목록(`OPC_MEMBERSHIP_VIEW`)을, 다른
+// 피어에게는 생긴 피어들을 통보 하나로 보낸다. 피어가 목록을 받기 전에는 락 API
+// 요청을 처리하지 않는다.
 void addContext (ThreadContext *ctx);
+// 여러 피어를 한 번에 올림. 새 피어들은 목록 하나를 같이 받으므로 명령 수가 피어
+// 수에 비례한다. ID가 겹치면 아무것도 올리지 않고 예외.
+void addContexts (const std::vector<ThreadContext*> &ctxs);
+// 목록에서 뺀 뒤, 그 피어를 보고 있을 수 있는 송신자가 모두 빠져나간 다음 반환하므로
+// 반환된 피어는 바로 지워도 된다. 나간다는 통보는 그 피어가 멈추며 마지막으로 보낸다.
 ThreadContext *popContext (const ContextID id);
+// 여러 피어를 한 번에 뺌. 목록에 없는 ID는 무시. 뺀 피어끼리는 더 주고받지 못하므로
+// 바로 멈춰야 한다.
+std::vector<ThreadContext*> popContexts (const std::vector<ContextID> &ids);
+// `popContext()` 전에 부름. 그 피어가 다른 피어에게 넘겨준 락의 차례가 끝날 때까지
+// 기다림. 피어 목록을 바꾸는 쪽만 부를 것.
+void retireContext (const ContextID id);
+// 모든 피어를 `retireContext()`한 뒤 한 번에 `popContexts()`하고 지움.
 void clearContexts ();
 
+// 다른 노드의 피어가 생기거나 사라진 것을 이 노드의 피어들에게 알림. 전송 계층이
+// 부른다. 이미 알고 있는(혹은 모르는) 피어면 무시.
+void addRemoteContext (const ContextID id);
+// `ids`를 한 번에 알림. 모두 같은 노드의 피어여야 함.
+void addRemoteContexts (const std::vector<ContextID> &ids);
+void removeRemoteContext (const ContextID id);
+// 노드와의 연결이 끊겼을 때. 그 노드의 피어를 모두 지움.
+void removeRemoteNode (const uint32_t node);
+
+size_t contextCount ();
+size_t remoteContextCount ();
+// 피어 목록(다른 노드 포함)이 바뀔 때마다 오르는 멤버십 버전.
+uint32_t membershipVersion ();
+std::vector<ContextID> contextIDs ();
+
+// `func`는 `ThreadContext*`를 받음. `func` 안에서 `sendCommand()`를 부르지 말 것.
+template <class F>
+void forEachContext (F func) {
+  EpochDomain::Guard guard(::peerEpoch);
+
+  for (const auto &p : ::peers.load(std::memory_order_acquire)->peers) {
+    func(p.second);
+  }
+}
+
+// `cmd`의 참조 하나를 가져감. 다른 노드로 가는 명령과 방송은 전송 계층으로도 보냄.
+// 시뮬레이터가 있으면 시뮬레이터가 정한 시각에 전달함.
 void sendCommand (Command *cmd);
+// `sendCommand()`와 같지만 이 노드의 피어에게만 전달함.
+void deliverCommand (Command *cmd);
+// 피어 `to`에게 가는 명령 여러 개를 우편함에 한 번에 넣음. `newest`에서 `oldest`까지
+// `Envelope::next`로 최근 것부터 연결되어 있어야 함.
+void sendCommandChain (const ContextID to, Envelope *newest, Envelope *oldest);
+
+// 이 스레드에서 지금까지 `operator new`가 불린 횟수. Alloc.cpp 참고.
+uint64_t threadAllocCount ();
 
 #endif /* end of include guard: GLOBALS_H_ */
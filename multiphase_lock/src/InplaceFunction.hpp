@@ -0,0 +1,115 @@
+#ifndef INPLACEFUNCTION_H_
+#define INPLACEFUNCTION_H_
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <class Sig, size_t CAPACITY = 32>
+class InplaceFunction;
+
+// 힙을 쓰지 않는 `std::function` 대용.
+// 호출 가능한 객체를 내부 버퍼(`CAPACITY` 바이트)에 담는다. 버퍼보다 큰 객체는
+// 컴파일 오류.
+template <class R, class... Args, size_t CAPACITY>
+class InplaceFunction<R(Args...), CAPACITY> {
+protected:
+  enum __Op {
+    __OP_COPY,
+    __OP_MOVE,
+    __OP_DESTROY
+  };
+
+  typedef R (*__InvokeFunc)(void*, Args&&...);
+  typedef void (*__ManageFunc)(const __Op, void*, void*);
+
+  typename std::aligned_storage<CAPACITY, alignof(std::max_align_t)>::type __buf;
+  __InvokeFunc __invoke = nullptr;
+  __ManageFunc __manage = nullptr;
+
+  template <class F>
+  static R __invokeImpl (void *obj, Args&&... args) {
+    return (*(F*)obj)(std::forward<Args>(args)...);
+  }
+
+  template <class F>
+  static void __manageImpl (const __Op op, void *dst, void *src) {
+    switch (op) {
+    case __OP_COPY: new (dst) F(*(const F*)src); break;
+    case __OP_MOVE: new (dst) F(std::move(*(F*)src)); break;
+    case __OP_DESTROY: ((F*)dst)->~F(); break;
+    }
+  }
+
+  void __from (const __Op op, const InplaceFunction &x) {
+    if (x.__manage != nullptr) {
+      x.__manage(op, &this->__buf, (void*)&x.__buf);
+    }
+    this->__invoke = x.__invoke;
+    this->__manage = x.__manage;
+  }
+
+public:
+  InplaceFunction () {}
+
+  template <class F, class = typename std::enable_if<
+    !std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>
+  InplaceFunction (F &&f) {
+    typedef typename std::decay<F>::type FT;
+
+    static_assert(sizeof(FT) <= CAPACITY, "callable too large for InplaceFunction");
+    static_assert(alignof(FT) <= alignof(std::max_align_t), "callable over-aligned");
+
+    new (&this->__buf) FT(std::forward<F>(f));
+    this->__invoke = __invokeImpl<FT>;
+    this->__manage = __manageImpl<FT>;
+  }
+
+  InplaceFunction (const InplaceFunction &x) {
+    this->__from(__OP_COPY, x);
+  }
+
+  InplaceFunction (InplaceFunction &&x) {
+    this->__from(__OP_MOVE, x);
+    x.reset();
+  }
+
+  ~InplaceFunction () {
+    this->reset();
+  }
+
+  InplaceFunction &operator= (const InplaceFunction &x) {
+    if (this != &x) {
+      this->reset();
+      this->__from(__OP_COPY, x);
+    }
+    return *this;
+  }
+
+  InplaceFunction &operator= (InplaceFunction &&x) {
+    if (this != &x) {
+      this->reset();
+      this->__from(__OP_MOVE, x);
+      x.reset();
+    }
+    return *this;
+  }
+
+  void reset () {
+    if (this->__manage != nullptr) {
+      this->__manage(__OP_DESTROY, &this->__buf, nullptr);
+    }
+    this->__invoke = nullptr;
+    this->__manage = nullptr;
+  }
+
+  explicit operator bool () const {
+    return this->__invoke != nullptr;
+  }
+
+  R operator() (Args... args) {
+    return this->__invoke(&this->__buf, std::forward<Args>(args)...);
+  }
+};
+
+#endif /* end of include guard: INPLACEFUNCTION_H_ */
@@ -0,0 +1,127 @@
+#ifndef LATENCYHISTOGRAM_H_
+#define LATENCYHISTOGRAM_H_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 로그-선형 히스토그램. 값이 2^k 이상 2^(k+1) 미만이면 그 구간을 16칸으로 나눠
+// 세므로 백분위수의 상대 오차는 1/16 이내.
+// 기록은 한 스레드만 하고, 읽기는 어느 스레드에서든 할 수 있다(읽는 도중의 기록은
+// 반영이 안 될 수 있음).
+class LatencyHistogram {
+public:
+  static const size_t SUB_BUCKETS = 16;
+  static const size_t BUCKETS = SUB_BUCKETS * 61;
+
+protected:
+  std::atomic<uint64_t> __buckets[BUCKETS];
+  std::atomic<uint64_t> __count;
+  std::atomic<uint64_t> __sum;
+  std::atomic<uint64_t> __max;
+
+  static void __bump (std::atomic<uint64_t> &x, const uint64_t v) {
+    x.store(x.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+  }
+
+  static size_t __index (const uint64_t v) {
+    unsigned int k;
+
+    if (v < SUB_BUCKETS) {
+      return (size_t)v;
+    }
+    k = 63 - (unsigned int)__builtin_clzll(v);
+    return SUB_BUCKETS + (k - 4) * SUB_BUCKETS + (size_t)((v >> (k - 4)) & (SUB_BUCKETS - 1));
+  }
+
+  // 칸에 들어가는 가장 큰 값.
+  static uint64_t __upper (const size_t idx) {
+    size_t k, sub;
+
+    if (idx < SUB_BUCKETS) {
+      return idx;
+    }
+    k = (idx - SUB_BUCKETS) / SUB_BUCKETS + 4;
+    sub = (idx - SUB_BUCKETS) % SUB_BUCKETS;
+    return ((uint64_t)(SUB_BUCKETS + sub + 1) << (k - 4)) - 1;
+  }
+
+public:
+  LatencyHistogram () : __count(0), __sum(0), __max(0) {
+    for (auto &b : this->__buckets) {
+      b.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void record (const uint64_t v) {
+    __bump(this->__buckets[__index(v)], 1);
+    __bump(this->__count, 1);
+    __bump(this->__sum, v);
+    if (v > this->__max.load(std::memory_order_relaxed)) {
+      this->__max.store(v, std::memory_order_relaxed);
+    }
+  }
+
+  // 이 히스토그램에 기록하는 스레드가 없을 때만 부를 것. `x`는 기록 중이어도 되지만
+  // 그 사이의 기록은 빠질 수 있음.
+  void merge (const LatencyHistogram &x) {
+    uint64_t n = 0, v;
+    size_t i;
+
+    for (i = 0; i < BUCKETS; i += 1) {
+      v = x.__buckets[i].load(std::memory_order_relaxed);
+      __bump(this->__buckets[i], v);
+      n += v;
+    }
+    // 칸의 합과 맞도록 `x.count()` 대신 직접 센 값을 씀.
+    __bump(this->__count, n);
+    __bump(this->__sum, x.sum());
+    if (x.max() > this->max()) {
+      this->__max.store(x.max(), std::memory_order_relaxed);
+    }
+  }
+
+  uint64_t count () const {
+    return this->__count.load(std::memory_order_relaxed);
+  }
+
+  uint64_t sum () const {
+    return this->__sum.load(std::memory_order_relaxed);
+  }
+
+  uint64_t max () const {
+    return this->__max.load(std::memory_order_relaxed);
+  }
+
+  double mean () const {
+    const auto n = this->count();
+
+    return n == 0 ? 0.0 : (double)this->sum() / (double)n;
+  }
+
+  // `q`(0 < q <= 1) 백분위수. 기록이 없으면 0.
+  uint64_t percentile (const double q) const {
+    const auto n = this->count();
+    uint64_t rank, acc = 0, ret;
+    size_t i;
+
+    if (n == 0) {
+      return 0;
+    }
+    rank = (uint64_t)(q * (double)n + 0.5);
+    if (rank == 0) {
+      rank = 1;
+    }
+
+    for (i = 0; i < BUCKETS; i += 1) {
+      acc += this->__buckets[i].load(std::memory_order_relaxed);
+      if (acc >= rank) {
+        ret = __upper(i);
+        return ret < this->max() ? ret : this->max();
+      }
+    }
+
+    return this->max();
+  }
+};
+
+#endif /* end of include guard: LATENCYHISTOGRAM_H_ */
@@ -1,33 +1,77 @@
 #ifndef LOCKCONTEXT_H_
 #define LOCKCONTEXT_H_
 #include "Globals.hpp"
+#include "PeerSet.hpp"
 
-#include <set>
+#include <unordered_map>
+#include <vector>
 
 struct LockContext {
   enum LockState {
     NONE,
     LURKING,
     SOLICITING,
-    ACQUIRED
+    ACQUIRED,
+    // 놓으면서 다른 피어에게 넘겨줌. 차례가 끝날 때까지 다른 피어에게는
+    // `ACQUIRED`처럼 보인다.
+    HANDED_OFF
   };
 
   LockState state = NONE;
+  // 얻으려 하거나 가지고 있는 모드. `NONE`일 때는 의미 없음.
+  LockMode mode = LOCK_EXCLUSIVE;
+  // 얻으려 하기 시작한 요청의 Lamport 시각. `NONE`일 때는 의미 없음.
+  uint32_t stamp = 0;
+  // 한꺼번에 얻으려는 키들(이 키 포함). 하나만 얻으려 하면 비어 있음. 모두 얻으면
+  // 비운다.
+  std::vector<LockKey> group;
 
-  // 내가 락을 얻으려 한 시점에, "MyLock" 명령을 보낸 곳들.
+  // 이하 컬렉션은 모두 `MultiphaseEngine`이 붙인 피어 슬롯의 집합.
+
+  // 내가 락을 얻으려 한 시점에, "MyLock" 명령이나 "LockWaiting"을 보낸 곳들. 놓거나
+  // 포기할 때 "LockReset"을 보냄.
   // 중간에 다른 Context가 접속했으면, 그 Context는 이 컬렉션에 존재하지 않음.
   // 단, 중간에 이미 존재하던 Context가 사라지면, 그 Context를 이 컬렉션에서 제거하는 처리는
   // 함.
-  std::set<ContextID> sentMyLock;
+  PeerSet sentMyLock;
   // "YourLock" 명령을 받아야하는 곳들.
   // `SOLICITING` 상태에서 이 컬렉션에 아이템이 없으면 `ACQUIRED` 상태로 진입한다.
-  std::set<ContextID> yourLockToRcv;
+  PeerSet yourLockToRcv;
   // "YourLock" 명령을 보내야할 곳들 (deferred)
-  // `SOLICITING` 상태에서 나보다 우선순위가 낮은 곳에서 "MyLock" 명령이 수신되면
-  // "기억"할 때 씀.
-  std::set<ContextID> yourLockToSend;
+  // 배타로 `LURKING`이거나 `SOLICITING` 상태에서 나보다 나중인 요청의 "MyLock"
+  // 명령이 수신되면 "기억"할 때 씀.
+  PeerSet yourLockToSend;
   // `MyLock` 명령을 받은 곳들 (락을 얻으려는 곳들)
-  std::set<ContextID> rcvMyLock;
+  PeerSet rcvMyLock;
+  // 배타로 얻으려는 곳들. 배타 "MyLock"을 보낸 곳과 "LockWaiting"을 보낸 곳. 둘 다
+  // "LockReset"을 받으면 뺀다.
+  PeerSet rcvExclusive;
+  // `rcvExclusive`에 든 곳의 요청 시각(슬롯별). 락을 넘길 차례를 정할 때 씀.
+  // `rcvExclusive`에 없는 슬롯의 값은 의미 없음.
+  std::vector<uint32_t> exclusiveStamp;
+  // 포기한 요청에 대해 아직 올 "YourLock" 수(슬롯별). 포기할 때 답을 받지 못한
+  // 곳은 바로 주었든 미뤄 뒀다가 "LockReset"을 받고 주든 꼭 하나를 보내므로, 올
+  // 때마다 하나씩 빼고 버린다. 보낸 순서대로 도착하므로 다시 얻으려는 중에 와도 새
+  // 요청에 대한 것보다 먼저 온다. 그 전에 또 포기하면 둘이 됨.
+  std::unordered_map<uint32_t, uint32_t> staleYourLock;
+  // 이하 `::lockHandoff`일 때 씀.
+  // 넘겨받아 가지고 있으면 넘기기 시작한 피어, 그 차례 번호, 몇 번째로 받았는지와
+  // 다음에 넘길 피어들(요청이 먼저인 것부터). 아니면 `handoffAnchor`는 0.
+  ContextID handoffAnchor = 0;
+  uint32_t handoffChain = 0;
+  uint32_t handoffHop = 0;
+  std::vector<ContextID> handoffQueue;
+  // 넘기기 시작한 쪽에서 쓰는 지금 차례의 번호, 락이 마지막으로 간 곳과 몇 번째인지.
+  uint32_t chainID = 0;
+  ContextID chainAt = 0;
+  uint32_t chainHop = 0;
+  // `HANDED_OFF`인 동안 다시 얻으려 함. 차례가 끝나면 얻으려 함.
+  bool reacquire = false;
+
+  // 받아 둔 "YourLock" 중 아직 유효한 것들(`::reusePermissions`일 때만 씀).
+  // 상대에게 "YourLock"을 보내면 무효가 된다. 여기 있는 곳에는 "MyLock"을 보내지
+  // 않고도 락을 얻을 수 있음.
+  PeerSet permissions;
 };
 
 #endif /* end of include guard: LOCKCONTEXT_H_ */
@@ -0,0 +1,100 @@
+#ifndef LOCKENGINE_H_
+#define LOCKENGINE_H_
+#include "Globals.hpp"
+#include "Tracer.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#define __REPORT(msg) this->__report(__FILE__, __LINE__, msg)
+
+// 락을 얻고 놓는 프로토콜. 피어(`ThreadContext`)는 우편함, 타이머와 작업 부하를
+// 맡고, 락에 관한 명령은 모두 엔진에 넘긴다. 엔진은 피어의 스레드에서만 불린다.
+class LockEngine {
+public:
+  // 엔진을 돌리는 피어.
+  class Host {
+  public:
+    virtual ~Host() {}
+
+    // `cmd`의 참조 하나를 가져감. 바로 보내지 않을 수 있음.
+    virtual void engineSend(Command *cmd) = 0;
+    // 락 `key`를 얻었음. `acquire()` 안에서 바로 불릴 수도 있음.
+    virtual void engineAcquired(const LockKey key) = 0;
+    // 지금 시각. 시뮬레이션 중에는 가상 시계.
+    virtual std::chrono::steady_clock::time_point engineNow() = 0;
+  };
+
+protected:
+  Host &__host;
+  const ContextID __id;
+  // 지금 알고 있는 다른 피어들.
+  std::set<ContextID> __others;
+
+  void __report(const char *file, const uint32_t line, const std::string msg) {
+    if (::tracer != nullptr) {
+      ::tracer->record(TRACE_REPORT, this->__id, this->__host.engineNow(), 0, 0,
+                       0, line);
+    }
+
+    std::lock_guard<std::mutex> lg(::stdioLock);
+    std::cerr << msg << " (" << file << ':' << line << ')' << std::endl;
+  }
+
+  Command *__makeMyCommand(const OPCode op_code, const ContextID to,
+                            const LockKey key = 0, const uint32_t stamp = 0) {
+    return Command::make(op_code, this->__id, to, key, stamp);
+  }
+
+  void __send(Command *cmd) {
+    this->__host.engineSend(cmd);
+  }
+
+public:
+  LockEngine(Host &host, const ContextID id) : __host(host), __id(id) {}
+  virtual ~LockEngine() {}
+
+  LockEngine(const LockEngine&) = delete;
+  LockEngine &operator=(const LockEngine&) = delete;
+
+  virtual void peerJoined(const ContextID id) {
+    this->__others.insert(id);
+  }
+
+  virtual void peerLeft(const ContextID id) {
+    this->__others.erase(id);
+  }
+
+  // 피어 생성/삭제와 종료 명령을 뺀 나머지 명령.
+  virtual void handle(const Command &cmd) = 0;
+  // 락 `key`를 `mode`로 얻으려 함. 이미 얻으려 하는 중이거나 가지고 있으면 거짓.
+  virtual bool acquire(const LockKey key, const LockMode mode) = 0;
+  // 락 `keys`를 모두 배타로 한꺼번에 얻으려 함. `keys`는 정렬되어 있고 겹치지
+  // 않으며, 어느 것도 얻으려 하는 중이거나 가지고 있지 않아야 함. 모두 얻으면 키마다
+  // `engineAcquired()`를 부르고, 놓을 때는 키마다 `release()`. 한꺼번에 얻지 못하는
+  // 엔진이면 아무것도 하지 않고 거짓.
+  virtual bool acquireAll(const std::vector<LockKey> &) {
+    return false;
+  }
+  // 가지고 있는 락 `key`를 놓음. 얻으려는 중이면 포기하고, 그 뒤로 이 요청에 대해
+  // `engineAcquired()`를 부르지 않음. `acquireAll()`로 얻으려는 중인 키를 포기하면
+  // 같이 얻으려던 키도 모두 포기함.
+  virtual void release(const LockKey key) = 0;
+  // 공유로 가지고 있는 락 `key`를 이 피어의 다른 공유 요청도 같이 써도 되는지. 다른
+  // 피어의 배타 요청이 기다리고 있으면 거짓이어야 그 요청이 굶지 않는다.
+  virtual bool shareable(const LockKey) {
+    return false;
+  }
+  // 곧 멈춤. 이후로는 락을 다른 피어에게 넘겨주기 시작하지 않음.
+  virtual void retire() {}
+  // 다른 피어에게 넘겨준 락의 차례가 아직 끝나지 않았는지. 넘겨받은 피어는 이
+  // 피어가 다른 피어를 막아 주는 덕에 겹치지 않으므로, 참이면 멈추지 말아야 함.
+  virtual bool lingering() {
+    return false;
+  }
+};
+
+#endif /* end of include guard: LOCKENGINE_H_ */
@@ -0,0 +1,901 @@
+#ifndef MULTIPHASEENGINE_H_
+#define MULTIPHASEENGINE_H_
+#include "LockContext.hpp"
+#include "LockEngine.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+// 모든 다른 피어에게 허락("YourLock")을 받아야 락을 얻는 기본 프로토콜.
+// 요청은 얻으려 하기 시작할 때 Lamport 시각을 받고, 락을 얻으려는 피어끼리는
+// Ricart–Agrawala처럼 (시각, ID)가 작은 쪽이 먼저 얻는다. 배타로 엿들으며 기다리는
+// 피어도 나중인 요청에는 답을 미루므로, 오래 기다린 요청이 새로 온 요청에 밀리지
+// 않고 ID가 낮은 피어가 늘 지지도 않는다. 공유 요청끼리는 서로 기다리지 않고 바로
+// 허락한다. 배타 요청이 기다리고 있으면 새 공유 요청은 그 뒤로 미뤄서 배타 요청이
+// 굶지 않게 한다.
+// 여러 키를 한꺼번에 얻을 때는 "MyLock" 하나에 키들을 모두 실어 보내고, 모든 키의
+// 허락을 다 받아야 얻는다. 키들은 한 시각을 같이 쓰므로 기다림은 늘 더 먼저인
+// 요청이나 락을 가진 쪽으로만 향하고, 교착이 생기지 않는다.
+// `::lockHandoff`이면 배타로 엿들으며 기다리는 피어가 허락해 준 배타 요청에도
+// 기다린다고 알린다. 그 요청이 락을 얻은 뒤 놓을 때 기다린다고 알려 온 곳이 있으면,
+// 허락을 풀지 않고(`HANDED_OFF`) 그중 요청이 가장 먼저인 피어에게 락을 바로 넘긴다.
+// 차례도 다른 요청처럼 (시각, ID) 순서로 정하므로 넘기기가 ID 순서를 되살리지 않는다.
+// 넘겨받은 피어는 다 쓰면 나머지 차례의 다음 피어에게 넘기고, 차례가 끝나면 처음 넘긴 피어가
+// 그제야 허락을 푼다. 그동안 다른 피어는 처음 넘긴 피어에게 막혀 있으므로 차례 안의
+// 피어끼리만 락을 주고받는다.
+// 피어는 슬롯 번호로 바꿔서 비트맵(`PeerSet`)에 담는다.
+class MultiphaseEngine : public LockEngine {
+protected:
+  // 락 키별 상태. 처음 쓰일 때 만듦.
+  std::unordered_map<LockKey, LockContext> __lockCtxs;
+  PeerSlots __slots;
+  // `__others`의 슬롯들.
+  PeerSet __members;
+  // 여러 키에 대한 명령을 처리할 때 쓰는 임시 공간.
+  std::vector<LockKey> __keys;
+  // 락을 넘길 차례를 다룰 때 쓰는 임시 공간.
+  std::vector<ContextID> __queue;
+  std::vector<std::pair<uint32_t, ContextID>> __order;
+  // 참이면 곧 멈추므로 락을 넘겨주기 시작하지 않음.
+  bool __retiring = false;
+  // Lamport 시계. 요청을 시작하거나 놓을 때 올리고, "MyLock"이나 "LockReset"을
+  // 받으면 그 시각까지 당김. 31비트에서 한 바퀴 돌므로 앞뒤는 `__before()`로 따짐.
+  uint32_t __clock = 0;
+  // 다른 피어의 시각을 받은 적이 있는지.
+  bool __synced = false;
+
+  LockContext &__lockContext(const LockKey key) {
+    return this->__lockCtxs[key];
+  }
+
+  // 바로 허락을 구해도 되는지. 아니면 엿들으며 기다림. 배타는 허락해 준 요청이
+  // 있으면, 공유는 배타로 얻으려는 곳이 있으면 기다린다. 허락해 준 요청이 끝나기
+  // 전에 허락을 구하면, 받아 둔 허락을 그 요청이 다시 구하지 않으므로 둘 다 얻을 수
+  // 있다. 답을 미뤄 둔 요청은 내 허락 없이는 얻지 못하므로 기다리지 않음.
+  bool __canSolicit(const LockContext &lc) {
+    return (lc.mode == LOCK_SHARED ? lc.rcvExclusive : lc.rcvMyLock)
+        .isSubsetOf(lc.yourLockToSend);
+  }
+
+  // 새 요청을 시작함. 한꺼번에 얻는 키들은 한 시각을 같이 씀.
+  uint32_t __tick() {
+    // "MyLock"에 모드와 같이 실으므로 31비트.
+    this->__clock = (this->__clock + 1) & 0x7FFFFFFF;
+    return this->__clock;
+  }
+
+  // "MyLock"의 `stamp`. 요청의 시각과 모드.
+  static uint32_t __myLockStamp(const LockContext &lc) {
+    return lc.stamp << 1 | (uint32_t)lc.mode;
+  }
+
+  // 31비트 시각 `a`가 `b`보다 앞인지. 시계가 한 바퀴 돌아도 둘의 차이가 2^30보다
+  // 작으면 맞음. 함께 얻으려는 요청들의 시각은 그보다 훨씬 가까움.
+  static bool __before(const uint32_t a, const uint32_t b) {
+    return (int32_t)((a - b) << 1) < 0;
+  }
+
+  // 시각 `stamp`인 `id`의 요청이 시각 `otherStamp`인 `other`의 요청보다 먼저인지.
+  static bool __earlier(const uint32_t stamp, const ContextID id,
+                        const uint32_t otherStamp, const ContextID other) {
+    return stamp != otherStamp ? __before(stamp, otherStamp) : id < other;
+  }
+
+  // 받은 시각 `stamp`까지 시계를 당김. 처음 받을 때는 내가 올린 만큼만 시계가 가
+  // 있으므로, 늦게 들어와 2^30 넘게 뒤처졌어도 따라잡도록 그냥 큰 쪽을 따름.
+  void __observe(const uint32_t stamp) {
+    if (this->__synced ? __before(this->__clock, stamp)
+                       : stamp > this->__clock) {
+      this->__clock = stamp;
+    }
+    this->__synced = true;
+  }
+
+  // 시각 `stamp`인 `from`의 요청이 내 요청보다 먼저인지.
+  bool __prior(const uint32_t stamp, const ContextID from,
+               const LockContext &lc) {
+    return __earlier(stamp, from, lc.stamp, this->__id);
+  }
+
+  void __cmdMyLock(const Command &cmd) {
+    const auto slot = this->__slots.slotOf(cmd.context_from);
+    const auto shared = (cmd.stamp & 1) == LOCK_SHARED;
+    const auto stamp = cmd.stamp >> 1;
+    Command *reply;
+
+    this->__observe(stamp);
+
+    if (cmd.body.empty()) {
+      this->__onMyLock(cmd.context_from, slot, cmd.key, shared, stamp, nullptr);
+      return;
+    }
+
+    // 여러 키를 한꺼번에 얻으려 함. 바로 줄 수 있는 허락은 "YourLock" 하나로 묶음.
+    this->__keys.clear();
+    for (const auto key : cmd.body) {
+      this->__onMyLock(cmd.context_from, slot, key, shared, stamp,
+                       &this->__keys);
+    }
+    if (this->__keys.empty()) {
+      return;
+    }
+    reply = this->__makeMyCommand(OPC_YOUR_LOCK, cmd.context_from,
+                                  this->__keys.front());
+    if (this->__keys.size() > 1) {
+      reply->body = this->__keys;
+    }
+    this->__send(reply);
+    for (const auto key : this->__keys) {
+      this->__regainPermission(this->__lockContext(key), slot, key);
+    }
+  }
+
+  // 키 하나에 대한 "MyLock". `granted`가 있으면 바로 줄 허락을 보내지 않고 거기
+  // 모음.
+  void __onMyLock(const ContextID from, const uint32_t slot, const LockKey key,
+                  const bool shared, const uint32_t stamp,
+                  std::vector<LockKey> *granted) {
+    auto &lc = this->__lockContext(key);
+    const auto grant = [&]() {
+      if (granted == nullptr) {
+        this->__grantLock(lc, slot, key);
+      } else {
+        granted->push_back(key);
+      }
+    };
+
+    lc.rcvMyLock.insert(slot);
+    if (!shared) {
+      this->__waitsExclusive(lc, slot, stamp);
+    }
+
+    switch (lc.state) {
+    // 락을 얻으려하지 않는 상태일 때.
+    case LockContext::NONE:
+      // 락을 그냥 준다.
+      grant();
+      break;
+    case LockContext::LURKING: // 엿들으며 기다리는 상태일 때.
+      // 배타로 기다리면 나중인 요청에는 답을 미룸. 그래야 기다림이 끝나기 전에 새로
+      // 온 요청에 밀리지 않음. 공유로 기다리면 기다린다고 알려 온 나중인 배타 요청을
+      // 기다릴 수 있으므로, 미루면 서로 기다릴 수 있어 모두 준다.
+      if (lc.mode == LOCK_SHARED || this->__prior(stamp, from, lc)) {
+        grant();
+        if (lc.mode == LOCK_EXCLUSIVE && (shared || this->__announces(lc))) {
+          this->__notifyWaiting(lc, slot, key);
+        }
+      } else {
+        lc.yourLockToSend.insert(slot);
+        // 다시 구한 요청이었으면 이제 기다리지 않아도 될 수 있음.
+        this->__trySolicit(key);
+      }
+      break;
+    case LockContext::SOLICITING: // 내가 락을 얻고 싶은 상태일 떄.
+      if (shared && lc.mode == LOCK_SHARED) { // 같이 가질 수 있음.
+        grant();
+      } else if (this->__prior(stamp, from, lc)) { // 나보다 먼저인 요청.
+        // 락을 준다.
+        grant();
+      } else { // 나보다 나중인 요청.
+        // 락을 풀때 준다.
+        lc.yourLockToSend.insert(slot);
+      }
+      break;
+    case LockContext::ACQUIRED:
+      if (shared && lc.mode == LOCK_SHARED) {
+        grant();
+      } else {
+        lc.yourLockToSend.insert(slot);
+      }
+      break;
+    case LockContext::HANDED_OFF:
+      // 넘겨받은 피어가 쓰는 중. 차례가 끝나면 줌.
+      lc.yourLockToSend.insert(slot);
+      break;
+    }
+  }
+
+  void __cmdYourLock(const Command &cmd) {
+    const auto slot = this->__slots.slotOf(cmd.context_from);
+
+    if (cmd.body.empty()) {
+      this->__onYourLock(cmd.context_from, slot, cmd.key);
+      return;
+    }
+    for (const auto key : cmd.body) {
+      this->__onYourLock(cmd.context_from, slot, key);
+    }
+  }
+
+  void __onYourLock(const ContextID from, const uint32_t slot,
+                    const LockKey key) {
+    auto &lc = this->__lockContext(key);
+
+    {
+      const auto it = lc.staleYourLock.find(slot);
+
+      if (it != lc.staleYourLock.end()) {
+        // 포기한 요청에 대한 늦은 허락.
+        if (--it->second == 0) {
+          lc.staleYourLock.erase(it);
+        }
+        return;
+      }
+    }
+
+    // 공유 요청에 준 허락은 상대도 가지고 있는 중일 수 있으므로 재사용하지 않음.
+    if (::reusePermissions && lc.mode == LOCK_EXCLUSIVE) {
+      lc.permissions.insert(slot);
+    }
+
+    if (lc.state == LockContext::SOLICITING) {
+      lc.yourLockToRcv.erase(slot);
+      this->__permitted(key);
+    } else { // WHAT??
+      // 내가 보낸 "LockReset" 명령이 이 end에 전달이 안 된 상태에서 보낸 것일
+      // 수 있음. 일단 보고하기.
+      std::stringstream ss;
+
+      ss << "* Rogue 'YourLock' command received from context " << from
+         << " by " << this->__id << " for key " << key << '.';
+      __REPORT(ss.str());
+    }
+  }
+
+  void __cmdLockReset(const Command &cmd) {
+    auto &lc = this->__lockContext(cmd.key);
+    const auto slot = this->__slots.slotOf(cmd.context_from);
+
+    // 엿들으며 기다리는 피어는 "MyLock"을 보내지 않으므로, 이것이 없으면 그동안 새로
+    // 시작한 요청들이 모두 같은 시각을 받아 ID 순으로 얻게 됨.
+    this->__observe(cmd.stamp);
+
+    lc.rcvMyLock.erase(slot);
+    lc.rcvExclusive.erase(slot);
+    if (lc.yourLockToSend.erase(slot)) {
+      // 답을 미뤄 둔 요청을 포기함. 상대가 버릴 수 있도록 답은 함.
+      this->__send(
+          this->__makeMyCommand(OPC_YOUR_LOCK, cmd.context_from, cmd.key));
+    }
+
+    if (lc.state == LockContext::LURKING) {
+      // 엿듣던 중 - 아무도 락을 걸려 하지 않으면 내가 락을 얻을 차례.
+      this->__trySolicit(cmd.key);
+    }
+  }
+
+  // 시각을 받은 요청을 시작함.
+  void __start(LockContext &lc, const LockKey key) {
+    if (this->__others.empty()) {
+      // 혼자 있음. 바로 락을 얻은 것으로 처리.
+      lc.state = LockContext::ACQUIRED;
+      this->__host.engineAcquired(key);
+    } else {
+      if (this->__canSolicit(lc)) {
+        // 아무도 락을 얻으려 하지 않음.
+        lc.state = LockContext::SOLICITING;
+        this->__solicitLock(&key, 1);
+      } else {
+        // 이미 누군가 락을 얻으려 하고 있음.
+        // 다 끝날 때까지 기다림.
+        this->__lurk(lc, key);
+      }
+    }
+  }
+
+  // 엿듣던 `key`를 이제 얻으려 해도 되면 허락을 구함. 여러 키를 한꺼번에 얻으려는
+  // 중이면 모든 키가 그래야 함.
+  void __trySolicit(const LockKey key) {
+    auto &lc = this->__lockContext(key);
+    std::vector<LockKey> keys;
+
+    if (lc.group.empty()) {
+      if (this->__canSolicit(lc)) {
+        lc.state = LockContext::SOLICITING;
+        this->__solicitLock(&key, 1);
+      }
+      return;
+    }
+
+    for (const auto k : lc.group) {
+      const auto &other = this->__lockContext(k);
+
+      if (other.state != LockContext::LURKING || !this->__canSolicit(other)) {
+        return;
+      }
+    }
+    for (const auto k : lc.group) {
+      this->__lockContext(k).state = LockContext::SOLICITING;
+    }
+    // 얻으면 `group`을 비우므로 복사해서 씀.
+    keys = lc.group;
+    this->__solicitLock(keys.data(), keys.size());
+  }
+
+  // `SOLICITING`인 `key`의 허락을 모두 받았으면 얻음. 한꺼번에 얻으려는 키들이
+  // 있으면 그 키들도 모두 받았을 때 같이 얻음.
+  void __permitted(const LockKey key) {
+    auto &lc = this->__lockContext(key);
+    std::vector<LockKey> keys;
+
+    if (lc.state != LockContext::SOLICITING || !lc.yourLockToRcv.empty()) {
+      return;
+    }
+    if (lc.group.empty()) {
+      lc.state = LockContext::ACQUIRED;
+      this->__host.engineAcquired(key);
+      return;
+    }
+
+    for (const auto k : lc.group) {
+      const auto &other = this->__lockContext(k);
+
+      if (other.state != LockContext::SOLICITING ||
+          !other.yourLockToRcv.empty()) {
+        return;
+      }
+    }
+    // 알리는 동안 피어가 키를 놓을 수 있으므로 먼저 모두 얻은 것으로 해 둠.
+    keys.swap(lc.group);
+    for (const auto k : keys) {
+      auto &other = this->__lockContext(k);
+
+      other.state = LockContext::ACQUIRED;
+      other.group.clear();
+    }
+    for (const auto k : keys) {
+      this->__host.engineAcquired(k);
+    }
+  }
+
+  // 엿들으며 기다림. 배타로 기다리면 허락해 준 공유 요청들에 알림. 넘겨받을 수
+  // 있으면 배타 요청들에도 알림.
+  void __lurk(LockContext &lc, const LockKey key) {
+    const auto all = this->__announces(lc);
+
+    lc.state = LockContext::LURKING;
+    if (lc.mode == LOCK_EXCLUSIVE) {
+      lc.rcvMyLock.forEach([&](const uint32_t slot) {
+        if (all || !lc.rcvExclusive.contains(slot)) {
+          this->__notifyWaiting(lc, slot, key);
+        }
+      });
+    }
+  }
+
+  // 공유 요청을 받은 곳은 내가 배타로 엿들으며 기다린다는 것을 모르므로 알림. 받은
+  // 곳은 가지고 있는 공유 락을 이 피어 안에서 더 나눠 주지 않고, 다음 공유 요청은
+  // 내 요청 뒤로 미룬다. 그래서 공유 요청이 계속 겹쳐 들어와도 기다림이 끝난다.
+  void __cmdLockWaiting(const Command &cmd) {
+    auto &lc = this->__lockContext(cmd.key);
+
+    this->__waitsExclusive(lc, this->__slots.slotOf(cmd.context_from), cmd.stamp);
+  }
+
+  // `slot`이 시각 `stamp`의 요청으로 배타로 얻으려 함.
+  void __waitsExclusive(LockContext &lc, const uint32_t slot,
+                        const uint32_t stamp) {
+    lc.rcvExclusive.insert(slot);
+    if (slot >= lc.exclusiveStamp.size()) {
+      lc.exclusiveStamp.resize(slot + 1);
+    }
+    lc.exclusiveStamp[slot] = stamp;
+  }
+
+  bool __handoff() {
+    return ::lockHandoff && !::reusePermissions;
+  }
+
+  // 배타로 엿들으며 기다릴 때 허락해 준 배타 요청에도 알릴지. 알려 두면 그 요청이
+  // 락을 놓을 때 넘겨받을 수 있음. 한꺼번에 얻으려는 키는 하나만 넘겨받아도 쓸 수
+  // 없으므로 알리지 않음.
+  bool __announces(const LockContext &lc) {
+    return this->__handoff() && lc.group.empty();
+  }
+
+  void __notifyWaiting(LockContext &lc, const uint32_t slot, const LockKey key) {
+    this->__send(this->__makeMyCommand(OPC_LOCK_WAITING,
+                                       this->__slots.idOf(slot), key, lc.stamp));
+    lc.sentMyLock.insert(slot);
+  }
+
+  // "YourLock"을 보냄.
+  void __grantLock(LockContext &lc, const uint32_t slot, const LockKey key) {
+    this->__send(
+        this->__makeMyCommand(OPC_YOUR_LOCK, this->__slots.idOf(slot), key));
+    this->__regainPermission(lc, slot, key);
+  }
+
+  // 허락을 내주면 그 피어에게 받아 두었던 허락은 무효가 되므로, 락을 얻으려는
+  // 중이었다면 다시 구함. 한꺼번에 얻으려는 중이면 다른 키를 기다리는 동안 이미
+  // 허락을 받은 키가 있을 수 있음.
+  void __regainPermission(LockContext &lc, const uint32_t slot,
+                          const LockKey key) {
+    const auto reused = ::reusePermissions && lc.permissions.erase(slot);
+
+    if (lc.state != LockContext::SOLICITING) {
+      return;
+    }
+    if (reused || (!lc.group.empty() && lc.sentMyLock.contains(slot) &&
+                   !lc.yourLockToRcv.contains(slot))) {
+      this->__send(this->__makeMyCommand(OPC_MY_LOCK, this->__slots.idOf(slot),
+                                         key, __myLockStamp(lc)));
+      lc.sentMyLock.insert(slot);
+      lc.yourLockToRcv.insert(slot);
+    }
+  }
+
+  // `keys`의 허락을 구함. 여러 키면 피어마다 "MyLock" 하나에 그 피어에게 물어볼
+  // 키들을 모두 실음.
+  void __solicitLock(const LockKey *keys, const size_t n) {
+    for (size_t i = 0; i < n; i += 1) {
+      auto &lc = this->__lockContext(keys[i]);
+
+      // 지난번에 받은 허락이 아직 유효한 곳은 뺌. 재사용하지 않으면 `permissions`는
+      // 늘 비어 있음.
+      lc.yourLockToRcv.assignDifference(this->__members, lc.permissions);
+      lc.sentMyLock.unite(lc.yourLockToRcv);
+    }
+
+    if (n == 1) {
+      const auto key = keys[0];
+      const auto &lc = this->__lockContext(key);
+
+      lc.yourLockToRcv.forEach([&](const uint32_t slot) {
+        this->__send(this->__makeMyCommand(OPC_MY_LOCK,
+                                           this->__slots.idOf(slot), key,
+                                           __myLockStamp(lc)));
+      });
+    } else {
+      this->__members.forEach([&](const uint32_t slot) {
+        Command *cmd = nullptr;
+
+        for (size_t i = 0; i < n; i += 1) {
+          const auto &lc = this->__lockContext(keys[i]);
+
+          if (!lc.yourLockToRcv.contains(slot)) {
+            continue;
+          }
+          if (cmd == nullptr) {
+            cmd = this->__makeMyCommand(OPC_MY_LOCK, this->__slots.idOf(slot),
+                                        keys[i], __myLockStamp(lc));
+          }
+          cmd->body.push_back(keys[i]);
+        }
+        if (cmd == nullptr) {
+          return;
+        }
+        if (cmd->body.size() == 1) {
+          cmd->body.clear();
+        }
+        this->__send(cmd);
+      });
+    }
+
+    // 물어볼 곳이 없으면 바로 락을 얻은 것으로 처리.
+    for (size_t i = 0; i < n; i += 1) {
+      this->__permitted(keys[i]);
+    }
+  }
+
+  // 가지고 있거나 얻으려던 락을 놓음. 넘겨받은 락이면 다음 차례에 넘기고, 배타로
+  // 가지고 있고 기다린다고 알려 온 곳이 있으면 넘겨줌.
+  void __releaseLock(const LockKey key) {
+    auto &lc = this->__lockContext(key);
+    ContextID anchor;
+    uint32_t chain, hop;
+
+    switch (lc.state) {
+    case LockContext::HANDED_OFF:
+      // 이미 놓았음. 차례가 끝나도 다시 얻으려 하지 않음.
+      lc.reacquire = false;
+      return;
+    case LockContext::ACQUIRED:
+      if (lc.handoffAnchor != 0) {
+        anchor = lc.handoffAnchor;
+        chain = lc.handoffChain;
+        hop = lc.handoffHop;
+        lc.handoffAnchor = 0;
+        this->__queue.swap(lc.handoffQueue);
+        lc.handoffQueue.clear();
+        this->__resetLock(lc, key);
+        this->__passOn(key, anchor, chain, hop);
+        return;
+      }
+      if (this->__handoff() && !this->__retiring &&
+          lc.mode == LOCK_EXCLUSIVE && !lc.rcvExclusive.empty()) {
+        this->__handOff(lc, key);
+        return;
+      }
+      break;
+    default:
+      break;
+    }
+
+    this->__resetLock(lc, key);
+  }
+
+  // 허락을 풂.
+  void __resetLock(LockContext &lc, const LockKey key) {
+    const auto state = lc.state;
+
+    // 락을 주지 않은 다른 곳에 이제 줌. 얻기 전에 포기했어도 나중인 요청에 미뤄 둔
+    // 답이 있음. 다시 허락을 구하지 않도록 상태부터 바꿈.
+    lc.state = LockContext::NONE;
+    lc.yourLockToSend.forEach([&](const uint32_t slot) {
+      this->__grantLock(lc, slot, key);
+    });
+    lc.yourLockToSend.clear();
+
+    switch (state) { // 이미 뭔가를 보냈을 때.
+    case LockContext::ACQUIRED:
+    case LockContext::SOLICITING:
+      // 아직 답하지 않은 곳의 허락은 나중에 와도 버림.
+      lc.yourLockToRcv.forEach([&](const uint32_t slot) {
+        lc.staleYourLock[slot] += 1;
+      });
+      lc.yourLockToRcv.clear();
+      /* fall through */
+    case LockContext::LURKING:
+      // 다른 이에게 내가 락을 풀었다는 것을 통보. 엿듣던 중이면 기다린다고 알린
+      // 곳에만 보냄. 놓는 것도 사건이므로 시계를 올려 같이 보냄.
+      if (!lc.sentMyLock.empty()) {
+        const auto stamp = this->__tick();
+
+        lc.sentMyLock.forEach([&](const uint32_t slot) {
+          this->__send(this->__makeMyCommand(
+              OPC_LOCK_RESET, this->__slots.idOf(slot), key, stamp));
+        });
+        lc.sentMyLock.clear();
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  // 기다린다고 알려 온 곳들에게 요청이 먼저인 것부터 차례로 넘김.
+  void __handOff(LockContext &lc, const LockKey key) {
+    auto &order = this->__order;
+    auto &queue = this->__queue;
+
+    order.clear();
+    lc.rcvExclusive.forEach([&](const uint32_t slot) {
+      order.push_back(std::make_pair(lc.exclusiveStamp[slot],
+                                     this->__slots.idOf(slot)));
+    });
+    std::sort(order.begin(), order.end(),
+              [](const std::pair<uint32_t, ContextID> &a,
+                 const std::pair<uint32_t, ContextID> &b) {
+                return __earlier(a.first, a.second, b.first, b.second);
+              });
+    queue.clear();
+    for (const auto &p : order) {
+      queue.push_back(p.second);
+    }
+
+    lc.state = LockContext::HANDED_OFF;
+    lc.chainID += 1;
+    lc.chainAt = this->__id;
+    lc.chainHop = 0;
+    lc.reacquire = false;
+    this->__passOn(key, this->__id, lc.chainID, 0);
+  }
+
+  // 넘겨받은 락을 다 썼거나 쓸 수 없음. `__queue`에서 아직 있는 다음 피어에게
+  // 넘기고, 없으면 차례를 끝냄. 어느 쪽이든 넘기기 시작한 피어에게 알림.
+  void __passOn(const LockKey key, const ContextID anchor,
+                const uint32_t chain, const uint32_t hop) {
+    auto &queue = this->__queue;
+    ContextID next = 0;
+    size_t i;
+
+    if (anchor != this->__id && this->__others.count(anchor) == 0) {
+      // 다른 피어를 막아 주던 곳이 사라짐. 더 넘기지 않음.
+      queue.clear();
+      return;
+    }
+
+    for (i = 0; i < queue.size(); i += 1) {
+      if (queue[i] != this->__id && queue[i] != anchor &&
+          this->__others.count(queue[i]) > 0) {
+        next = queue[i];
+        break;
+      }
+    }
+    if (next != 0) {
+      auto cmd = this->__makeMyCommand(OPC_LOCK_HANDOFF, next, key, hop + 1);
+
+      cmd->body.push_back(anchor);
+      cmd->body.push_back(chain);
+      cmd->body.insert(cmd->body.end(), queue.begin() + i + 1, queue.end());
+      this->__send(cmd);
+    }
+    queue.clear();
+
+    if (anchor == this->__id) {
+      this->__onPassed(key, chain, hop + 1, next);
+    } else {
+      auto cmd = this->__makeMyCommand(OPC_LOCK_PASSED, anchor, key, hop + 1);
+
+      cmd->body.push_back(chain);
+      if (next != 0) {
+        cmd->body.push_back(next);
+      }
+      this->__send(cmd);
+    }
+  }
+
+  void __cmdLockHandoff(const Command &cmd) {
+    auto &lc = this->__lockContext(cmd.key);
+    ContextID anchor;
+    uint32_t chain;
+
+    if (cmd.body.size() < 2) {
+      std::stringstream ss;
+
+      ss << "* Rogue 'LockHandoff' command received from context "
+         << cmd.context_from << " by " << this->__id << " for key " << cmd.key
+         << '.';
+      __REPORT(ss.str());
+      return;
+    }
+    anchor = cmd.body[0];
+    chain = cmd.body[1];
+    this->__queue.assign(cmd.body.begin() + 2, cmd.body.end());
+
+    if (lc.state != LockContext::LURKING && lc.state != LockContext::SOLICITING) {
+      // 포기했음. 다음 차례에 넘김.
+      this->__passOn(cmd.key, anchor, chain, cmd.stamp);
+      return;
+    }
+    if (lc.mode != LOCK_EXCLUSIVE || !lc.group.empty() ||
+        this->__others.count(anchor) == 0) {
+      this->__passOn(cmd.key, anchor, chain, cmd.stamp);
+      return;
+    }
+
+    // 아직 답하지 않은 곳의 허락은 버림. 놓을 때 "LockReset"을 보내므로 각각 꼭
+    // 하나가 온다.
+    lc.yourLockToRcv.forEach([&](const uint32_t slot) {
+      lc.staleYourLock[slot] += 1;
+    });
+    lc.yourLockToRcv.clear();
+    lc.state = LockContext::ACQUIRED;
+    lc.handoffAnchor = anchor;
+    lc.handoffChain = chain;
+    lc.handoffHop = cmd.stamp;
+    lc.handoffQueue.swap(this->__queue);
+    this->__queue.clear();
+    this->__host.engineAcquired(cmd.key);
+  }
+
+  void __cmdLockPassed(const Command &cmd) {
+    if (cmd.body.empty()) {
+      return;
+    }
+    this->__onPassed(cmd.key, cmd.body[0], cmd.stamp,
+                     cmd.body.size() > 1 ? cmd.body[1] : 0);
+  }
+
+  // 넘긴 락이 `hop`번째에 `at`으로 감. `at`이 0이면 차례가 끝남. 늦게 온 알림은
+  // 버림.
+  void __onPassed(const LockKey key, const uint32_t chain, const uint32_t hop,
+                  const ContextID at) {
+    auto &lc = this->__lockContext(key);
+
+    if (lc.state != LockContext::HANDED_OFF || chain != lc.chainID ||
+        hop <= lc.chainHop) {
+      return;
+    }
+    if (at == 0 || this->__others.count(at) == 0) {
+      this->__finishHandoff(lc, key);
+      return;
+    }
+    lc.chainAt = at;
+    lc.chainHop = hop;
+  }
+
+  // 차례가 끝났음. 그제야 허락을 풀고, 그동안 다시 얻으려 했으면 얻으려 함.
+  // 한꺼번에 얻으려 했으면 다른 키들과 같이 얻으려 함.
+  void __finishHandoff(LockContext &lc, const LockKey key) {
+    const auto again = lc.reacquire;
+
+    lc.reacquire = false;
+    lc.state = LockContext::ACQUIRED;
+    this->__resetLock(lc, key);
+    if (!again) {
+      return;
+    }
+    if (lc.group.empty()) {
+      this->__start(lc, key);
+      return;
+    }
+    lc.state = LockContext::LURKING;
+    this->__trySolicit(key);
+    if (lc.state == LockContext::LURKING) {
+      this->__lurk(lc, key);
+    }
+  }
+
+public:
+  MultiphaseEngine(Host &host, const ContextID id) : LockEngine(host, id) {}
+
+  void peerJoined(const ContextID id) {
+    LockEngine::peerJoined(id);
+    this->__members.insert(this->__slots.slotOf(id));
+  }
+
+  void peerLeft(const ContextID id) {
+    uint32_t slot;
+
+    LockEngine::peerLeft(id);
+    if (!this->__slots.find(id, slot)) {
+      return;
+    }
+    this->__members.erase(slot);
+
+    for (auto &p : this->__lockCtxs) {
+      const auto key = p.first;
+      auto &lc = p.second;
+
+      lc.sentMyLock.erase(slot);
+      lc.yourLockToRcv.erase(slot);
+      lc.yourLockToSend.erase(slot);
+      lc.staleYourLock.erase(slot);
+      lc.rcvMyLock.erase(slot);
+      lc.rcvExclusive.erase(slot);
+      lc.permissions.erase(slot);
+
+      // 락에 대한 예외처리.
+      switch (lc.state) {
+      case LockContext::LURKING:
+        // 혼자 남았으면 물어볼 곳 없이 바로 얻음.
+        this->__trySolicit(key);
+        break;
+      case LockContext::SOLICITING:
+        // 내가 "MyLock" 명령을 보냈던 곳이 사라짐.
+        this->__permitted(key);
+        break;
+      case LockContext::HANDED_OFF:
+        // 넘겨준 락을 가진 곳이 사라짐. 차례가 끝난 것으로 봄.
+        if (lc.chainAt == id) {
+          this->__finishHandoff(lc, key);
+        }
+        break;
+      default:
+        break;
+      }
+    }
+
+    // 모든 집합에서 뺐으므로 다음 피어가 물려받아도 됨.
+    this->__slots.release(id);
+  }
+
+  void handle(const Command &cmd) {
+    switch (cmd.op_code) {
+    case OPC_MY_LOCK:
+      this->__cmdMyLock(cmd);
+      break;
+    case OPC_YOUR_LOCK:
+      this->__cmdYourLock(cmd);
+      break;
+    case OPC_LOCK_RESET:
+      this->__cmdLockReset(cmd);
+      break;
+    case OPC_LOCK_WAITING:
+      this->__cmdLockWaiting(cmd);
+      break;
+    case OPC_LOCK_HANDOFF:
+      this->__cmdLockHandoff(cmd);
+      break;
+    case OPC_LOCK_PASSED:
+      this->__cmdLockPassed(cmd);
+      break;
+    default:
+      break;
+    }
+  }
+
+  bool acquire(const LockKey key, const LockMode mode) {
+    auto &lc = this->__lockContext(key);
+
+    if (lc.state == LockContext::HANDED_OFF && !lc.reacquire) {
+      // 넘겨준 차례가 끝나면 얻으려 함. 순서는 지금 얻으려 한 것으로 정함.
+      lc.reacquire = true;
+      lc.mode = mode;
+      lc.stamp = this->__tick();
+      return true;
+    }
+    if (lc.state != LockContext::NONE) {
+      return false;
+    }
+    lc.mode = mode;
+    lc.stamp = this->__tick();
+    this->__start(lc, key);
+
+    return true;
+  }
+
+  bool acquireAll(const std::vector<LockKey> &keys) {
+    const auto stamp = this->__tick();
+    bool ready = true;
+
+    if (keys.size() == 1) {
+      return this->acquire(keys.front(), LOCK_EXCLUSIVE);
+    }
+    for (const auto key : keys) {
+      auto &lc = this->__lockContext(key);
+
+      lc.mode = LOCK_EXCLUSIVE;
+      lc.stamp = stamp;
+      lc.group = keys;
+      if (lc.state == LockContext::HANDED_OFF) {
+        // 넘겨준 차례가 끝나야 얻으려 할 수 있음.
+        lc.reacquire = true;
+        ready = false;
+        continue;
+      }
+      lc.state = LockContext::LURKING;
+      ready = ready && this->__canSolicit(lc);
+    }
+    // 모든 키를 바로 얻으려 해도 되면 한 번에 허락을 구하고, 아니면 모두 엿들으며
+    // 기다림.
+    if (ready) {
+      this->__trySolicit(keys.front());
+    } else {
+      for (const auto key : keys) {
+        auto &lc = this->__lockContext(key);
+
+        if (lc.state == LockContext::LURKING) {
+          this->__lurk(lc, key);
+        }
+      }
+    }
+
+    return true;
+  }
+
+  // 얻으려는 중이면 포기함. 한꺼번에 얻으려는 중이었으면 다른 키도 모두 포기함.
+  void release(const LockKey key) {
+    auto &lc = this->__lockContext(key);
+    std::vector<LockKey> keys;
+
+    if (!lc.group.empty()) {
+      keys.swap(lc.group);
+      for (const auto k : keys) {
+        this->__lockContext(k).group.clear();
+      }
+      for (const auto k : keys) {
+        this->__releaseLock(k);
+      }
+      return;
+    }
+    this->__releaseLock(key);
+  }
+
+  void retire() {
+    this->__retiring = true;
+  }
+
+  bool lingering() {
+    for (const auto &p : this->__lockCtxs) {
+      if (p.second.state == LockContext::HANDED_OFF) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool shareable(const LockKey key) {
+    const auto it = this->__lockCtxs.find(key);
+
+    return it != this->__lockCtxs.end() &&
+           it->second.state == LockContext::ACQUIRED &&
+           it->second.mode == LOCK_SHARED && it->second.rcvExclusive.empty();
+  }
+};
+
+#endif /* end of include guard: MULTIPHASEENGINE_H_ */
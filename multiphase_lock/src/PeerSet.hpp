@@ -0,0 +1,256 @@
+#ifndef PEERSET_H_
+#define PEERSET_H_
+#include "Globals.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 피어 ID를 0부터 시작하는 작은 정수(슬롯)로 바꿔 주는 표. 사라진 피어의 슬롯은
+// 다음에 생기는 피어가 물려받으므로 슬롯 수는 동시에 있었던 피어 수를 넘지 않는다.
+// 슬롯을 돌려주기 전에 그 슬롯을 담은 `PeerSet`에서 모두 빼야 함.
+class PeerSlots {
+protected:
+  std::unordered_map<ContextID, uint32_t> __slots;
+  // 슬롯별 피어 ID. 빈 슬롯은 0.
+  std::vector<ContextID> __ids;
+  std::vector<uint32_t> __free;
+
+public:
+  // 없으면 새로 붙임.
+  uint32_t slotOf(const ContextID id) {
+    const auto it = this->__slots.find(id);
+    uint32_t slot;
+
+    if (it != this->__slots.end()) {
+      return it->second;
+    }
+
+    if (this->__free.empty()) {
+      slot = (uint32_t)this->__ids.size();
+      this->__ids.push_back(id);
+    } else {
+      slot = this->__free.back();
+      this->__free.pop_back();
+      this->__ids[slot] = id;
+    }
+    this->__slots.emplace(id, slot);
+
+    return slot;
+  }
+
+  bool find(const ContextID id, uint32_t &slot) const {
+    const auto it = this->__slots.find(id);
+
+    if (it == this->__slots.end()) {
+      return false;
+    }
+    slot = it->second;
+    return true;
+  }
+
+  void release(const ContextID id) {
+    const auto it = this->__slots.find(id);
+
+    if (it != this->__slots.end()) {
+      this->__ids[it->second] = 0;
+      this->__free.push_back(it->second);
+      this->__slots.erase(it);
+    }
+  }
+
+  ContextID idOf(const uint32_t slot) const {
+    return this->__ids[slot];
+  }
+
+  // 지금까지 쓰인 슬롯 수. 모든 슬롯은 이보다 작음.
+  size_t capacity() const {
+    return this->__ids.size();
+  }
+};
+
+// 슬롯의 집합. 캐시 라인에 맞춘 비트맵이라 넣고 빼기는 비트 하나, 비우기와 집합
+// 연산은 워드 단위 반복(컴파일러가 벡터화함)이다. 원소 수를 따로 세므로 비었는지는
+// 바로 안다. 넣을 때 필요하면 늘어나고, 줄어들지는 않는다.
+class PeerSet {
+protected:
+  static const size_t __WORD_BITS__ = 64;
+  static const size_t __LINE_SIZE__ = 64;
+  static const size_t __LINE_WORDS__ = __LINE_SIZE__ / sizeof(uint64_t);
+
+  uint64_t *__words = nullptr;
+  size_t __nbWords = 0;
+  size_t __count = 0;
+
+  void __grow(const size_t nb_words) {
+    size_t n = this->__nbWords == 0 ? __LINE_WORDS__ : this->__nbWords;
+    void *p;
+
+    while (n < nb_words) {
+      n *= 2;
+    }
+    if (::posix_memalign(&p, __LINE_SIZE__, n * sizeof(uint64_t)) != 0) {
+      throw std::bad_alloc();
+    }
+    std::memset(p, 0, n * sizeof(uint64_t));
+    if (this->__words != nullptr) {
+      std::memcpy(p, this->__words, this->__nbWords * sizeof(uint64_t));
+      std::free(this->__words);
+    }
+    this->__words = (uint64_t*)p;
+    this->__nbWords = n;
+  }
+
+  static size_t __popcount(const uint64_t *words, const size_t n) {
+    size_t ret = 0;
+
+    for (size_t i = 0; i < n; i += 1) {
+      ret += (size_t)__builtin_popcountll(words[i]);
+    }
+    return ret;
+  }
+
+public:
+  PeerSet() {}
+
+  ~PeerSet() {
+    std::free(this->__words);
+  }
+
+  PeerSet(const PeerSet&) = delete;
+  PeerSet &operator=(const PeerSet&) = delete;
+
+  PeerSet(PeerSet &&x) :
+      __words(x.__words), __nbWords(x.__nbWords), __count(x.__count) {
+    x.__words = nullptr;
+    x.__nbWords = 0;
+    x.__count = 0;
+  }
+
+  // 슬롯 `nb_slots`개까지 할당 없이 담을 수 있게 함.
+  void reserve(const size_t nb_slots) {
+    const size_t n = (nb_slots + __WORD_BITS__ - 1) / __WORD_BITS__;
+
+    if (n > this->__nbWords) {
+      this->__grow(n);
+    }
+  }
+
+  bool empty() const {
+    return this->__count == 0;
+  }
+
+  size_t size() const {
+    return this->__count;
+  }
+
+  bool contains(const uint32_t slot) const {
+    const size_t w = slot / __WORD_BITS__;
+
+    return w < this->__nbWords &&
+      (this->__words[w] >> (slot % __WORD_BITS__) & 1) != 0;
+  }
+
+  // 새로 넣었으면 참.
+  bool insert(const uint32_t slot) {
+    const size_t w = slot / __WORD_BITS__;
+    const uint64_t m = (uint64_t)1 << (slot % __WORD_BITS__);
+
+    if (w >= this->__nbWords) {
+      this->__grow(w + 1);
+    }
+    if ((this->__words[w] & m) != 0) {
+      return false;
+    }
+    this->__words[w] |= m;
+    this->__count += 1;
+    return true;
+  }
+
+  // 있었으면 참.
+  bool erase(const uint32_t slot) {
+    const size_t w = slot / __WORD_BITS__;
+    const uint64_t m = (uint64_t)1 << (slot % __WORD_BITS__);
+
+    if (w >= this->__nbWords || (this->__words[w] & m) == 0) {
+      return false;
+    }
+    this->__words[w] &= ~m;
+    this->__count -= 1;
+    return true;
+  }
+
+  void clear() {
+    if (this->__count > 0) {
+      std::memset(this->__words, 0, this->__nbWords * sizeof(uint64_t));
+      this->__count = 0;
+    }
+  }
+
+  // `a`에는 있고 `b`에는 없는 슬롯들로 바꿈.
+  void assignDifference(const PeerSet &a, const PeerSet &b) {
+    size_t i;
+
+    this->reserve(a.__nbWords * __WORD_BITS__);
+    for (i = 0; i < a.__nbWords && i < b.__nbWords; i += 1) {
+      this->__words[i] = a.__words[i] & ~b.__words[i];
+    }
+    for (; i < a.__nbWords; i += 1) {
+      this->__words[i] = a.__words[i];
+    }
+    for (; i < this->__nbWords; i += 1) {
+      this->__words[i] = 0;
+    }
+    this->__count = __popcount(this->__words, a.__nbWords);
+  }
+
+  // 모든 슬롯이 `x`에도 있는지.
+  bool isSubsetOf(const PeerSet &x) const {
+    size_t i;
+
+    if (this->__count > x.__count) {
+      return false;
+    }
+    for (i = 0; i < this->__nbWords && i < x.__nbWords; i += 1) {
+      if ((this->__words[i] & ~x.__words[i]) != 0) {
+        return false;
+      }
+    }
+    for (; i < this->__nbWords; i += 1) {
+      if (this->__words[i] != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // `x`의 슬롯들을 더함.
+  void unite(const PeerSet &x) {
+    this->reserve(x.__nbWords * __WORD_BITS__);
+    for (size_t i = 0; i < x.__nbWords; i += 1) {
+      this->__words[i] |= x.__words[i];
+    }
+    this->__count = __popcount(this->__words, this->__nbWords);
+  }
+
+  // 슬롯 순서로 `f(slot)`을 부름. `f` 안에서 이 집합을 바꾸면 안 됨.
+  template <class F>
+  void forEach(F f) const {
+    size_t left = this->__count;
+
+    for (size_t i = 0; left > 0; i += 1) {
+      uint64_t w = this->__words[i];
+
+      while (w != 0) {
+        f((uint32_t)(i * __WORD_BITS__ + (size_t)__builtin_ctzll(w)));
+        w &= w - 1;
+        left -= 1;
+      }
+    }
+  }
+};
+
+#endif /* end of include guard: PEERSET_H_ */
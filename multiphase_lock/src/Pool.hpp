@@ -0,0 +1,136 @@
+#ifndef POOL_H_
+#define POOL_H_
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+// 풀에서 할당되는 객체가 상속해야 하는 헤더.
+struct PoolLink {
+  // 이 객체를 만든 샤드.
+  void *poolShard = nullptr;
+  // 빈 객체 목록에서 쓰는 링크.
+  PoolLink *poolNext = nullptr;
+};
+
+// 스레드별 객체 풀.
+// 각 스레드는 자기 샤드에서 객체를 할당하고 반환한다. 다른 스레드가 만든 객체를
+// 반환할 때는 그 샤드의 `remote` 스택에 lock-free로 밀어 넣고, 샤드 주인은 자기
+// 목록이 비었을 때 그 스택을 통째로 가져간다. 샤드가 비어 있을 때만 `SLAB_SIZE`개
+// 단위로 힙에서 할당하므로, 안정 상태에서는 전역 할당자를 거치지 않는다.
+// 스레드가 끝나면 샤드는 버려지지 않고 다음에 생기는 스레드가 물려받는다. 메모리는
+// 프로세스가 끝날 때까지 돌려주지 않는다.
+template <class T, size_t SLAB_SIZE = 64>
+class Pool {
+protected:
+  struct __Shard {
+    PoolLink *local = nullptr;
+    std::atomic<PoolLink*> remote;
+    __Shard *nextOrphan = nullptr;
+
+    __Shard () : remote(nullptr) {}
+  };
+
+  struct __Holder {
+    __Shard *shard = nullptr;
+
+    ~__Holder () {
+      if (this->shard != nullptr) {
+        std::lock_guard<std::mutex> lg(Pool::__orphanLock());
+
+        this->shard->nextOrphan = Pool::__orphans();
+        Pool::__orphans() = this->shard;
+      }
+    }
+  };
+
+  static std::mutex &__orphanLock () {
+    static std::mutex ret;
+    return ret;
+  }
+
+  static __Shard *&__orphans () {
+    static __Shard *ret = nullptr;
+    return ret;
+  }
+
+  static std::atomic<uint64_t> &__slabCount () {
+    static std::atomic<uint64_t> ret(0);
+    return ret;
+  }
+
+  static __Shard *__myShard () {
+    static thread_local __Holder holder;
+
+    if (holder.shard == nullptr) {
+      std::lock_guard<std::mutex> lg(__orphanLock());
+
+      if (__orphans() != nullptr) {
+        holder.shard = __orphans();
+        __orphans() = holder.shard->nextOrphan;
+        holder.shard->nextOrphan = nullptr;
+      }
+      else {
+        holder.shard = new __Shard;
+      }
+    }
+
+    return holder.shard;
+  }
+
+  static void __grow (__Shard *shard) {
+    T *slab = new T[SLAB_SIZE];
+
+    for (size_t i = 0; i < SLAB_SIZE; i += 1) {
+      slab[i].poolShard = shard;
+      slab[i].poolNext = shard->local;
+      shard->local = &slab[i];
+    }
+    __slabCount().fetch_add(1, std::memory_order_relaxed);
+  }
+
+public:
+  // 객체는 이전에 쓰던 값을 그대로 가지고 있을 수 있음. 초기화는 호출자의 몫.
+  static T *alloc () {
+    auto shard = __myShard();
+    PoolLink *ret;
+
+    if (shard->local == nullptr) {
+      shard->local = shard->remote.exchange(nullptr, std::memory_order_acquire);
+      if (shard->local == nullptr) {
+        __grow(shard);
+      }
+    }
+
+    ret = shard->local;
+    shard->local = ret->poolNext;
+    ret->poolNext = nullptr;
+
+    return static_cast<T*>(ret);
+  }
+
+  // 어느 스레드에서든 호출 가능.
+  static void free (T *obj) {
+    auto shard = (__Shard*)obj->poolShard;
+    PoolLink *link = obj;
+
+    if (shard == __myShard()) {
+      link->poolNext = shard->local;
+      shard->local = link;
+    }
+    else {
+      PoolLink *head = shard->remote.load(std::memory_order_relaxed);
+
+      do {
+        link->poolNext = head;
+      } while (!shard->remote.compare_exchange_weak(head, link,
+        std::memory_order_release, std::memory_order_relaxed));
+    }
+  }
+
+  // 지금까지 힙에서 할당한 slab 수.
+  static uint64_t slabCount () {
+    return __slabCount().load(std::memory_order_relaxed);
+  }
+};
+
+#endif /* end of include guard: POOL_H_ */
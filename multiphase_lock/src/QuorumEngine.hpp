@@ -0,0 +1,409 @@
+#ifndef QUORUMENGINE_H_
+#define QUORUMENGINE_H_
+#include "LockEngine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Maekawa 방식. 피어를 ID 순으로 한 변이 ceil(sqrt(N))인 격자에 늘어놓고, 내 행과
+// 열의 피어들(나 포함)만 쿼럼으로 삼아 그들의 표를 모두 받으면 락을 얻는다. 어느 두
+// 쿼럼도 적어도 한 피어를 공유하고, 각 피어는 한 번에 한 요청에만 표를 주므로 둘이
+// 동시에 락을 얻을 수 없다. 메시지 수는 N이 아니라 sqrt(N)에 비례한다.
+// 요청은 (Lamport 시각, ID) 순으로 우선순위를 매기고, 교착은 Sanders의 방식으로 푼다:
+// 더 급한 요청이 오면 투표자는 표를 준 곳에 "Inquire"를 보내고, 어딘가에서
+// "Failed"를 받은 요청자는 그 표를 "Relinquish"로 돌려준다.
+// 피어 구성이 바뀌면 피어마다 격자가 잠시 다를 수 있으므로, 바뀐 뒤
+// `__SETTLE_TIME__` 동안은 모든 피어를 쿼럼으로 삼는다. 모든 피어가 이 엔진을 써야 함.
+class QuorumEngine : public LockEngine {
+protected:
+  typedef std::chrono::steady_clock Clock;
+  // 요청의 우선순위. 작을수록 먼저.
+  typedef std::pair<uint32_t, ContextID> Request;
+
+  // ms 단위.
+  static const uint32_t __SETTLE_TIME__ = 500;
+
+  struct KeyState {
+    enum State {
+      IDLE,
+      WAITING,
+      HELD
+    };
+
+    // 이하 요청자로서의 상태.
+    State state = IDLE;
+    // 지금 요청의 시각. 요청마다 새로 받음.
+    uint32_t stamp = 0;
+    // 지금 요청의 쿼럼. ID 순.
+    std::vector<ContextID> quorum;
+    // 표를 준 투표자들.
+    std::set<ContextID> granted;
+    // "Failed"를 보낸 뒤 아직 표를 주지 않은 투표자들.
+    std::set<ContextID> failedBy;
+    // 답을 미뤄 둔 "Inquire"를 보낸 투표자들.
+    std::set<ContextID> inquiries;
+
+    // 이하 투표자로서의 상태.
+    bool locked = false;
+    // 표를 준 요청.
+    Request lockedFor;
+    // 표를 준 요청에 "Inquire"를 보냈는지.
+    bool inquired = false;
+    // 기다리는 요청들과 그 요청에 "Failed"를 보냈는지.
+    std::map<Request, bool> queue;
+  };
+
+  std::unordered_map<LockKey, KeyState> __keys;
+  uint32_t __clock = 0;
+  // 이 시각까지는 모든 피어를 쿼럼으로 삼음.
+  Clock::time_point __settleAt;
+  // 나 자신에게 가는 명령. 재귀 호출을 피하려고 모아 두었다가 `__drain()`에서 처리.
+  std::vector<Command*> __loopback;
+  bool __draining = false;
+
+  KeyState &__keyState(const LockKey key) {
+    return this->__keys[key];
+  }
+
+  void __post(const OPCode op_code, const ContextID to, const LockKey key,
+              const uint32_t stamp) {
+    auto cmd = this->__makeMyCommand(op_code, to, key, stamp);
+
+    if (to == this->__id) {
+      this->__loopback.push_back(cmd);
+    } else {
+      this->__send(cmd);
+    }
+  }
+
+  void __drain() {
+    size_t i;
+
+    if (this->__draining) {
+      return;
+    }
+    this->__draining = true;
+    // 처리하는 중에 늘어날 수 있음.
+    for (i = 0; i < this->__loopback.size(); i += 1) {
+      const auto cmd = this->__loopback[i];
+
+      this->__dispatch(*cmd);
+      cmd->release();
+    }
+    this->__loopback.clear();
+    this->__draining = false;
+  }
+
+  void __unsettle() {
+    this->__settleAt = this->__host.engineNow() + std::chrono::milliseconds((int64_t)__SETTLE_TIME__);
+  }
+
+  // 나를 포함한 지금 피어들. ID 순.
+  void __members(std::vector<ContextID> &members) {
+    members.assign(this->__others.begin(), this->__others.end());
+    members.insert(std::lower_bound(members.begin(), members.end(), this->__id),
+                   this->__id);
+  }
+
+  // 지금 피어 구성에서 나의 쿼럼.
+  void __makeQuorum(std::vector<ContextID> &quorum) {
+    std::vector<ContextID> members;
+    size_t n, k, p, row, col, i;
+
+    this->__members(members);
+    quorum.clear();
+
+    if (this->__host.engineNow() < this->__settleAt) {
+      quorum.swap(members);
+      return;
+    }
+
+    n = members.size();
+    k = (size_t)std::ceil(std::sqrt((double)n));
+    p = (size_t)(std::lower_bound(members.begin(), members.end(), this->__id) -
+                 members.begin());
+    row = p / k;
+    col = p % k;
+
+    for (i = row * k; i < n && i < (row + 1) * k; i += 1) {
+      quorum.push_back(members[i]);
+    }
+    for (i = col; i < n; i += k) {
+      if (i / k != row) {
+        quorum.push_back(members[i]);
+      }
+    }
+    std::sort(quorum.begin(), quorum.end());
+  }
+
+  void __request(const LockKey key) {
+    auto &ks = this->__keyState(key);
+
+    this->__clock += 1;
+    ks.state = KeyState::WAITING;
+    ks.stamp = this->__clock;
+    ks.granted.clear();
+    ks.failedBy.clear();
+    ks.inquiries.clear();
+    this->__makeQuorum(ks.quorum);
+
+    for (const auto &v : ks.quorum) {
+      this->__post(OPC_QUORUM_REQUEST, v, key, ks.stamp);
+    }
+  }
+
+  // 돌려준 표는 더 급한 요청에 가므로 그 투표자에게서 "Failed"를 받은 것과 같음.
+  void __relinquish(KeyState &ks, const ContextID to, const LockKey key) {
+    ks.granted.erase(to);
+    ks.failedBy.insert(to);
+    this->__post(OPC_QUORUM_RELINQUISH, to, key, ks.stamp);
+  }
+
+  // 투표자로서 `r`에게 표를 줌.
+  void __vote(KeyState &ks, const Request &r, const LockKey key) {
+    ks.locked = true;
+    ks.lockedFor = r;
+    ks.inquired = false;
+    this->__post(OPC_QUORUM_GRANT, r.second, key, r.first);
+  }
+
+  // 표가 돌아왔음. 기다리는 요청 중 가장 급한 곳에 줌.
+  void __revote(KeyState &ks, const LockKey key) {
+    ks.locked = false;
+    ks.inquired = false;
+    if (!ks.queue.empty()) {
+      const auto r = ks.queue.begin()->first;
+
+      ks.queue.erase(ks.queue.begin());
+      this->__vote(ks, r, key);
+    }
+  }
+
+  void __cmdRequest(KeyState &ks, const Request &r, const LockKey key) {
+    if (!ks.locked) {
+      this->__vote(ks, r, key);
+      return;
+    }
+
+    ks.queue[r] = false;
+    if (r < ks.lockedFor && ks.queue.begin()->first == r) {
+      // 가장 급한 요청이 됨. 밀려난 요청은 여기서 기다려야 함을 알려야 표를 쥔 채
+      // 교착에 빠지지 않음.
+      const auto next = std::next(ks.queue.begin());
+
+      if (next != ks.queue.end() && !next->second) {
+        next->second = true;
+        this->__post(OPC_QUORUM_FAILED, next->first.second, key, next->first.first);
+      }
+      if (!ks.inquired) {
+        ks.inquired = true;
+        this->__post(OPC_QUORUM_INQUIRE, ks.lockedFor.second, key,
+                     ks.lockedFor.first);
+      }
+    } else {
+      ks.queue[r] = true;
+      this->__post(OPC_QUORUM_FAILED, r.second, key, r.first);
+    }
+  }
+
+  void __cmdRelinquish(KeyState &ks, const Request &r, const LockKey key) {
+    if (ks.locked && ks.lockedFor == r) {
+      ks.queue[r] = true;
+      this->__revote(ks, key);
+    }
+  }
+
+  void __cmdRelease(KeyState &ks, const Request &r, const LockKey key) {
+    if (ks.locked && ks.lockedFor == r) {
+      this->__revote(ks, key);
+    } else {
+      // 표를 받기 전에 그만둔 요청.
+      ks.queue.erase(r);
+    }
+  }
+
+  // 지금 요청을 지금 있는 모든 피어에게 보냄. 이미 보낸 곳에는 다시 보내지 않음.
+  void __widen(KeyState &ks, const LockKey key) {
+    std::vector<ContextID> quorum;
+
+    this->__members(quorum);
+    for (const auto &v : quorum) {
+      if (!std::binary_search(ks.quorum.begin(), ks.quorum.end(), v)) {
+        this->__post(OPC_QUORUM_REQUEST, v, key, ks.stamp);
+      }
+    }
+    ks.quorum.swap(quorum);
+  }
+
+  void __checkGranted(KeyState &ks, const LockKey key) {
+    if (ks.granted.size() == ks.quorum.size()) {
+      ks.state = KeyState::HELD;
+      ks.failedBy.clear();
+      // 미뤄 둔 "Inquire"에는 락을 놓을 때 "Release"로 답함.
+      ks.inquiries.clear();
+      this->__host.engineAcquired(key);
+    }
+  }
+
+  void __cmdGrant(KeyState &ks, const ContextID from, const LockKey key) {
+    ks.granted.insert(from);
+    ks.failedBy.erase(from);
+    ks.inquiries.erase(from);
+    this->__checkGranted(ks, key);
+  }
+
+  void __cmdFailed(KeyState &ks, const ContextID from, const LockKey key) {
+    ks.failedBy.insert(from);
+
+    for (const auto &v : ks.inquiries) {
+      this->__relinquish(ks, v, key);
+    }
+    ks.inquiries.clear();
+  }
+
+  void __cmdInquire(KeyState &ks, const ContextID from, const LockKey key) {
+    if (ks.granted.count(from) == 0) {
+      // 이미 돌려준 표.
+      return;
+    }
+    if (ks.failedBy.empty()) {
+      // 아직 락을 얻을 수도 있음. "Failed"를 받을 때까지 미룸.
+      ks.inquiries.insert(from);
+    } else {
+      this->__relinquish(ks, from, key);
+    }
+  }
+
+  void __dispatch(const Command &cmd) {
+    auto &ks = this->__keyState(cmd.key);
+    const Request r(cmd.stamp, cmd.context_from);
+    // 요청자에게 오는 명령은 지금 요청에 대한 것만 유효함.
+    const bool current =
+        ks.state == KeyState::WAITING && cmd.stamp == ks.stamp;
+
+    if (cmd.stamp > this->__clock) {
+      this->__clock = cmd.stamp;
+    }
+
+    switch (cmd.op_code) {
+    case OPC_QUORUM_REQUEST:
+      this->__cmdRequest(ks, r, cmd.key);
+      break;
+    case OPC_QUORUM_RELINQUISH:
+      this->__cmdRelinquish(ks, r, cmd.key);
+      break;
+    case OPC_QUORUM_RELEASE:
+      this->__cmdRelease(ks, r, cmd.key);
+      break;
+    case OPC_QUORUM_GRANT:
+      if (current) {
+        this->__cmdGrant(ks, cmd.context_from, cmd.key);
+      }
+      break;
+    case OPC_QUORUM_FAILED:
+      if (current) {
+        this->__cmdFailed(ks, cmd.context_from, cmd.key);
+      }
+      break;
+    case OPC_QUORUM_INQUIRE:
+      if (current) {
+        this->__cmdInquire(ks, cmd.context_from, cmd.key);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+public:
+  QuorumEngine(Host &host, const ContextID id) : LockEngine(host, id) {}
+
+  ~QuorumEngine() {
+    for (const auto &cmd : this->__loopback) {
+      cmd->release();
+    }
+  }
+
+  void peerJoined(const ContextID id) {
+    LockEngine::peerJoined(id);
+    this->__unsettle();
+  }
+
+  void peerLeft(const ContextID id) {
+    LockEngine::peerLeft(id);
+    this->__unsettle();
+
+    for (auto &p : this->__keys) {
+      const auto key = p.first;
+      auto &ks = p.second;
+
+      // 투표자로서. 떠난 피어의 요청을 지우고, 표를 줬었다면 돌려받음.
+      for (auto it = ks.queue.begin(); it != ks.queue.end();) {
+        if (it->first.second == id) {
+          it = ks.queue.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      if (ks.locked && ks.lockedFor.second == id) {
+        this->__revote(ks, key);
+      }
+
+      // 요청자로서. 떠난 투표자의 표를 이미 받았다면 그 표는 계속 유효함. 받지
+      // 못했다면 그 표를 받은 다른 요청과의 교집합이 사라졌을 수 있으므로, 같은
+      // 시각으로 지금 있는 모든 피어에게 요청을 넓힘.
+      if (ks.state == KeyState::WAITING) {
+        const auto it = std::lower_bound(ks.quorum.begin(), ks.quorum.end(), id);
+
+        if (it != ks.quorum.end() && *it == id) {
+          ks.quorum.erase(it);
+          ks.failedBy.erase(id);
+          ks.inquiries.erase(id);
+          if (ks.granted.erase(id) == 0) {
+            this->__widen(ks, key);
+          }
+          this->__checkGranted(ks, key);
+        }
+      }
+    }
+
+    this->__drain();
+  }
+
+  void handle(const Command &cmd) {
+    this->__dispatch(cmd);
+    this->__drain();
+  }
+
+  // 공유 모드를 따로 다루지 않으므로 언제나 배타로 얻음.
+  bool acquire(const LockKey key, const LockMode) {
+    if (this->__keyState(key).state != KeyState::IDLE) {
+      return false;
+    }
+
+    this->__request(key);
+    this->__drain();
+    return true;
+  }
+
+  void release(const LockKey key) {
+    auto &ks = this->__keyState(key);
+
+    if (ks.state == KeyState::IDLE) {
+      return;
+    }
+    // 기다리던 중이었다면 요청을 거둬들임.
+    for (const auto &v : ks.quorum) {
+      this->__post(OPC_QUORUM_RELEASE, v, key, ks.stamp);
+    }
+    ks.state = KeyState::IDLE;
+    this->__drain();
+  }
+};
+
+#endif /* end of include guard: QUORUMENGINE_H_ */
@@ -0,0 +1,214 @@
+#include "Simulator.hpp"
+#include "ThreadContext.hpp"
+
+#include <algorithm>
+#include <exception>
+
+Simulator::Simulator (const uint64_t seed, const uint32_t max_latency) :
+  __rnd(seed), __maxLatency(std::chrono::microseconds(max_latency)) {}
+
+Simulator::~Simulator () {
+  for (auto &e : this->__events) {
+    switch (e.kind) {
+    case __DELIVER:
+      e.cmd->release();
+      break;
+    case __DELIVER_CHAIN:
+      e.oldest->next = nullptr;
+      for (auto env = e.newest; env != nullptr;) {
+        const auto next = env->next;
+
+        env->cmd->release();
+        Pool<Envelope>::free(env);
+        env = next;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void Simulator::__push (const __Event &e) {
+  this->__events.push_back(e);
+  this->__events.back().seq = this->__seq++;
+  std::push_heap(this->__events.begin(), this->__events.end(), __Later());
+}
+
+Simulator::ClockType::time_point Simulator::__arrival (const ContextID from) {
+  auto ret = this->__now;
+  auto &last = this->__lastArrival[from];
+
+  if (this->__maxLatency.count() > 0) {
+    ret += ClockType::duration(
+        1 + (ClockType::rep)(this->__rnd() % (uint64_t)this->__maxLatency.count()));
+  }
+  // 앞서 보낸 명령을 앞지르지 않음.
+  if (ret < last) {
+    ret = last;
+  }
+  last = ret;
+
+  return ret;
+}
+
+void Simulator::__wake (const ContextID id) {
+  const auto it = this->__peers.find(id);
+
+  if (it == this->__peers.end() || it->second.wakeAt <= this->__now) {
+    return;
+  }
+
+  it->second.wakeAt = this->__now;
+  this->__ready.push_back(id);
+}
+
+void Simulator::__step (const ContextID id, const ClockType::time_point &at) {
+  const auto it = this->__peers.find(id);
+  __Event e;
+
+  if (it == this->__peers.end() || it->second.wakeAt != at) {
+    return;
+  }
+
+  this->__steps += 1;
+  it->second.ctx->stepSimulated(this->__now);
+
+  // 움직이는 동안 `__peers`는 바뀌지 않음.
+  e.at = it->second.ctx->nextEventTime();
+  it->second.wakeAt = e.at;
+  if (e.at <= this->__now) {
+    it->second.wakeAt = this->__now;
+    this->__ready.push_back(id);
+  } else if (e.at != ClockType::time_point::max()) {
+    e.kind = __WAKE;
+    e.to = id;
+    this->__push(e);
+  }
+}
+
+void Simulator::spawn (const ContextID id) {
+  this->spawnAll(std::vector<ContextID>(1, id));
+}
+
+void Simulator::spawnAll (const std::vector<ContextID> &ids) {
+  std::vector<ContextID> sorted(ids);
+  std::vector<ThreadContext*> ctxs;
+
+  std::sort(sorted.begin(), sorted.end());
+  if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+    throw std::exception();
+  }
+  for (const auto &id : ids) {
+    if (this->__peers.count(id) > 0) {
+      throw std::exception();
+    }
+  }
+
+  for (const auto &id : ids) {
+    auto ctx = new ThreadContext();
+
+    ctx->startSimulated(id, this->__now);
+    this->__peers[id].ctx = ctx;
+    ctxs.push_back(ctx);
+  }
+  ::addContexts(ctxs);
+
+  // `addContexts()`는 명령을 우편함에 바로 넣으므로 모두 깨움. 새 피어는 준
+  // 순서대로 움직임.
+  for (const auto &p : this->__peers) {
+    if (!std::binary_search(sorted.begin(), sorted.end(), p.first)) {
+      this->__wake(p.first);
+    }
+  }
+  for (const auto &id : ids) {
+    this->__wake(id);
+  }
+}
+
+void Simulator::run (const ClockType::duration &duration) {
+  const auto until = this->__now + duration;
+
+  while (true) {
+    // 지금 시각의 일을 먼저 끝냄.
+    if (this->__readyHead < this->__ready.size()) {
+      this->__step(this->__ready[this->__readyHead++], this->__now);
+      continue;
+    }
+    this->__ready.clear();
+    this->__readyHead = 0;
+
+    if (this->__events.empty() || this->__events.front().at > until) {
+      break;
+    }
+
+    const auto e = this->__events.front();
+
+    std::pop_heap(this->__events.begin(), this->__events.end(), __Later());
+    this->__events.pop_back();
+    this->__now = e.at;
+
+    switch (e.kind) {
+    case __DELIVER:
+      this->__delivered += 1;
+      if (e.to == 0) {
+        for (const auto &p : this->__peers) {
+          if (p.first != e.cmd->context_from) {
+            this->__wake(p.first);
+          }
+        }
+      } else {
+        this->__wake(e.to);
+      }
+      ::deliverCommand(e.cmd);
+      break;
+    case __DELIVER_CHAIN:
+      this->__delivered += 1;
+      this->__wake(e.to);
+      {
+        EpochDomain::Guard guard(::peerEpoch);
+        const auto ctx = ::peers.load(std::memory_order_acquire)->find(e.to);
+
+        if (ctx != nullptr) {
+          ctx->pushCommandChain(e.newest, e.oldest);
+          break;
+        }
+      }
+      e.oldest->next = nullptr;
+      for (auto env = e.newest; env != nullptr;) {
+        const auto next = env->next;
+
+        env->cmd->release();
+        Pool<Envelope>::free(env);
+        env = next;
+      }
+      break;
+    case __WAKE:
+      this->__step(e.to, e.at);
+      break;
+    }
+  }
+
+  this->__now = until;
+}
+
+void Simulator::post (Command *cmd) {
+  __Event e;
+
+  e.at = this->__arrival(cmd->context_from);
+  e.kind = __DELIVER;
+  e.to = cmd->context_to;
+  e.cmd = cmd;
+  this->__push(e);
+}
+
+void Simulator::postChain (const ContextID to, Envelope *newest, Envelope *oldest) {
+  __Event e;
+
+  e.at = this->__arrival(newest->cmd->context_from);
+  e.kind = __DELIVER_CHAIN;
+  e.to = to;
+  e.newest = newest;
+  e.oldest = oldest;
+  this->__push(e);
+}
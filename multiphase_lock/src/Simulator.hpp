@@ -0,0 +1,108 @@
+#ifndef SIMULATOR_H_
+#define SIMULATOR_H_
+#include "EventContext.hpp"
+#include "Globals.hpp"
+
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// 피어 여러 개를 스레드 하나에서 가상 시계로 돌리는 이산 사건 시뮬레이터.
+// 피어(`ThreadContext`)는 스레드 없이 띄우고, 피어가 보내는 명령은 `sendCommand()`와
+// `sendCommandChain()`이 `::simulator`로 넘긴다. 명령마다 시드로 고른 전달 지연을
+// 붙여 피어 사이의 도착 순서를 섞되, 한 피어가 보낸 명령은 보낸 순서대로 도착한다.
+// 피어는 명령이 도착했거나 타이머가 만료된 시각에만 움직이고, 그 사이의 시간은
+// 건너뛴다. 같은 시드와 옵션이면 매번 같은 순서로 돌아가므로 "Race state detected"나
+// 기아 감지도 같은 시드로 다시 볼 수 있다.
+// 다른 노드와는 연결하지 않는다.
+class Simulator {
+public:
+  typedef EventContext::ClockType ClockType;
+
+protected:
+  enum __Kind {
+    // `cmd`를 `::deliverCommand()`로 전달.
+    __DELIVER,
+    // `newest`에서 `oldest`까지를 `to`의 우편함에 넣음.
+    __DELIVER_CHAIN,
+    // `to`를 움직임.
+    __WAKE
+  };
+
+  struct __Event {
+    ClockType::time_point at;
+    // 같은 시각이면 먼저 예약한 것부터.
+    uint64_t seq;
+    __Kind kind;
+    ContextID to;
+    Command *cmd;
+    Envelope *newest, *oldest;
+  };
+
+  struct __Later {
+    bool operator() (const __Event &a, const __Event &b) const {
+      return a.at != b.at ? a.at > b.at : a.seq > b.seq;
+    }
+  };
+
+  struct __Peer {
+    ThreadContext *ctx;
+    // 예약해 둔 가장 이른 `__WAKE`나 `__ready`. 이와 다른 시각의 것은 지난 것.
+    ClockType::time_point wakeAt = ClockType::time_point::max();
+  };
+
+  // `__Later`로 만든 힙.
+  std::vector<__Event> __events;
+  uint64_t __seq = 0;
+  // 지금 시각에 움직일 피어들. 힙을 거치지 않도록 따로 둠. 깨운 순서대로.
+  std::vector<ContextID> __ready;
+  size_t __readyHead = 0;
+  ClockType::time_point __now;
+  std::mt19937_64 __rnd;
+  // 명령 하나의 최대 전달 지연.
+  ClockType::duration __maxLatency;
+  std::unordered_map<ContextID, __Peer> __peers;
+  // 피어가 마지막으로 보낸 명령의 도착 시각.
+  std::unordered_map<ContextID, ClockType::time_point> __lastArrival;
+  uint64_t __delivered = 0;
+  uint64_t __steps = 0;
+
+  void __push (const __Event &e);
+  ClockType::time_point __arrival (const ContextID from);
+  void __wake (const ContextID id);
+  void __step (const ContextID id, const ClockType::time_point &at);
+
+public:
+  // `max_latency`는 us 단위. 0이면 지연 없이 보낸 순서대로 도착.
+  Simulator (const uint64_t seed, const uint32_t max_latency);
+  ~Simulator ();
+
+  Simulator (const Simulator&) = delete;
+  Simulator &operator= (const Simulator&) = delete;
+
+  // 지금 가상 시각에 피어 `id`를 띄워 목록에 올림.
+  void spawn (const ContextID id);
+  // 피어 `ids`를 한 번에 띄워 목록에 올림(`::addContexts()`).
+  void spawnAll (const std::vector<ContextID> &ids);
+  // 가상 시각이 `duration`만큼 흐를 때까지 돌림.
+  void run (const ClockType::duration &duration);
+
+  ClockType::time_point now () const {
+    return this->__now;
+  }
+
+  // 전달한 명령 묶음 수와 피어를 움직인 횟수.
+  uint64_t delivered () const {
+    return this->__delivered;
+  }
+
+  uint64_t steps () const {
+    return this->__steps;
+  }
+
+  // 이하 `sendCommand()`와 `sendCommandChain()`이 부름. 인자는 그 함수들과 같음.
+  void post (Command *cmd);
+  void postChain (const ContextID to, Envelope *newest, Envelope *oldest);
+};
+
+#endif /* end of include guard: SIMULATOR_H_ */
@@ -1,35 +1,187 @@
 #ifndef THREADCONTEXT_H_
 #define THREADCONTEXT_H_
+#include "Affinity.hpp"
 #include "CommandQueue.hpp"
 #include "EventContext.hpp"
+#include "Executor.hpp"
 #include "Globals.hpp"
-#include "LockContext.hpp"
-
+#include "LatencyHistogram.hpp"
+#include "LockEngine.hpp"
+#include "MultiphaseEngine.hpp"
+#include "QuorumEngine.hpp"
+#include "TokenEngine.hpp"
+#include "Tracer.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <random>
-#include <set>
 #include <sstream>
 #include <thread>
 
-#define __REPORT(msg) this->__report(__FILE__, __LINE__, msg)
+// 락 API 요청의 결과.
+enum LockResult {
+  // 락을 얻음. 다 쓰면 `ThreadContext::release()`로 놓아야 함.
+  LOCK_ACQUIRED,
+  // 얻기 전에 `ThreadContext::cancel()`됨.
+  LOCK_CANCELLED,
+  // 얻기 전에 피어가 멈춤.
+  LOCK_STOPPED,
+  // `ThreadContext::tryAcquire()`의 기한 안에 얻지 못함.
+  LOCK_TIMEOUT
+};
+
+// 피어의 스레드에서 불림. 오래 걸리는 일을 하면 그동안 피어가 멈춤.
+typedef std::function<void(const LockResult)> LockCallback;
 
-class ThreadContext {
+// 페이지 단위로 할당하므로 스레드를 묶은 NUMA 노드로 우편함과 상태를 옮길 수 있다.
+class ThreadContext : public LockEngine::Host, public PageAligned {
 protected:
+  // 락 키마다 하나씩. `__STARVATION_EVENT__ + key`. 그 뒤로는 `tryAcquire()`의
+  // 기한이 요청마다 하나씩. `__timeoutEvent()` 참고.
   static const EventContext::EventID __STARVATION_EVENT__ = 1;
 
+  // `::executor`의 작업으로 돌 때의 상태.
+  enum __TaskState {
+    // 할 일이 없어 실행 큐에 없음.
+    __TASK_IDLE,
+    // 실행 큐에 있음.
+    __TASK_QUEUED,
+    // 작업 스레드가 움직이는 중.
+    __TASK_RUNNING,
+    // 움직이는 중에 명령이 들어옴. 끝나면 다시 실행 큐에 넣음.
+    __TASK_NOTIFIED,
+    // 종료 명령을 처리했음.
+    __TASK_DONE
+  };
+
   ContextID __id = 0;
   size_t __maxCmdQueueSize = 10;
   uint64_t __acquiredCount = 0;
+  // 기한 안에 얻지 못한 요청 수.
+  uint64_t __timeoutCount = 0;
+  // 엔진에 낸 요청을 얻기 전에 포기한 횟수와 그때 보낸 명령 수.
+  uint64_t __abandonedCount = 0;
+  uint64_t __abandonSentCount = 0;
+  // 이 피어의 스레드에서 일어난 힙 할당 횟수.
+  std::atomic<uint64_t> __mallocCount;
+  // 우편함에서 한 번에 가져온 묶음 수와 처리한 명령 수.
+  std::atomic<uint64_t> __batchCount;
+  std::atomic<uint64_t> __processedCount;
+  // 보낸 명령 수. 방송은 하나로 셈.
+  std::atomic<uint64_t> __sentCount;
+  // `::spinWait`로 돌다가 명령을 받은 횟수와 받지 못하고 잠든 횟수.
+  std::atomic<uint64_t> __spinHits;
+  std::atomic<uint64_t> __spinMisses;
+  // 우편함이 비었다가 다시 깨어나기까지 걸린 시간의 이동 평균(ns). 피어의 스레드만 씀.
+  uint64_t __idleAvg = 0;
+  // 락을 얻으려 한 뒤 얻기까지 걸린 시간. us 단위.
+  LatencyHistogram __latency;
 
   std::thread __th;
-  std::set<ContextID> __others;
+  // 스레드 없이 `Simulator`가 움직이는 중인지.
+  bool __simulated = false;
+  // 스레드 없이 `::executor`의 작업으로 도는 중인지. 이하 그 때 씀.
+  bool __tasked = false;
+  bool __begun = false;
+  std::atomic<int> __taskState;
+  // 작업 스레드에 맡겨 둔 가장 이른 깨울 시각.
+  EventContext::ClockType::time_point __armedAt;
+  // `stop()`이 작업이 끝나길 기다릴 때 씀.
+  std::mutex __doneMtx;
+  std::condition_variable __doneCv;
   CommandQueue __cmdQueue;
-  LockContext __lockCtx;
+  // 스레드를 가진 피어가 잠드는 곳. `start()`가 만들고 우편함에 붙임.
+  std::unique_ptr<EventLoop> __loop;
+  // 피어의 스레드에서만 씀. `__run()`이 만들고 치움.
+  std::unique_ptr<LockEngine> __engine;
+  // 락 키별로 엔진에서 얻어 가지고 있는지와 얻으려 하기 시작한 시점.
+  std::vector<uint8_t> __holding;
+  std::vector<std::chrono::steady_clock::time_point> __requestedAt;
+  // 락 키별로 엔진에 얻기를 요청해 두었거나 얻은 모드와, 그 락을 받아 쓰고 있는 요청
+  // 수. 배타면 많아야 1.
+  std::vector<LockMode> __modes;
+  std::vector<uint32_t> __users;
+  // `OPC_MEMBERSHIP_VIEW`로 받은 목록의 버전과 지금까지 반영한 가장 큰 버전. 목록을
+  // 받기 전에는 혼자인 줄 알고 락을 얻을 수 있으므로 락 API 요청을 미룸.
+  uint32_t __viewBase = 0;
+  std::atomic<uint32_t> __viewVersion;
+  bool __viewReady = false;
+  // `popContext()`로 목록에서 빠진 버전. 0이면 목록에 있음.
+  std::atomic<uint32_t> __departedAt;
+  // `::tracer`에 남기는 시각. 시계를 읽는 비용이 기록하는 비용보다 크므로, 명령
+  // 하나나 타이머 한 차례를 처리하기 전에 한 번만 읽어 그동안의 기록에 같이 씀.
+  std::chrono::steady_clock::time_point __traceAt;
+
+  // 여러 키를 한꺼번에 얻으려는 요청. 키마다 기다리는 요청들에 같이 들어간다.
+  struct __Group {
+    // 정렬되어 있음.
+    std::vector<LockKey> keys;
+    LockCallback cb;
+    // 엔진에 얻기를 요청했는지.
+    bool requested;
+  };
+  struct __Waiter {
+    // 기한이 지났을 때 찾으려고 붙임.
+    uint64_t id;
+    LockMode mode;
+    // `group`이 있으면 비어 있고 `group->cb`를 부름.
+    LockCallback cb;
+    std::shared_ptr<__Group> group;
+    // `tryAcquire()`의 기한 이벤트. 없으면 0. 넘기거나 취소할 때 지움.
+    EventContext::EventID timer;
+  };
+  // 락 키별로 엔진에 얻기를 요청해 두었는지와, 얻기를 기다리는 요청들. 먼저 온
+  // 것부터.
+  std::vector<uint8_t> __requested;
+  std::vector<std::vector<__Waiter>> __waiters;
+  uint64_t __lastWaiterID = 0;
+
+  // 다른 스레드가 락 API로 맡긴 요청. 피어의 스레드가 `OPC_CALL`을 받으면 처리함.
+  struct __Call {
+    enum Op {
+      ACQUIRE,
+      ACQUIRE_ALL,
+      RELEASE,
+      CANCEL,
+      RETIRE
+    };
+
+    Op op;
+    LockKey key;
+    LockMode mode;
+    // `ACQUIRE`의 기한. 없으면 `milliseconds::max()`.
+    std::chrono::milliseconds timeout;
+    LockCallback cb;
+    // `ACQUIRE_ALL`의 키들.
+    std::vector<LockKey> keys;
+  };
+  // 이하 `__callMtx`로 보호.
+  std::mutex __callMtx;
+  std::vector<__Call> __calls;
+  // 참이면 피어가 멈췄으므로 더 받지 않음.
+  bool __callsClosed = false;
+  // `__calls`를 떼어 와 처리할 때 씀. 피어의 스레드에서만.
+  std::vector<__Call> __callsTaken;
+  // `retire()`를 받았으면 참. 스스로 락을 새로 얻지 않음. `__retired`는 차례가 끝나면
+  // 부름.
+  bool __retiring = false;
+  LockCallback __retired;
   EventContext __eventCtx;
   std::mt19937_64 __rnd;
+  // 이번 차례에 보낼 명령들. 차례가 끝날 때 받는 피어별로 묶어 한 번씩 넣는다.
+  std::vector<Command*> __outbox;
+  std::vector<std::pair<ContextID, uint32_t>> __outboxOrder;
 
 public:
-  ThreadContext() {}
+  ThreadContext()
+      : __mallocCount(0), __batchCount(0), __processedCount(0),
+        __sentCount(0), __spinHits(0), __spinMisses(0),
+        __taskState(__TASK_IDLE), __viewVersion(0),
+        __departedAt(0) {}
 
   ~ThreadContext() { this->stop(); }
 
@@ -37,58 +189,468 @@ public:
 
   uint64_t acquiredCount() { return this->__acquiredCount; }
 
+  uint64_t timeoutCount() { return this->__timeoutCount; }
+
+  uint64_t abandonedCount() { return this->__abandonedCount; }
+
+  uint64_t abandonSentCount() { return this->__abandonSentCount; }
+
+  uint64_t mallocCount() {
+    return this->__mallocCount.load(std::memory_order_relaxed);
+  }
+
+  uint64_t batchCount() {
+    return this->__batchCount.load(std::memory_order_relaxed);
+  }
+
+  uint64_t processedCount() {
+    return this->__processedCount.load(std::memory_order_relaxed);
+  }
+
+  // 스레드를 가진 피어가 잠들었다 깨어난 횟수와 그 때문에 부른 시스템 콜 수. 깨우는
+  // 쪽이 부른 것도 셈. 스레드가 없으면 0.
+  uint64_t wakeupCount() {
+    return this->__loop != nullptr ? this->__loop->wakeups() : 0;
+  }
+
+  uint64_t syscallCount() {
+    return this->__loop != nullptr ? this->__loop->syscalls() : 0;
+  }
+
+  uint64_t spinHitCount() {
+    return this->__spinHits.load(std::memory_order_relaxed);
+  }
+
+  uint64_t spinMissCount() {
+    return this->__spinMisses.load(std::memory_order_relaxed);
+  }
+
+  uint64_t sentCount() {
+    return this->__sentCount.load(std::memory_order_relaxed);
+  }
+
+  const LatencyHistogram &latency() { return this->__latency; }
+
+  // 반영한 멤버십 버전. `::membershipVersion()`과 같으면 피어 목록이 자리 잡은 것.
+  uint32_t viewVersion() {
+    return this->__viewVersion.load(std::memory_order_relaxed);
+  }
+
+  // `::executor`가 있으면 스레드를 띄우지 않고 그 작업으로 돌림. 아니면
+  // `::affinityPolicy`대로 로컬 ID 순의 자리에 스레드를 묶고, 이 객체(우편함 포함)를
+  // 그 NUMA 노드로 옮긴다. 피어의 스레드가 만드는 상태는 묶인 뒤에 할당되므로 처음
+  // 쓰는 노드, 곧 같은 노드에 놓인다.
   void start(const ContextID id) {
-    if (this->__th.joinable()) {
+    if (this->__th.joinable() || this->__simulated || this->__tasked) {
       throw std::exception();
     }
     if ((this->__id = id) == 0) {
       throw std::exception();
     }
 
-    this->__th = std::thread([this]() { this->__run(); });
+    if (::executor != nullptr) {
+      this->__tasked = true;
+      this->__armedAt = EventContext::ClockType::time_point::min();
+      this->__taskState.store(__TASK_QUEUED, std::memory_order_relaxed);
+      ::executor->submit(this);
+    } else {
+      const auto at = ::placeThread(::localOf(id) - 1);
+
+      this->__loop.reset(new EventLoop());
+      if (!this->__loop->open()) {
+        this->__loop.reset();
+        throw std::exception();
+      }
+      this->__cmdQueue.attach(this->__loop.get());
+
+      if (at.cpu >= 0) {
+        // 실패해도 옮기지 못할 뿐 돌아가는 데는 지장 없음.
+        ::bindMemory(this, sizeof(*this), at.node);
+      }
+      this->__th = std::thread([this, at]() {
+        ::pinThread(at);
+        this->__run();
+      });
+    }
   }
 
   void stop() {
-    if (this->__th.joinable()) {
-      auto cmd = new Command;
+    if (this->__simulated) {
+      this->__end();
+      this->__simulated = false;
+    }
+    if (this->__tasked) {
+      this->pushCommand(Command::make(OPC_SHUTDOWN, 0, this->__id));
 
-      cmd->op_code = OPC_SHUTDOWN;
-      cmd->context_from = 0;
-      cmd->context_to = this->__id;
-      this->pushCommand(cmd);
+      std::unique_lock<std::mutex> ul(this->__doneMtx);
+
+      this->__doneCv.wait(ul, [this]() {
+        return this->__taskState.load(std::memory_order_acquire) == __TASK_DONE;
+      });
+      this->__tasked = false;
+    }
+    if (this->__th.joinable()) {
+      this->pushCommand(Command::make(OPC_SHUTDOWN, 0, this->__id));
 
       this->__th.join();
     }
   }
 
+  // 이하 `Simulator`가 스레드 없이 가상 시계 `now`로 움직일 때 씀. 모두
+  // `Simulator`의 스레드에서 부름.
+  void startSimulated(const ContextID id,
+                      const EventContext::ClockType::time_point &now) {
+    if (this->__th.joinable() || this->__simulated) {
+      throw std::exception();
+    }
+    if ((this->__id = id) == 0) {
+      throw std::exception();
+    }
+
+    this->__simulated = true;
+    this->__eventCtx.setTime(&now);
+    this->__begin();
+  }
+
+  // `now`까지 우편함에 들어온 명령과 만료된 타이머를 처리. 종료 명령을 받았으면 거짓.
+  bool stepSimulated(const EventContext::ClockType::time_point &now) {
+    this->__eventCtx.setTime(&now);
+    return this->__step();
+  }
+
+  // 다음에 움직여야 할 시각. 우편함은 보지 않음. 타이머가 없으면
+  // `time_point::max()`.
+  EventContext::ClockType::time_point nextEventTime() {
+    const auto d = this->__eventCtx.timeToNextEvent();
+
+    if (d == EventContext::ClockType::duration::max()) {
+      return EventContext::ClockType::time_point::max();
+    }
+    return this->__eventCtx.now() + d;
+  }
+
+  // 이하 `Executor`의 작업 스레드가 부름.
+  // 한 번 움직임. 할 일이 남았거나 그동안 명령이 들어왔으면 다시 실행 큐에 넣고,
+  // 다음 타이머는 작업 스레드에 맡김.
+  void runTask() {
+    EventContext::ClockType::time_point now, next;
+    int expected;
+
+    // 이 교환 뒤에 우편함을 비우므로, 그 전에 명령을 넣고 `__TASK_QUEUED`를 본
+    // 쪽의 명령도 이번에 처리됨.
+    this->__taskState.exchange(__TASK_RUNNING, std::memory_order_seq_cst);
+    this->__eventCtx.setTime();
+    if (!this->__begun) {
+      this->__begin();
+      this->__begun = true;
+    }
+
+    if (!this->__step()) {
+      this->__end();
+
+      std::lock_guard<std::mutex> lg(this->__doneMtx);
+
+      this->__taskState.store(__TASK_DONE, std::memory_order_release);
+      this->__doneCv.notify_all();
+      return;
+    }
+
+    now = this->__eventCtx.now();
+    next = this->nextEventTime();
+    if (next <= now) {
+      this->__taskState.store(__TASK_QUEUED, std::memory_order_relaxed);
+      ::executor->submit(this);
+      return;
+    }
+    // 맡겨 둔 것보다 늦으면 맡기지 않음. 맡겨 둔 시각에 깨어나 다시 맡김.
+    if (next != EventContext::ClockType::time_point::max() &&
+        (next < this->__armedAt || this->__armedAt <= now)) {
+      this->__armedAt = next;
+      ::executor->wakeAt(this->__id, next);
+    }
+
+    expected = __TASK_RUNNING;
+    if (!this->__taskState.compare_exchange_strong(expected, __TASK_IDLE,
+                                                   std::memory_order_seq_cst)) {
+      // 움직이는 동안 명령이 들어옴.
+      this->__taskState.store(__TASK_QUEUED, std::memory_order_relaxed);
+      ::executor->submit(this);
+    }
+  }
+
+  // 실행 큐에 없으면 넣음. 어느 스레드에서든.
+  void wakeTask() {
+    int s = this->__taskState.load(std::memory_order_seq_cst);
+
+    while (true) {
+      switch (s) {
+      case __TASK_IDLE:
+        if (this->__taskState.compare_exchange_weak(s, __TASK_QUEUED,
+                                                    std::memory_order_seq_cst)) {
+          ::executor->submit(this);
+          return;
+        }
+        break;
+      case __TASK_RUNNING:
+        if (this->__taskState.compare_exchange_weak(s, __TASK_NOTIFIED,
+                                                    std::memory_order_seq_cst)) {
+          return;
+        }
+        break;
+      default:
+        return;
+      }
+    }
+  }
+
+  // 이하 락 API. 어느 스레드에서든 부를 수 있고 기다리지 않고 바로 돌아온다. 요청은
+  // 피어의 우편함을 거쳐 피어의 스레드에서 처리한다. 키가 `::nbLockKeys` 이상이면
+  // 예외.
+  // 락 `key`를 `mode`로 얻거나 못 얻게 되면 `cb`를 부름. 이 피어에서 같은 키를
+  // 여럿이 기다리면 먼저 부른 것부터 얻는다. 공유로 가지고 있는 동안 온 공유 요청은
+  // 다른 피어의 배타 요청이 기다리고 있지 않으면 같이 얻는다.
+  void acquire(const LockKey key, const LockMode mode, LockCallback cb) {
+    this->__post(__Call::ACQUIRE, key, mode, std::move(cb));
+  }
+
+  void acquire(const LockKey key, LockCallback cb) {
+    this->acquire(key, LOCK_EXCLUSIVE, std::move(cb));
+  }
+
+  std::future<LockResult> acquire(const LockKey key,
+                                  const LockMode mode = LOCK_EXCLUSIVE) {
+    const auto promise = std::make_shared<std::promise<LockResult>>();
+    auto ret = promise->get_future();
+
+    this->acquire(key, mode, [promise](const LockResult result) {
+      promise->set_value(result);
+    });
+
+    return ret;
+  }
+
+  // `acquire()`와 같지만 `timeout` 안에 얻지 못하면 `LOCK_TIMEOUT`. 이 피어에서 그
+  // 키를 기다리는 요청이 더 없으면 엔진에 낸 요청도 포기함.
+  void tryAcquire(const LockKey key, const LockMode mode,
+                  const std::chrono::milliseconds timeout, LockCallback cb) {
+    this->__post(__Call{__Call::ACQUIRE, key, mode, timeout, std::move(cb),
+                        std::vector<LockKey>()});
+  }
+
+  void tryAcquire(const LockKey key, const std::chrono::milliseconds timeout,
+                  LockCallback cb) {
+    this->tryAcquire(key, LOCK_EXCLUSIVE, timeout, std::move(cb));
+  }
+
+  std::future<LockResult> tryAcquire(const LockKey key,
+                                     const std::chrono::milliseconds timeout,
+                                     const LockMode mode = LOCK_EXCLUSIVE) {
+    const auto promise = std::make_shared<std::promise<LockResult>>();
+    auto ret = promise->get_future();
+
+    this->tryAcquire(key, mode, timeout, [promise](const LockResult result) {
+      promise->set_value(result);
+    });
+
+    return ret;
+  }
+
+  // 락 `keys`를 모두 배타로 한꺼번에 얻거나 못 얻게 되면 `cb`를 부름. 얻으면
+  // 키마다 `release()`로 놓아야 함. 키마다 먼저 부른 요청부터 얻고, 어느 키에서든
+  // `cancel()`되면 `LOCK_CANCELLED`. 엔진이 한꺼번에 얻지 못하면 키 순서대로 하나씩
+  // 얻는다. 비었거나 같은 키가 두 번 들어 있으면 예외.
+  void acquireAll(std::vector<LockKey> keys, LockCallback cb) {
+    std::sort(keys.begin(), keys.end());
+    if (keys.empty() ||
+        std::adjacent_find(keys.begin(), keys.end()) != keys.end()) {
+      throw std::exception();
+    }
+    this->__post(__Call{__Call::ACQUIRE_ALL, keys.front(), LOCK_EXCLUSIVE,
+                        std::chrono::milliseconds::max(), std::move(cb),
+                        std::move(keys)});
+  }
+
+  std::future<LockResult> acquireAll(std::vector<LockKey> keys) {
+    const auto promise = std::make_shared<std::promise<LockResult>>();
+    auto ret = promise->get_future();
+
+    this->acquireAll(std::move(keys), [promise](const LockResult result) {
+      promise->set_value(result);
+    });
+
+    return ret;
+  }
+
+  // 가지고 있는 락 `key`를 하나 놓음. 가지고 있지 않으면 무시.
+  void release(const LockKey key) {
+    this->__post(__Call::RELEASE, key, LOCK_EXCLUSIVE, nullptr);
+  }
+
+  // 아직 얻지 못한 `key` 요청을 모두 `LOCK_CANCELLED`로 끝내고 엔진에 낸 요청도
+  // 포기함. 이미 얻은 락은 그대로.
+  void cancel(const LockKey key) {
+    this->__post(__Call::CANCEL, key, LOCK_EXCLUSIVE, nullptr);
+  }
+
+  // 멈추기 전에 부름. 스스로 락을 새로 얻지 않고, 다른 피어에게 넘겨준 락의 차례가
+  // 끝날 때까지 기다림. `::retireContext()`가 부름.
+  void retire() {
+    const auto promise = std::make_shared<std::promise<LockResult>>();
+    auto done = promise->get_future();
+
+    if (this->__simulated || (!this->__tasked && !this->__th.joinable())) {
+      return;
+    }
+
+    this->__post(__Call::RETIRE, 0, LOCK_EXCLUSIVE, [promise](const LockResult result) {
+      promise->set_value(result);
+    });
+    done.wait();
+  }
+
+  // 멤버십 버전 `version`에서 목록에서 빠졌음. `::popContexts()`가 부름. 멈출 때
+  // 보내는 통보에 이 버전을 실어, 그 뒤의 목록을 받은 피어는 무시하게 함. 곧 멈추므로
+  // 기아도 감시하지 않음.
+  void depart(const uint32_t version) {
+    this->__departedAt.store(version, std::memory_order_relaxed);
+  }
+
+  // `cmd`의 참조 하나를 가져감.
   void pushCommand(Command *cmd) {
-    std::unique_lock<std::mutex> ul(this->__cmdQueue.mtx);
+    auto env = Pool<Envelope>::alloc();
 
-    this->__cmdQueue.q.push(cmd);
-    this->__cmdQueue.cv_despatch.notify_all();
+    env->cmd = cmd;
+    this->__cmdQueue.push(env);
+    if (this->__tasked) {
+      this->wakeTask();
+    }
+  }
+
+  void pushCommandChain(Envelope *newest, Envelope *oldest) {
+    this->__cmdQueue.pushChain(newest, oldest);
+    if (this->__tasked) {
+      this->wakeTask();
+    }
   }
 
 protected:
   void __report(const char *file, const uint32_t line, const std::string msg) {
+    if (::tracer != nullptr) {
+      ::tracer->record(TRACE_REPORT, this->__id, this->__now(), 0, 0, 0, line);
+    }
+
     std::lock_guard<std::mutex> lg(::stdioLock);
     std::cerr << msg << " (" << file << ':' << line << ')' << std::endl;
   }
 
+  // `::tracer`가 있으면 이 피어의 사건을 `__traceAt` 시각으로 남김.
+  void __trace(const TraceType type, const ContextID peer, const LockKey key,
+               const uint32_t op = 0, const uint32_t arg = 0) {
+    if (::tracer != nullptr) {
+      ::tracer->record(type, this->__id, this->__traceAt, peer, key, (uint8_t)op,
+                       arg);
+    }
+  }
+
+  // 기록할 일이 생길 수 있는 처리를 시작함. 기록하지 않으면 시각도 읽지 않음.
+  void __stampTrace() {
+    if (::tracer != nullptr) {
+      this->__traceAt = this->__now();
+    }
+  }
+
+  void __post(const __Call::Op op, const LockKey key, const LockMode mode,
+              LockCallback &&cb) {
+    this->__post(__Call{op, key, mode, std::chrono::milliseconds::max(),
+                        std::move(cb), std::vector<LockKey>()});
+  }
+
+  void __post(__Call &&call) {
+    bool signal = false;
+
+    if (call.key >= ::nbLockKeys ||
+        (!call.keys.empty() && call.keys.back() >= ::nbLockKeys)) {
+      throw std::exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lg(this->__callMtx);
+
+      if (!this->__callsClosed) {
+        // 비어 있지 않았다면 이미 보낸 신호가 처리되지 않은 것.
+        signal = this->__calls.empty();
+        this->__calls.push_back(std::move(call));
+        call.cb = nullptr;
+      }
+    }
+
+    if (call.cb) {
+      call.cb(LOCK_STOPPED);
+    } else if (signal) {
+      this->pushCommand(Command::make(OPC_CALL, 0, this->__id));
+    }
+  }
+
+  void __runCalls() {
+    {
+      std::lock_guard<std::mutex> lg(this->__callMtx);
+
+      this->__calls.swap(this->__callsTaken);
+    }
+
+    for (auto &c : this->__callsTaken) {
+      switch (c.op) {
+      case __Call::ACQUIRE:
+        this->__lock(c.key, c.mode, std::move(c.cb), c.timeout);
+        break;
+      case __Call::ACQUIRE_ALL:
+        this->__lockAll(std::move(c.keys), std::move(c.cb));
+        break;
+      case __Call::RELEASE:
+        this->__unlock(c.key);
+        break;
+      case __Call::CANCEL:
+        this->__cancel(c.key);
+        break;
+      case __Call::RETIRE:
+        this->__retiring = true;
+        this->__engine->retire();
+        this->__retired = std::move(c.cb);
+        break;
+      }
+    }
+    this->__callsTaken.clear();
+  }
+
   std::chrono::milliseconds __randomAcquireDelay() {
     return std::chrono::milliseconds(this->__rnd() % (::maxAcquireDelay + 1));
   }
 
+  // `::readRatio`가 0이면 난수를 쓰지 않으므로 예전과 같은 순서로 돈다.
+  LockMode __randomLockMode() {
+    if (::readRatio <= 0.0) {
+      return LOCK_EXCLUSIVE;
+    }
+    return std::generate_canonical<double, 32>(this->__rnd) < ::readRatio
+               ? LOCK_SHARED
+               : LOCK_EXCLUSIVE;
+  }
+
   std::chrono::milliseconds __randomLockHoldTime() {
     return std::chrono::milliseconds(this->__rnd() % (::maxLockHoldTime + 1));
   }
 
-  void __run() {
-    Command *cmd;
-    bool runFlag;
-
-    runFlag = true;
+  // 피어를 처음 움직이기 전에 한 번. 부르기 전에 `__eventCtx`의 시각을 맞춰 둬야 함.
+  void __begin() {
     // 랜덤 엔진 초기화
-    {
+    if (::fixedSeed) {
+      // 피어마다 다르지만 실행마다 같은 값.
+      std::seed_seq seq = {(uint32_t)((0xFFFFFFFF00000000 & ::rngSeed) >> 32),
+                           (uint32_t)((0x00000000FFFFFFFF & ::rngSeed)),
+                           (uint32_t)this->__id};
+
+      this->__rnd.seed(seq);
+    } else {
       std::hash<std::thread::id> hasher;
       const auto now =
           (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
@@ -113,277 +675,780 @@ protected:
       }
     }
 
-    // 내가 태어났다는 것을 방송.
-    cmd = new Command;
-    cmd->op_code = OPC_THREAD_SPAWNED;
-    cmd->context_from = this->__id;
-    cmd->context_to = 0;
-    ::sendCommand(cmd);
+    this->__engine.reset(this->__makeEngine());
+    std::vector<uint8_t>(::nbLockKeys, 0).swap(this->__holding);
+    this->__requestedAt.resize(::nbLockKeys);
+    std::vector<LockMode>(::nbLockKeys, LOCK_EXCLUSIVE).swap(this->__modes);
+    std::vector<uint32_t>(::nbLockKeys, 0).swap(this->__users);
+    std::vector<uint8_t>(::nbLockKeys, 0).swap(this->__requested);
+    this->__waiters.resize(::nbLockKeys);
 
-    // 조금 기다렸다가 락 걸기 시도
+    // 내가 태어났다는 것은 `addContext()`가 방송함. 락은 피어 목록을 받은 뒤에
+    // 걸기 시작함.
     this->__eventCtx.clear();
-    this->__eventCtx.setTime();
-    this->__eventCtx.addDelayedEvent(std::chrono::milliseconds(100),
-                                     [this]() { this->__acquireLock(); });
+  }
 
-    do {
-      {
-        std::unique_lock<std::mutex> ul(this->__cmdQueue.mtx);
+  // `addContext()`가 준 피어 목록.
+  void __applyView(const Command &cmd) {
+    this->__viewBase = cmd.stamp;
+    this->__viewVersion.store(cmd.stamp, std::memory_order_relaxed);
+    for (const auto id : cmd.body) {
+      if (id != this->__id) {
+        this->__engine->peerJoined(id);
+      }
+    }
+    this->__viewReady = true;
 
-        this->__eventCtx.setTime();
+    // 조금 기다렸다가 락 걸기 시도
+    if (::randomWorkload) {
+      this->__eventCtx.addDelayedEvent(std::chrono::milliseconds(100), [this]() {
+        this->__acquireLock(this->__randomLockKey());
+      });
+    }
+    // 목록을 받기 전에 맡겨진 요청.
+    this->__runCalls();
+  }
 
-        while (this->__cmdQueue.q.empty() &&
-               (!this->__eventCtx.hasPendingEvent())) {
-          if (this->__eventCtx.hasEvent()) {
-            this->__cmdQueue.cv_despatch.wait_for(
-                ul, this->__eventCtx.timeToNextEvent());
-          } else {
-            this->__cmdQueue.cv_despatch.wait(ul);
-          }
+  // 피어가 생기거나 사라졌다는 통보.
+  void __applyDelta(const Command &cmd) {
+    const auto joined = cmd.op_code == OPC_THREAD_SPAWNED;
+    const auto apply = [&](const ContextID id) {
+      if (joined) {
+        this->__engine->peerJoined(id);
+      } else {
+        this->__engine->peerLeft(id);
+      }
+    };
 
-          this->__eventCtx.setTime();
-        }
+    // 받은 목록에 이미 들어 있는 변경.
+    if (cmd.stamp != 0 && cmd.stamp <= this->__viewBase) {
+      return;
+    }
 
-        if (this->__cmdQueue.q.empty()) {
-          cmd = nullptr;
-        } else {
-          cmd = this->__cmdQueue.q.front();
-          this->__cmdQueue.q.pop();
+    if (cmd.body.empty()) {
+      apply(cmd.context_from);
+    } else {
+      for (const auto id : cmd.body) {
+        if (id != this->__id) {
+          apply(id);
         }
       }
+    }
+    if (cmd.stamp > this->__viewVersion.load(std::memory_order_relaxed)) {
+      this->__viewVersion.store(cmd.stamp, std::memory_order_relaxed);
+    }
+  }
 
-      if (cmd != nullptr) {
-        switch (cmd->op_code) {
-        case OPC_SHUTDOWN:
-          runFlag = false;
-          break;
-        case OPC_THREAD_SPAWNED:
-          this->__cmdThreadSpawned(*cmd);
-          break;
-        case OPC_THREAD_DESPAWNED:
-          this->__cmdThreadDespawned(*cmd);
-          break;
-        case OPC_MY_LOCK:
-          this->__cmdMyLock(*cmd);
-          break;
-        case OPC_YOUR_LOCK:
-          this->__cmdYourLock(*cmd);
-          break;
-        case OPC_LOCK_RESET:
-          this->__cmdLockReset(*cmd);
-          break;
+  // 쌓인 명령을 한 번에 가져와 모두 처리한 뒤에 타이머를 돌리고, 그동안 보낼 명령은
+  // 모아 두었다가 마지막에 보냄. 종료 명령을 받았으면 거짓.
+  bool __step() {
+    Envelope *env, *batch;
+    Command *cmd;
+    uint64_t n;
+    const auto mallocBase = ::threadAllocCount();
+    bool runFlag = true;
+
+    batch = this->__cmdQueue.drain();
+    if (batch != nullptr) {
+      n = 0;
+      while (batch != nullptr) {
+        env = batch;
+        batch = env->next;
+        cmd = env->cmd;
+        Pool<Envelope>::free(env);
+
+        // 종료 명령 뒤의 명령은 버림.
+        if (runFlag) {
+          runFlag = this->__dispatch(*cmd);
+          n += 1;
         }
+        cmd->release();
+      }
+
+      this->__batchCount.fetch_add(1, std::memory_order_relaxed);
+      this->__processedCount.fetch_add(n, std::memory_order_relaxed);
+    }
 
-        delete cmd;
+    if (runFlag) {
+      this->__stampTrace();
+      const auto fired = this->__eventCtx.handle();
+
+      if (fired > 0) {
+        this->__trace(TRACE_TIMERS, 0, 0, 0, (uint32_t)fired);
       }
+    }
+    if (this->__retired && !this->__engine->lingering()) {
+      const auto cb = std::move(this->__retired);
+
+      this->__retired = nullptr;
+      cb(LOCK_STOPPED);
+    }
+    this->__flushOutbox();
+
+    this->__mallocCount.store(this->__mallocCount.load(std::memory_order_relaxed) +
+                                  ::threadAllocCount() - mallocBase,
+                              std::memory_order_relaxed);
 
-      if (runFlag) {
-        this->__eventCtx.handle();
+    return runFlag;
+  }
+
+  void __end() {
+    this->__stampTrace();
+    // 남은 요청을 끝냄. 이후의 요청은 `__post()`가 바로 끝냄.
+    {
+      std::lock_guard<std::mutex> lg(this->__callMtx);
+
+      this->__callsClosed = true;
+      this->__calls.swap(this->__callsTaken);
+    }
+    for (auto &c : this->__callsTaken) {
+      if (c.cb) {
+        c.cb(LOCK_STOPPED);
       }
-    } while (runFlag);
+    }
+    this->__callsTaken.clear();
+    if (this->__retired) {
+      const auto cb = std::move(this->__retired);
 
-    // 내가 죽는다는 것을 방송.
-    cmd = new Command;
-    cmd->op_code = OPC_THREAD_DESPAWNED;
-    cmd->context_from = this->__id;
-    cmd->context_to = 0;
-    ::sendCommand(cmd);
+      this->__retired = nullptr;
+      cb(LOCK_STOPPED);
+    }
+    for (auto &w : this->__waiters) {
+      for (auto &waiter : w) {
+        if (!waiter.group) {
+          waiter.cb(LOCK_STOPPED);
+        } else if (waiter.group->cb) {
+          // 다른 키에서 다시 부르지 않도록 비움.
+          auto cb = std::move(waiter.group->cb);
+
+          waiter.group->cb = nullptr;
+          cb(LOCK_STOPPED);
+        }
+      }
+      w.clear();
+    }
 
-    if (this->__lockCtx.state == LockContext::ACQUIRED) {
-      ::resource -= 1;
+    // 자원을 먼저 놓아야 다른 피어가 내가 나간 것을 보고 락을 얻었을 때 경쟁
+    // 상태로 오인하지 않음.
+    for (LockKey key = 0; key < this->__users.size(); key += 1) {
+      if (key < ::resources.size()) {
+        ::resources[key] -= this->__users[key] * ::resourceUnit(this->__modes[key]);
+      }
     }
+    this->__engine.reset();
+
+    // 내가 죽는다는 것을 방송.
+    ::sendCommand(Command::make(OPC_THREAD_DESPAWNED, this->__id, 0, 0,
+                                this->__departedAt.load(std::memory_order_relaxed)));
 
     // 이벤트 비우기.
     this->__eventCtx.clear();
   }
 
-  Command *__makeMyCommand(const OPCode op_code, const ContextID to) {
-    auto ret = new Command;
+  void __run() {
+    this->__eventCtx.setTime();
+    this->__begin();
 
-    ret->op_code = op_code;
-    ret->context_from = this->__id;
-    ret->context_to = to;
+    do {
+      this->__eventCtx.setTime();
 
-    return ret;
+      while (this->__cmdQueue.empty() &&
+             (!this->__eventCtx.hasPendingEvent())) {
+        this->__idle();
+      }
+    } while (this->__step());
+
+    this->__end();
   }
 
-  void __cmdThreadSpawned(const Command &cmd) {
-    this->__others.insert(cmd.context_from);
+  // 잠들기 전에 돌 시간(ns). 최근에 빈 시간의 평균이 `::spinWait` 안이면 그 두 배까지,
+  // 넘으면 돌아도 받지 못할 테니 0.
+  uint64_t __spinBudget() {
+    const uint64_t limit = (uint64_t)::spinWait * 1000;
+
+    if (limit == 0 || this->__idleAvg > limit) {
+      return 0;
+    }
+    return std::min(this->__idleAvg * 2, limit);
   }
 
-  void __cmdThreadDespawned(const Command &cmd) {
-    this->__others.erase(cmd.context_from);
+  // 명령이 들어오거나 가장 이른 타이머가 될 때까지 기다림. 돌다가 받지 못하면
+  // 명령과 타이머를 `epoll_wait()` 한 번으로 기다림.
+  void __idle() {
+    const auto idleAt = this->__eventCtx.now();
+    const auto deadline = this->nextEventTime();
+    const auto budget = this->__spinBudget();
+    bool arrived = false;
+
+    if (budget > 0) {
+      arrived = this->__cmdQueue.spinUntil(
+          std::min(deadline, idleAt + std::chrono::nanoseconds(budget)));
+      (arrived ? this->__spinHits : this->__spinMisses)
+          .fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!arrived) {
+      this->__cmdQueue.waitUntil(deadline);
+    }
+    this->__eventCtx.setTime();
 
-    this->__lockCtx.sentMyLock.erase(cmd.context_from);
-    this->__lockCtx.yourLockToRcv.erase(cmd.context_from);
-    this->__lockCtx.yourLockToSend.erase(cmd.context_from);
-    this->__lockCtx.rcvMyLock.erase(cmd.context_from);
+    if (::spinWait > 0) {
+      const auto idle = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+          this->__eventCtx.now() - idleAt).count();
 
-    // 락에 대한 예외처리.
-    switch (this->__lockCtx.state) {
-    case LockContext::LURKING:
-      if (this->__others.empty()) {
-        // 혼자 남음. 바로 락을 얻은 것으로 처리.
-        this->__lockCtx.state = LockContext::ACQUIRED;
-        this->__onLockAcquired();
-      } else if (this->__lockCtx.rcvMyLock.empty()) {
-        this->__lockCtx.state = LockContext::SOLICITING;
-        this->__solicitLock();
-      }
-      break;
-    case LockContext::SOLICITING:
-      if (this->__lockCtx.yourLockToRcv.empty()) {
-        // 내가 "MyLock" 명령을 보냈던 곳이 사라짐.
-        this->__lockCtx.state = LockContext::ACQUIRED;
-        this->__onLockAcquired();
-      }
-      break;
+      this->__idleAvg = this->__idleAvg - this->__idleAvg / 8 + idle / 8;
     }
   }
 
-  void __cmdMyLock(const Command &cmd) {
-    this->__lockCtx.rcvMyLock.insert(cmd.context_from);
+  // 지금 시각. 시뮬레이션 중에는 가상 시계.
+  std::chrono::steady_clock::time_point __now() {
+    return this->__simulated ? this->__eventCtx.now()
+                             : std::chrono::steady_clock::now();
+  }
+
+  LockEngine *__makeEngine() {
+    switch (::lockEngine) {
+    case LOCK_ENGINE_QUORUM:
+      return new QuorumEngine(*this, this->__id);
+    case LOCK_ENGINE_TOKEN:
+      return new TokenEngine(*this, this->__id);
+    default:
+      return new MultiphaseEngine(*this, this->__id);
+    }
+  }
 
-    switch (this->__lockCtx.state) {
-    // 락을 얻으려하지 않는 상태일 때.
-    case LockContext::NONE:
-    case LockContext::LURKING:
-      // 락을 그냥 준다.
-      ::sendCommand(this->__makeMyCommand(OPC_YOUR_LOCK, cmd.context_from));
+  // 종료 명령이면 거짓.
+  bool __dispatch(const Command &cmd) {
+    this->__stampTrace();
+    this->__trace(TRACE_RECV, cmd.context_from, cmd.key, cmd.op_code, cmd.stamp);
+    switch (cmd.op_code) {
+    case OPC_SHUTDOWN:
+      return false;
+    case OPC_THREAD_SPAWNED:
+    case OPC_THREAD_DESPAWNED:
+      this->__applyDelta(cmd);
+      break;
+    case OPC_MEMBERSHIP_VIEW:
+      this->__applyView(cmd);
       break;
-    case LockContext::SOLICITING: // 내가 락을 얻고 싶은 상태일 떄.
-      if (cmd.context_from > this->__id) { // 나보다 높은 놈이 락을 원함.
-        // 락을 준다.
-        ::sendCommand(this->__makeMyCommand(OPC_YOUR_LOCK, cmd.context_from));
-      } else { // 나보다 낮은 놈이 락을 원함.
-        // 락을 풀때 준다.
-        this->__lockCtx.yourLockToSend.insert(cmd.context_from);
+    case OPC_CALL:
+      if (this->__viewReady) {
+        this->__runCalls();
       }
       break;
-    case LockContext::ACQUIRED:
-      this->__lockCtx.yourLockToSend.insert(cmd.context_from);
+    default:
+      this->__engine->handle(cmd);
       break;
     }
+
+    return true;
+  }
+
+  // 바로 보내지 않고 `__flushOutbox()`까지 모아 둠.
+  void __send(Command *cmd) {
+    this->__sentCount.store(
+        this->__sentCount.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+    this->__trace(TRACE_SEND, cmd->context_to, cmd->key, cmd->op_code,
+                  cmd->stamp);
+    if (cmd->context_to == 0) {
+      // 방송은 묶지 않음. 순서를 지키려고 모아 둔 것부터 보냄.
+      this->__flushOutbox();
+      ::sendCommand(cmd);
+    } else {
+      this->__outbox.push_back(cmd);
+    }
   }
 
-  void __cmdYourLock(const Command &cmd) {
-    if (this->__lockCtx.state == LockContext::SOLICITING) {
-      this->__lockCtx.yourLockToRcv.erase(cmd.context_from);
-      if (this->__lockCtx.yourLockToRcv.empty()) {
-        this->__lockCtx.state = LockContext::ACQUIRED;
-        this->__onLockAcquired();
+  void __flushOutbox() {
+    size_t i, j;
+
+    if (this->__outbox.empty()) {
+      return;
+    }
+
+    // 받는 피어별로, 보낸 순서는 유지한 채 모음.
+    this->__outboxOrder.clear();
+    for (i = 0; i < this->__outbox.size(); i += 1) {
+      this->__outboxOrder.push_back(
+          std::make_pair(this->__outbox[i]->context_to, (uint32_t)i));
+    }
+    std::sort(this->__outboxOrder.begin(), this->__outboxOrder.end());
+
+    for (i = 0; i < this->__outboxOrder.size(); i = j) {
+      Envelope *newest = nullptr, *oldest = nullptr, *env;
+
+      for (j = i; j < this->__outboxOrder.size() &&
+                  this->__outboxOrder[j].first == this->__outboxOrder[i].first;
+           j += 1) {
+        env = Pool<Envelope>::alloc();
+        env->cmd = this->__outbox[this->__outboxOrder[j].second];
+        env->next = newest;
+        if (oldest == nullptr) {
+          oldest = env;
+        }
+        newest = env;
       }
-    } else { // WHAT??
-      // 내가 보낸 "LockReset" 명령이 이 end에 전달이 안 된 상태에서 보낸 것일
-      // 수 있음. 일단 보고하기.
-      std::stringstream ss;
 
-      ss << "* Rogue 'YourLock' command received from context "
-         << cmd.context_from << " by " << this->__id << '.';
-      __REPORT(ss.str());
+      ::sendCommandChain(this->__outboxOrder[i].first, newest, oldest);
+    }
+
+    this->__outbox.clear();
+  }
+
+  // 이하 락 API를 피어의 스레드에서 처리.
+  void __lock(const LockKey key, const LockMode mode, LockCallback &&cb,
+              const std::chrono::milliseconds timeout =
+                  std::chrono::milliseconds::max()) {
+    const auto id = this->__lastWaiterID += 1;
+    EventContext::EventID timer = 0;
+
+    if (timeout != std::chrono::milliseconds::max()) {
+      timer = this->__timeoutEvent(id);
+      this->__eventCtx.addDelayedEvent(timeout, [this, key, id]() {
+        this->__expire(key, id);
+      }, timer);
+    }
+    this->__waiters[key].push_back(
+        __Waiter{id, mode, std::move(cb), nullptr, timer});
+    if (this->__users[key] > 0) {
+      // 공유로 가지고 있으면 같이 얻을 수 있음.
+      this->__grant(key);
+    } else if (!this->__holding[key] && !this->__requested[key]) {
+      this->__request(key);
+    }
+  }
+
+  void __lockAll(std::vector<LockKey> &&keys, LockCallback &&cb) {
+    const auto group = std::make_shared<__Group>();
+
+    group->keys = std::move(keys);
+    group->cb = std::move(cb);
+    group->requested = false;
+    for (const auto key : group->keys) {
+      this->__waiters[key].push_back(
+          __Waiter{this->__lastWaiterID += 1, LOCK_EXCLUSIVE, nullptr, group, 0});
+    }
+    this->__requestGroup(group);
+  }
+
+  EventContext::EventID __timeoutEvent(const uint64_t id) const {
+    return __STARVATION_EVENT__ + ::nbLockKeys + id;
+  }
+
+  // 기다리던 요청이 빠짐. 기한이 있었으면 지움.
+  void __untime(const __Waiter &waiter) {
+    if (waiter.timer != 0) {
+      this->__eventCtx.cancelEvent(waiter.timer);
+    }
+  }
+
+  // `tryAcquire()`의 기한이 지남. 아직 기다리고 있으면 뺌.
+  void __expire(const LockKey key, const uint64_t id) {
+    auto &waiters = this->__waiters[key];
+    const auto it = std::find_if(waiters.begin(), waiters.end(),
+                                 [id](const __Waiter &w) { return w.id == id; });
+    LockCallback cb;
+
+    if (it == waiters.end()) {
+      return;
+    }
+    cb = std::move(it->cb);
+    waiters.erase(it);
+    this->__timeoutCount += 1;
+    this->__trace(TRACE_TIMEOUT, 0, key);
+    // 다른 키로 바로 다시 얻으려 할 수 있으므로 정리하기 전에 알림. 같은 키면 엔진에
+    // 낸 요청을 그대로 씀.
+    cb(LOCK_TIMEOUT);
+    this->__settle(key);
+  }
+
+  // 기다리던 요청이 빠졌음. 공유로 가지고 있으면 새로 맨 앞이 된 요청도 같이 얻을
+  // 수 있는지 봄. 엔진에 낸 요청을 기다리는 요청이 더 없거나, 그 요청으로는 맨 앞의
+  // 한꺼번에 얻으려는 요청에 넘길 수 없으면 포기함.
+  void __settle(const LockKey key) {
+    const auto &waiters = this->__waiters[key];
+
+    if (this->__users[key] > 0) {
+      this->__grant(key);
+      return;
+    }
+    if (!this->__requested[key] || this->__holding[key]) {
+      return;
+    }
+
+    if (waiters.empty()) {
+      this->__abandon(key);
+    } else if (waiters.front().group && !waiters.front().group->requested) {
+      this->__abandon(key);
+      this->__request(key);
+    }
+  }
+
+  // 엔진에 낸 요청을 얻기 전에 포기함.
+  void __abandon(const LockKey key) {
+    const auto sent = this->sentCount();
+
+    this->__eventCtx.cancelEvent(__STARVATION_EVENT__ + key);
+    this->__requested[key] = 0;
+    this->__trace(TRACE_ABANDONED, 0, key);
+    this->__engine->release(key);
+    this->__abandonedCount += 1;
+    this->__abandonSentCount += this->sentCount() - sent;
+  }
+
+  void __unlock(const LockKey key) {
+    if (this->__users[key] == 0) {
+      return;
+    }
+
+    if (key < ::resources.size()) {
+      ::resources[key] -= ::resourceUnit(this->__modes[key]);
+    }
+    this->__users[key] -= 1;
+    if (this->__users[key] == 0) {
+      this->__releaseEngine(key);
     }
   }
 
-  void __cmdLockReset(const Command &cmd) {
-    this->__lockCtx.rcvMyLock.erase(cmd.context_from);
-    this->__lockCtx.yourLockToSend.erase(cmd.context_from);
+  // 엔진에서 얻은 락을 놓음. 이 피어에서 기다리는 요청이 남았으면 다시 얻음.
+  void __releaseEngine(const LockKey key) {
+    this->__holding[key] = 0;
+    this->__trace(TRACE_RELEASED, 0, key);
+    this->__engine->release(key);
+
+    if (!this->__waiters[key].empty()) {
+      this->__request(key);
+    }
+  }
+
+  // 엔진에서 얻은 락을 기다리던 요청에 먼저 온 것부터 넘김. 배타로 얻었으면 하나,
+  // 공유로 얻었으면 배타 요청을 만날 때까지 공유 요청들에 넘김.
+  void __grant(const LockKey key) {
+    auto &waiters = this->__waiters[key];
+
+    while (!waiters.empty()) {
+      const auto mode = this->__modes[key];
+
+      if (waiters.front().group) {
+        // 모든 키를 얻어야 넘김. `__advanceGroup()` 참고.
+        break;
+      }
+      if (mode == LOCK_EXCLUSIVE) {
+        if (this->__users[key] > 0) {
+          break;
+        }
+      } else if (waiters.front().mode != LOCK_SHARED ||
+                 (this->__users[key] > 0 && !this->__engine->shareable(key))) {
+        break;
+      }
+
+      auto cb = std::move(waiters.front().cb);
 
-    if (this->__lockCtx.state == LockContext::LURKING &&
-        this->__lockCtx.rcvMyLock.empty()) {
-      // 엿듣던 중 - 아무도 락을 걸려 하지 않음.
-      // 내가 락을 얻을 차례.
-      this->__lockCtx.state = LockContext::SOLICITING;
-      this->__solicitLock();
+      this->__untime(waiters.front());
+      waiters.erase(waiters.begin());
+      this->__users[key] += 1;
+      this->__checkResource(key, mode);
+      cb(LOCK_ACQUIRED);
     }
   }
 
-  void __solicitLock() {
-    this->__lockCtx.yourLockToRcv.clear();
+  // 락 `key`를 `mode`로 하나 더 가지게 되었을 때 다른 쪽과 겹치는지 확인.
+  void __checkResource(const LockKey key, const LockMode mode) {
+    uint32_t rsrc, exclusive, shared;
 
-    for (const auto &other : this->__others) {
-      ::sendCommand(this->__makeMyCommand(OPC_MY_LOCK, other));
-      this->__lockCtx.sentMyLock.insert(other);
-      this->__lockCtx.yourLockToRcv.insert(other);
+    if (key >= ::resources.size()) {
+      return;
+    }
+
+    rsrc = ::resources[key].fetch_add(::resourceUnit(mode));
+    exclusive = rsrc >> RESOURCE_EXCLUSIVE_SHIFT;
+    shared = rsrc & RESOURCE_SHARED_MASK;
+    if (exclusive != 0 || (mode == LOCK_EXCLUSIVE && shared != 0)) {
+      std::stringstream ss;
+
+      ss << "* Race state detected(" << exclusive << " exclusive, " << shared
+         << " shared) by thread " << this->__id << " for key " << key << " ("
+         << (mode == LOCK_SHARED ? "shared" : "exclusive") << ')';
+      __REPORT(ss.str());
     }
   }
 
-  void __acquireLock() {
-    if (this->__lockCtx.state == LockContext::NONE) {
-      uint32_t starveTimeout;
+  void __cancel(const LockKey key) {
+    std::vector<__Waiter> waiters;
 
-      if (this->__others.empty()) {
-        // 혼자 있음. 바로 락을 얻은 것으로 처리.
-        this->__lockCtx.state = LockContext::ACQUIRED;
-        this->__onLockAcquired();
+    waiters.swap(this->__waiters[key]);
+    for (auto &waiter : waiters) {
+      this->__untime(waiter);
+      if (waiter.group) {
+        this->__dropGroup(waiter.group, key);
       } else {
-        if (this->__lockCtx.rcvMyLock.empty()) {
-          // 아무도 락을 얻으려 하지 않음.
-          this->__lockCtx.state = LockContext::SOLICITING;
-          this->__solicitLock();
-        } else {
-          // 이미 누군가 락을 얻으려 하고 있음.
-          // 다 끝날 때까지 기다림.
-          this->__lockCtx.state = LockContext::LURKING;
+        waiter.cb(LOCK_CANCELLED);
+      }
+    }
+    // 한꺼번에 얻으려는 요청에 넘기려고 들고 있던 락이면 놓음.
+    if (this->__holding[key] && this->__users[key] == 0) {
+      this->__releaseEngine(key);
+    } else {
+      this->__settle(key);
+    }
+  }
+
+  // 한꺼번에 얻으려는 요청을 `except`가 아닌 키들에서 빼고 `LOCK_CANCELLED`로 끝냄.
+  // 그 요청 때문에 엔진에 낸 요청은 포기하고, 넘기려고 들고 있던 락은 다음 요청에
+  // 넘기고, 그 요청 뒤에서 기다리던 요청은 이제 얻으려 함.
+  void __dropGroup(const std::shared_ptr<__Group> group, const LockKey except) {
+    auto cb = std::move(group->cb);
+
+    group->cb = nullptr;
+    for (const auto key : group->keys) {
+      auto &waiters = this->__waiters[key];
+
+      if (key != except) {
+        // 한꺼번에 얻으려는 요청은 얻거나 여기서 빠질 때까지 모든 키에서 기다리므로
+        // 반드시 있음. 없으면 `__advanceGroup()`이나 `__cancel()`이 그 약속을 깬 것.
+        const auto it = std::find_if(waiters.begin(), waiters.end(),
+                                     [&group](const __Waiter &w) {
+                                       return w.group == group;
+                                     });
+
+        if (it == waiters.end()) {
+          std::lock_guard<std::mutex> lg(::stdioLock);
+
+          std::cerr << "*** Lock group is not waiting on key " << key << "!"
+                    << std::endl;
+          ::abort();
+        }
+        waiters.erase(it);
+      }
+    }
+    // 엔진이 한꺼번에 얻으려던 키는 하나만 남길 수 없으므로, 다른 요청이 기다리고
+    // 있어도 포기하고 다시 얻음.
+    if (group->requested) {
+      for (const auto key : group->keys) {
+        if (this->__requested[key] && !this->__holding[key]) {
+          this->__abandon(key);
         }
       }
+    }
+    for (const auto key : group->keys) {
+      const auto &waiters = this->__waiters[key];
 
-      if (::maxLockHoldTime == 0) {
-        starveTimeout = 1000;
+      if (key == except) {
+        continue;
       }
-      else {
-        starveTimeout = ::maxLockHoldTime * (uint32_t)::threads.size() * 10;
+      if (this->__holding[key] && this->__users[key] == 0) {
+        this->__grantOrRelease(key);
+      } else if (!this->__holding[key] && !this->__requested[key] &&
+                 !waiters.empty()) {
+        this->__request(key);
       }
+    }
 
-      this->__eventCtx.addDelayedEvent(std::chrono::milliseconds(starveTimeout), []() {
-        std::lock_guard<std::mutex> lg(::stdioLock);
+    cb(LOCK_CANCELLED);
+  }
 
-        std::cerr << "*** Starvation detected!" << std::endl;
-        ::abort();
-      }, __STARVATION_EVENT__);
+  // 먼저 온 요청의 모드로 엔진에 얻기를 요청함.
+  void __request(const LockKey key) {
+    const auto &front = this->__waiters[key].front();
+
+    if (front.group) {
+      this->__requestGroup(front.group);
+    } else {
+      this->__requestEngine(key, front.mode);
     }
   }
 
-  void __releaseLock() {
-    switch (this->__lockCtx.state) { // 이미 뭔가를 보냈을 때.
-    case LockContext::ACQUIRED:
-      // 락을 주지 않은 다른 곳에 이제 줌.
-      for (const auto &other : this->__lockCtx.yourLockToSend) {
-        ::sendCommand(this->__makeMyCommand(OPC_YOUR_LOCK, other));
+  // 한꺼번에 얻으려는 요청이 모든 키에서 맨 앞이고 어느 키도 엔진에서 얻었거나
+  // 얻으려는 중이 아니면 엔진에 요청함. 아니면 막고 있는 키를 놓을 때 다시 옴.
+  void __requestGroup(const std::shared_ptr<__Group> group) {
+    if (group->requested) {
+      return;
+    }
+    for (const auto key : group->keys) {
+      if (this->__waiters[key].front().group != group ||
+          this->__holding[key] || this->__requested[key]) {
+        return;
       }
-      this->__lockCtx.yourLockToSend.clear();
-      /* fall through */
-    case LockContext::SOLICITING:
-      // 다른 이에게 내가 락을 풀었다는 것을 통보.
-      for (const auto &other : this->__lockCtx.sentMyLock) {
-        ::sendCommand(this->__makeMyCommand(OPC_LOCK_RESET, other));
+    }
+
+    group->requested = true;
+    for (const auto key : group->keys) {
+      this->__requested[key] = 1;
+      this->__requestedAt[key] = this->__now();
+      this->__modes[key] = LOCK_EXCLUSIVE;
+      this->__trace(TRACE_REQUEST, 0, key, 0, LOCK_EXCLUSIVE);
+    }
+    if (!this->__engine->acquireAll(group->keys)) {
+      // 한꺼번에 얻지 못하는 엔진. 모두 키 순서대로 얻으므로 교착이 생기지 않음.
+      for (const auto key : group->keys) {
+        this->__requested[key] = 0;
       }
-      this->__lockCtx.sentMyLock.clear();
-      break;
+      this->__advanceGroup(group);
+      return;
+    }
+    // 바로 얻었을 수 있음.
+    for (const auto key : group->keys) {
+      if (this->__requested[key]) {
+        this->__watchStarvation(key);
+      }
+    }
+  }
+
+  // 한꺼번에 얻으려는 요청의 키를 모두 얻었으면 넘기고, 아니면 얻지 않은 첫 키를
+  // 얻으려 함. 엔진이 한꺼번에 얻었으면 이미 모두 얻으려는 중임.
+  void __advanceGroup(const std::shared_ptr<__Group> group) {
+    LockCallback cb;
+
+    for (const auto key : group->keys) {
+      if (!this->__holding[key]) {
+        if (!this->__requested[key]) {
+          this->__requestEngine(key, LOCK_EXCLUSIVE);
+        }
+        return;
+      }
+    }
+
+    cb = std::move(group->cb);
+    group->cb = nullptr;
+    for (const auto key : group->keys) {
+      auto &waiters = this->__waiters[key];
+
+      this->__untime(waiters.front());
+      waiters.erase(waiters.begin());
+      this->__users[key] = 1;
+      this->__checkResource(key, LOCK_EXCLUSIVE);
+    }
+    cb(LOCK_ACQUIRED);
+  }
+
+  void __requestEngine(const LockKey key, const LockMode mode) {
+    this->__requested[key] = 1;
+    this->__requestedAt[key] = this->__now();
+    this->__modes[key] = mode;
+    this->__trace(TRACE_REQUEST, 0, key, 0, mode);
+    // 바로 얻었을 수 있음.
+    if (!this->__engine->acquire(key, mode) || !this->__requested[key]) {
+      return;
+    }
+    this->__watchStarvation(key);
+  }
+
+  // 락 `key`를 너무 오래 얻지 못하면 멈춤.
+  void __watchStarvation(const LockKey key) {
+    uint32_t starveTimeout;
+
+    if (::maxLockHoldTime == 0) {
+      starveTimeout = 1000;
+    }
+    else {
+      starveTimeout =
+          ::maxLockHoldTime *
+          (uint32_t)(::contextCount() + ::remoteContextCount()) * 10;
     }
 
-    this->__lockCtx.state = LockContext::NONE;
+    this->__eventCtx.addDelayedEvent(std::chrono::milliseconds(starveTimeout), [this]() {
+      // 목록에서 빠진 피어끼리는 주고받지 못함.
+      if (this->__departedAt.load(std::memory_order_relaxed) != 0) {
+        return;
+      }
+
+      std::lock_guard<std::mutex> lg(::stdioLock);
+
+      std::cerr << "*** Starvation detected!" << std::endl;
+      ::abort();
+    }, __STARVATION_EVENT__ + key);
   }
 
-  void __onLockAcquired() {
-    std::stringstream ss;
-    uint32_t rsrc;
+  // 무작위 작업 부하. 락 API로 락을 얻어 잠시 가지고 있다가 놓은 뒤 잠시 쉬고
+  // 다시 얻음.
+  void __acquireLock(const LockKey key) {
+    const auto timeout = ::acquireTimeout > 0 ?
+      std::chrono::milliseconds(::acquireTimeout) :
+      std::chrono::milliseconds::max();
 
-    this->__eventCtx.cancelEvent(__STARVATION_EVENT__);
+    if (this->__retiring) {
+      return;
+    }
+
+    this->__lock(key, this->__randomLockMode(), [this, key](const LockResult result) {
+      if (result == LOCK_TIMEOUT) {
+        // 오래 걸리는 방은 포기하고 다른 방을 얻으러 감.
+        this->__acquireLock(this->__randomLockKey());
+        return;
+      }
+      if (result != LOCK_ACQUIRED) {
+        return;
+      }
+
+      // 처리 지연을 시뮬레이션한 뒤 락을 해제함.
+      this->__eventCtx.addDelayedEvent(this->__randomLockHoldTime(), [this, key]() {
+        this->__unlock(key);
+        this->__eventCtx.addDelayedEvent(this->__randomAcquireDelay(), [this]() {
+          this->__acquireLock(this->__randomLockKey());
+        });
+      });
+    }, timeout);
+  }
+
+  // 다음에 얻으려 할 락.
+  LockKey __randomLockKey() {
+    return (LockKey)(this->__rnd() % ::nbLockKeys);
+  }
+
+public:
+  void engineSend(Command *cmd) { this->__send(cmd); }
+
+  std::chrono::steady_clock::time_point engineNow() { return this->__now(); }
+
+  void engineAcquired(const LockKey key) {
+    this->__trace(TRACE_ACQUIRED, 0, key);
+    this->__eventCtx.cancelEvent(__STARVATION_EVENT__ + key);
     this->__acquiredCount += 1;
+    this->__requested[key] = 0;
+    this->__holding[key] = 1;
 
-    rsrc = ::resource.fetch_add(1);
-    if (rsrc != 0) {
-      ss << "* Race state detected(" << rsrc << ") by thread " << this->__id;
-      __REPORT(ss.str());
+    {
+      const auto latency =
+          (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+              this->__now() - this->__requestedAt[key])
+              .count();
+
+      this->__latency.record(latency);
     }
 
-    // 처리 지연을 시뮬레이션한 뒤 락을 해제함.
-    this->__eventCtx.addDelayedEvent(this->__randomLockHoldTime(), [this]() {
-      ::resource -= 1;
-      this->__releaseLock();
-      this->__eventCtx.addDelayedEvent(this->__randomAcquireDelay(),
-                                       [this]() { this->__acquireLock(); });
-    });
+    if (this->__waiters[key].empty()) {
+      // 기다리던 요청이 모두 취소됨. 엔진 안에서 불렸을 수 있으므로 차례가 끝난
+      // 뒤에 놓음. 그 사이에 새 요청이 오면 그 요청에 넘김.
+      this->__eventCtx.addDelayedEvent(std::chrono::milliseconds(0), [this, key]() {
+        this->__grantOrRelease(key);
+      });
+      return;
+    }
+
+    this->__grantOrRelease(key);
+  }
+
+protected:
+  // 엔진에서 막 얻은 락을 기다리는 요청에 넘김. 넘길 요청이 없거나, 공유로 얻었는데
+  // 먼저 온 요청이 배타면 놓고 다시 얻음. 그 사이에 이미 놓았으면 아무것도 안 함.
+  void __grantOrRelease(const LockKey key) {
+    const auto &waiters = this->__waiters[key];
+
+    if (!this->__holding[key]) {
+      return;
+    }
+
+    if (!waiters.empty() && waiters.front().group &&
+        waiters.front().group->requested) {
+      // 한꺼번에 얻으려는 요청을 위해 얻은 락.
+      this->__advanceGroup(waiters.front().group);
+      return;
+    }
+
+    this->__grant(key);
+    if (this->__users[key] == 0) {
+      this->__releaseEngine(key);
+    }
   }
 };
 
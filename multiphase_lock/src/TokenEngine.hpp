@@ -0,0 +1,537 @@
+#ifndef TOKENENGINE_H_
+#define TOKENENGINE_H_
+#include "LockEngine.hpp"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Suzuki-Kasami 방식. 락 키마다 토큰이 하나 있고, 토큰을 가진 피어만 락을 얻는다.
+// 토큰이 없는 피어는 요청 번호를 하나 올려 다른 모든 피어에게 알린다. 토큰을 가진
+// 피어는 락을 놓을 때, 토큰에 적힌 피어별로 마지막으로 처리한 요청 번호와 비교해
+// 아직 처리하지 않은 요청을 토큰의 대기열에 넣고 맨 앞의 피어에게 토큰을 넘긴다.
+// 락 한 번에 메시지는 많아야 N개이고, 토큰을 가진 채 다시 얻을 때는 보내지 않는다.
+// 토큰을 가진 피어가 사라지면 토큰도 사라진다. 그래서 피어가 사라질 때마다 ID가 가장
+// 작은 피어(대표)가 라운드를 돌려 모든 피어에게 토큰이 있는지 묻고, 아무도 없는
+// 키는 토큰을 새로 만든다. 라운드에 답한 피어는 라운드가 끝날 때까지 토큰을 얼려 두고,
+// 라운드마다 세대를 올려 지난 세대의 토큰은 받는 즉시 버린다. 모든 피어가 이 엔진을
+// 써야 함.
+class TokenEngine : public LockEngine {
+protected:
+  // 라운드의 세대와 라운드를 돌린 피어. 클수록 나중.
+  typedef std::pair<uint32_t, ContextID> Generation;
+
+  // `OPC_TOKEN_PROBE_ACK` 본문의 플래그.
+  static const uint32_t __HOLDS_TOKEN__ = 1;
+  static const uint32_t __WAITING__ = 2;
+
+  // 토큰을 받을 때마다 새로 할당하지 않도록 벡터에 담아 용량을 계속 씀.
+  struct Token {
+    Generation gen;
+    // 피어별로 마지막으로 처리한 요청 번호. ID 순.
+    std::vector<std::pair<ContextID, uint32_t>> served;
+    // 토큰을 받을 차례를 기다리는 피어들.
+    std::vector<ContextID> queue;
+  };
+
+  struct KeyState {
+    enum State {
+      IDLE,
+      WAITING,
+      HELD
+    };
+
+    State state = IDLE;
+    // 피어별로 알고 있는 가장 큰 요청 번호. 나 포함.
+    std::map<ContextID, uint32_t> requested;
+    bool hasToken = false;
+    // 참이면 라운드가 끝날 때까지 토큰을 쓰지도 넘기지도 않음.
+    bool frozen = false;
+    Token token;
+  };
+
+  // 대표로서 돌리는 라운드. 세대는 `__gen`.
+  struct Round {
+    bool active = false;
+    // 아직 답하지 않은 피어들.
+    std::set<ContextID> awaiting;
+    // 키별로 토큰을 가졌다고 답한 피어들.
+    std::map<LockKey, std::vector<ContextID>> holders;
+    // 키별로 새 토큰에 적을, 피어별로 마지막으로 처리한 요청 번호.
+    std::map<LockKey, std::map<ContextID, uint32_t>> served;
+  };
+
+  std::unordered_map<LockKey, KeyState> __keys;
+  // 지금까지 본 가장 나중 세대. 토큰도 라운드도 본 적 없으면 (0, 0).
+  Generation __gen;
+  Round __round;
+  // `__serve()`에서 씀.
+  std::vector<ContextID> __queued;
+
+  KeyState &__keyState(const LockKey key) {
+    return this->__keys[key];
+  }
+
+  bool __isMember(const ContextID id) {
+    return this->__others.count(id) > 0;
+  }
+
+  // 내가 아는 피어 중 ID가 가장 작은지.
+  bool __isCoordinator() {
+    return this->__others.empty() || *this->__others.begin() > this->__id;
+  }
+
+  static std::vector<std::pair<ContextID, uint32_t>>::iterator
+  __findServed(Token &token, const ContextID id) {
+    return std::lower_bound(token.served.begin(), token.served.end(),
+                            std::make_pair(id, (uint32_t)0));
+  }
+
+  static uint32_t __servedOf(Token &token, const ContextID id) {
+    const auto it = __findServed(token, id);
+
+    return it == token.served.end() || it->first != id ? 0 : it->second;
+  }
+
+  static void __setServed(Token &token, const ContextID id, const uint32_t n) {
+    const auto it = __findServed(token, id);
+
+    if (it == token.served.end() || it->first != id) {
+      token.served.insert(it, std::make_pair(id, n));
+    } else {
+      it->second = n;
+    }
+  }
+
+  // 본문: 세대를 만든 피어, 처리한 요청 수 n, (피어, 요청 번호) n쌍, 대기열.
+  // `stamp`는 세대.
+  static void __encodeToken(Command &cmd, const Token &token) {
+    cmd.body.reserve(2 + token.served.size() * 2 + token.queue.size());
+    cmd.body.push_back(token.gen.second);
+    cmd.body.push_back((uint32_t)token.served.size());
+    for (const auto &p : token.served) {
+      cmd.body.push_back(p.first);
+      cmd.body.push_back(p.second);
+    }
+    for (const auto &id : token.queue) {
+      cmd.body.push_back(id);
+    }
+  }
+
+  static bool __validToken(const Command &cmd) {
+    return cmd.body.size() >= 2 && cmd.body.size() >= 2 + (size_t)cmd.body[1] * 2;
+  }
+
+  // `__validToken()`을 통과한 본문만.
+  static void __decodeToken(const Command &cmd, Token &token) {
+    const auto &b = cmd.body;
+    const size_t n = b[1];
+    size_t i;
+
+    token.gen = Generation(cmd.stamp, b[0]);
+    token.served.clear();
+    token.queue.clear();
+    for (i = 0; i < n; i += 1) {
+      token.served.push_back(std::make_pair(b[2 + i * 2], b[3 + i * 2]));
+    }
+    token.queue.insert(token.queue.end(), b.begin() + 2 + n * 2, b.end());
+  }
+
+  void __dropToken(KeyState &ks) {
+    ks.hasToken = false;
+    ks.frozen = false;
+    ks.token.served.clear();
+    ks.token.queue.clear();
+  }
+
+  void __sendToken(KeyState &ks, const ContextID to, const LockKey key) {
+    auto cmd = this->__makeMyCommand(OPC_TOKEN, to, key, ks.token.gen.first);
+
+    __encodeToken(*cmd, ks.token);
+    this->__dropToken(ks);
+    this->__send(cmd);
+  }
+
+  // 토큰을 가지고 있고 쓰지 않는 중이면, 기다리는 피어에게 넘김.
+  void __serve(KeyState &ks, const LockKey key) {
+    auto &token = ks.token;
+
+    if (!ks.hasToken || ks.frozen || ks.state == KeyState::HELD) {
+      return;
+    }
+
+    this->__queued.assign(token.queue.begin(), token.queue.end());
+    std::sort(this->__queued.begin(), this->__queued.end());
+    // 요청을 포기하고 다시 내면 앞 요청이 처리되기 전에 번호가 둘 이상 앞설 수 있음.
+    for (const auto &p : ks.requested) {
+      if (p.first != this->__id &&
+          !std::binary_search(this->__queued.begin(), this->__queued.end(),
+                              p.first) &&
+          p.second > __servedOf(token, p.first)) {
+        token.queue.push_back(p.first);
+      }
+    }
+
+    while (!token.queue.empty()) {
+      const auto next = token.queue.front();
+
+      token.queue.erase(token.queue.begin());
+      if (this->__isMember(next)) {
+        this->__sendToken(ks, next, key);
+        return;
+      }
+    }
+  }
+
+  // 쓸 수 있는 토큰이 생겼음.
+  void __takeToken(KeyState &ks, const LockKey key) {
+    if (ks.state == KeyState::WAITING) {
+      ks.state = KeyState::HELD;
+      this->__host.engineAcquired(key);
+    } else {
+      // 요청을 거둬들인 뒤에 받음. 그 요청은 처리한 것으로 침.
+      __setServed(ks.token, this->__id, ks.requested[this->__id]);
+      this->__serve(ks, key);
+    }
+  }
+
+  void __freezeTokens() {
+    for (auto &p : this->__keys) {
+      if (p.second.hasToken) {
+        p.second.frozen = true;
+      }
+    }
+  }
+
+  // 라운드에 낼 답. 키마다 (키, 플래그, 내 요청 번호).
+  void __describe(std::vector<uint32_t> &body) {
+    for (auto &p : this->__keys) {
+      auto &ks = p.second;
+      const auto mine = ks.requested[this->__id];
+      const uint32_t flags = (ks.hasToken ? __HOLDS_TOKEN__ : 0) |
+                             (ks.state == KeyState::WAITING ? __WAITING__ : 0);
+
+      if (flags != 0 || mine > 0) {
+        body.push_back(p.first);
+        body.push_back(flags);
+        body.push_back(mine);
+      }
+    }
+  }
+
+  void __tally(const ContextID from, const std::vector<uint32_t> &body) {
+    size_t i;
+
+    for (i = 0; i + 3 <= body.size(); i += 3) {
+      const LockKey key = body[i];
+      const auto flags = body[i + 1];
+      const auto n = body[i + 2];
+      auto &r = this->__keyState(key).requested[from];
+
+      if (flags & __HOLDS_TOKEN__) {
+        this->__round.holders[key].push_back(from);
+      }
+      // 기다리는 중이면 마지막 요청은 아직 처리되지 않았음.
+      this->__round.served[key][from] = (flags & __WAITING__) ? n - 1 : n;
+      if (n > r) {
+        r = n;
+      }
+    }
+  }
+
+  void __probe(const ContextID to, const ContextID departed) {
+    auto cmd = this->__makeMyCommand(OPC_TOKEN_PROBE, to, 0, this->__gen.first);
+
+    if (departed != 0) {
+      cmd->body.push_back(departed);
+    }
+    this->__send(cmd);
+  }
+
+  // 대표로서 새 세대의 라운드를 시작함. `departed`는 라운드의 계기가 된 사라진 피어.
+  void __startRound(const ContextID departed) {
+    std::vector<uint32_t> mine;
+
+    this->__gen = Generation(this->__gen.first + 1, this->__id);
+    this->__freezeTokens();
+    this->__round.active = true;
+    this->__round.awaiting = this->__others;
+    this->__round.holders.clear();
+    this->__round.served.clear();
+
+    this->__describe(mine);
+    this->__tally(this->__id, mine);
+    for (const auto &other : this->__others) {
+      this->__probe(other, departed);
+    }
+
+    if (this->__round.awaiting.empty()) {
+      this->__concludeRound();
+    }
+  }
+
+  // 모두 답했음. 키마다 토큰을 가진 피어 하나만 남기고, 아무도 없으면 새로 만듦.
+  void __concludeRound() {
+    this->__round.active = false;
+
+    for (LockKey key = 0; key < ::nbLockKeys; key += 1) {
+      auto &holders = this->__round.holders[key];
+      auto &ks = this->__keyState(key);
+      size_t i;
+
+      if (holders.empty()) {
+        this->__dropToken(ks);
+        ks.token.gen = this->__gen;
+        ks.token.served.assign(this->__round.served[key].begin(),
+                               this->__round.served[key].end());
+        ks.hasToken = true;
+        this->__takeToken(ks, key);
+        continue;
+      }
+
+      // 여럿이면 노드가 합쳐지며 생긴 중복.
+      std::sort(holders.begin(), holders.end());
+      for (i = 0; i < holders.size(); i += 1) {
+        const auto op_code = i == 0 ? OPC_TOKEN_KEEP : OPC_TOKEN_DROP;
+
+        if (holders[i] == this->__id) {
+          this->__resolve(ks, op_code, key);
+        } else {
+          this->__send(this->__makeMyCommand(op_code, holders[i], key,
+                                             this->__gen.first));
+        }
+      }
+    }
+  }
+
+  void __resolve(KeyState &ks, const OPCode op_code, const LockKey key) {
+    if (!ks.hasToken) {
+      return;
+    }
+
+    if (op_code == OPC_TOKEN_KEEP) {
+      ks.frozen = false;
+      ks.token.gen = this->__gen;
+      if (ks.state != KeyState::HELD) {
+        this->__takeToken(ks, key);
+      }
+    } else {
+      this->__dropToken(ks);
+    }
+  }
+
+  void __cmdRequest(const Command &cmd) {
+    auto &ks = this->__keyState(cmd.key);
+    auto &r = ks.requested[cmd.context_from];
+
+    if (cmd.stamp > r) {
+      r = cmd.stamp;
+    }
+    this->__serve(ks, cmd.key);
+  }
+
+  void __cmdToken(const Command &cmd) {
+    auto &ks = this->__keyState(cmd.key);
+
+    if (!__validToken(cmd)) {
+      std::stringstream ss;
+
+      ss << "* Rogue token received from context " << cmd.context_from
+         << " by " << this->__id << " for key " << cmd.key << '.';
+      __REPORT(ss.str());
+      return;
+    }
+
+    const Generation gen(cmd.stamp, cmd.body[0]);
+
+    if (gen < this->__gen) {
+      // 라운드 전에 보낸 토큰. 라운드에서 이미 남길 토큰을 정했음.
+      return;
+    }
+    if (gen > this->__gen) {
+      // 내가 모르는 새 세대의 라운드가 끝났음. 그 라운드가 모르는 내 토큰은 중복.
+      this->__gen = gen;
+      this->__round.active = false;
+      for (auto &p : this->__keys) {
+        this->__dropToken(p.second);
+      }
+    }
+    if (ks.hasToken) {
+      std::stringstream ss;
+
+      ss << "* Duplicate token received from context " << cmd.context_from
+         << " by " << this->__id << " for key " << cmd.key << '.';
+      __REPORT(ss.str());
+      return;
+    }
+
+    __decodeToken(cmd, ks.token);
+    ks.hasToken = true;
+    ks.frozen = false;
+    this->__takeToken(ks, cmd.key);
+  }
+
+  void __cmdProbe(const Command &cmd) {
+    const Generation gen(cmd.stamp, cmd.context_from);
+    auto ack = (Command*)nullptr;
+
+    // 사라진 피어를 대표보다 늦게 알 수 있음. 그 전에 토큰을 넘기지 않도록 먼저 처리.
+    if (!cmd.body.empty() && cmd.body[0] != 0) {
+      this->peerLeft(cmd.body[0]);
+    }
+
+    if (gen < this->__gen) {
+      return;
+    }
+    if (gen > this->__gen) {
+      this->__gen = gen;
+      this->__round.active = false;
+      this->__freezeTokens();
+    }
+
+    ack = this->__makeMyCommand(OPC_TOKEN_PROBE_ACK, cmd.context_from, 0,
+                                cmd.stamp);
+    this->__describe(ack->body);
+    this->__send(ack);
+  }
+
+  void __cmdProbeAck(const Command &cmd) {
+    if (!this->__round.active ||
+        Generation(cmd.stamp, this->__id) != this->__gen ||
+        this->__round.awaiting.erase(cmd.context_from) == 0) {
+      return;
+    }
+
+    this->__tally(cmd.context_from, cmd.body);
+    if (this->__round.awaiting.empty()) {
+      this->__concludeRound();
+    }
+  }
+
+  void __cmdResolve(const Command &cmd) {
+    if (Generation(cmd.stamp, cmd.context_from) != this->__gen) {
+      // 지난 라운드의 결과. 지금 라운드가 다시 정함.
+      return;
+    }
+    this->__resolve(this->__keyState(cmd.key), cmd.op_code, cmd.key);
+  }
+
+public:
+  TokenEngine(Host &host, const ContextID id) : LockEngine(host, id) {}
+
+  void peerJoined(const ContextID id) {
+    LockEngine::peerJoined(id);
+
+    if (this->__round.active) {
+      // 라운드를 시작한 뒤 토큰을 받았을 수 있음.
+      if (this->__round.awaiting.insert(id).second) {
+        this->__probe(id, 0);
+      }
+    } else if (::nodeOf(id) != ::nodeOf(this->__id) && this->__isCoordinator()) {
+      // 따로 돌던 노드끼리 이어지면 키마다 토큰이 둘일 수 있음.
+      this->__startRound(0);
+    }
+  }
+
+  void peerLeft(const ContextID id) {
+    if (!this->__isMember(id)) {
+      return;
+    }
+    LockEngine::peerLeft(id);
+
+    for (auto &p : this->__keys) {
+      auto &ks = p.second;
+
+      ks.requested.erase(id);
+      if (ks.hasToken) {
+        const auto it = __findServed(ks.token, id);
+
+        if (it != ks.token.served.end() && it->first == id) {
+          ks.token.served.erase(it);
+        }
+        ks.token.queue.erase(
+            std::remove(ks.token.queue.begin(), ks.token.queue.end(), id),
+            ks.token.queue.end());
+      }
+    }
+
+    // 사라진 피어가 토큰을 가지고 있었거나 토큰이 그 피어에게 가는 중이었을 수 있음.
+    if (this->__isCoordinator()) {
+      this->__startRound(id);
+    }
+  }
+
+  void handle(const Command &cmd) {
+    switch (cmd.op_code) {
+    case OPC_TOKEN_REQUEST:
+      this->__cmdRequest(cmd);
+      break;
+    case OPC_TOKEN:
+      this->__cmdToken(cmd);
+      break;
+    case OPC_TOKEN_PROBE:
+      this->__cmdProbe(cmd);
+      break;
+    case OPC_TOKEN_PROBE_ACK:
+      this->__cmdProbeAck(cmd);
+      break;
+    case OPC_TOKEN_KEEP:
+    case OPC_TOKEN_DROP:
+      this->__cmdResolve(cmd);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // 공유 모드를 따로 다루지 않으므로 언제나 배타로 얻음.
+  bool acquire(const LockKey key, const LockMode) {
+    auto &ks = this->__keyState(key);
+    uint32_t n;
+
+    if (ks.state != KeyState::IDLE) {
+      return false;
+    }
+
+    if (ks.hasToken && !ks.frozen) {
+      // 아무도 달라고 하지 않아 가지고 있던 토큰.
+      ks.state = KeyState::HELD;
+      this->__host.engineAcquired(key);
+      return true;
+    }
+
+    ks.state = KeyState::WAITING;
+    n = ks.requested[this->__id] += 1;
+    for (const auto &other : this->__others) {
+      this->__send(this->__makeMyCommand(OPC_TOKEN_REQUEST, other, key, n));
+    }
+
+    if (this->__gen == Generation() && !this->__round.active &&
+        this->__isCoordinator()) {
+      // 아직 토큰이 없음. 대표가 처음 락을 얻으려 할 때 라운드를 돌려 만듦.
+      this->__startRound(0);
+    }
+
+    return true;
+  }
+
+  void release(const LockKey key) {
+    auto &ks = this->__keyState(key);
+
+    if (ks.state == KeyState::IDLE) {
+      return;
+    }
+
+    if (ks.hasToken) {
+      __setServed(ks.token, this->__id, ks.requested[this->__id]);
+    }
+    // 기다리던 중이었다면 요청은 남아 있고, 나중에 토큰을 받으면 넘김.
+    ks.state = KeyState::IDLE;
+    this->__serve(ks, key);
+  }
+};
+
+#endif /* end of include guard: TOKENENGINE_H_ */
@@ -0,0 +1,204 @@
+#include "Tracer.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+thread_local std::shared_ptr<Tracer::__Ring> Tracer::__local;
+std::atomic<uint64_t> Tracer::__generations(0);
+
+// 파일을 이만큼씩 늘려 다시 매핑함.
+static const size_t __GROW_BYTES__ = 16 << 20;
+
+Tracer::Tracer () :
+  __gen(__generations.fetch_add(1) + 1), __written(0), __closedDropped(0) {}
+
+Tracer::~Tracer () {
+  this->close();
+}
+
+void Tracer::close () {
+  TraceHeader header;
+
+  if (this->__th.joinable()) {
+    {
+      std::lock_guard<std::mutex> lg(this->__mtx);
+
+      this->__stopFlag = true;
+    }
+    this->__cv.notify_one();
+    this->__th.join();
+  }
+  if (this->__map == nullptr) {
+    return;
+  }
+
+  // 남은 기록은 모두 멈춘 스레드가 남긴 것.
+  this->__drain();
+
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+  header.version = TRACE_VERSION;
+  header.recordSize = sizeof(TraceRecord);
+  header.records = this->__written.load();
+  header.dropped = this->dropped();
+  std::memcpy(this->__map, &header, sizeof(header));
+
+  ::munmap(this->__map, this->__mapSize);
+  this->__map = nullptr;
+  this->__mapSize = 0;
+  if (::ftruncate(this->__fd, sizeof(TraceHeader) +
+                              header.records * sizeof(TraceRecord)) != 0) {
+    // 뒤에 빈 곳이 남을 뿐, 머리에 기록 수가 있으므로 읽을 수 있음.
+  }
+  ::close(this->__fd);
+  this->__fd = -1;
+}
+
+bool Tracer::open (const std::string &path) {
+  if (this->__fd >= 0) {
+    return false;
+  }
+
+  this->__fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (this->__fd < 0) {
+    return false;
+  }
+  if (!this->__reserve(sizeof(TraceHeader))) {
+    ::close(this->__fd);
+    this->__fd = -1;
+    return false;
+  }
+
+  this->__th = std::thread([this]() { this->__loop(); });
+  return true;
+}
+
+uint64_t Tracer::written () {
+  return this->__written.load();
+}
+
+uint64_t Tracer::dropped () {
+  std::lock_guard<std::mutex> lg(this->__mtx);
+  uint64_t ret = this->__closedDropped.load();
+
+  for (const auto &ring : this->__rings) {
+    ret += ring->dropped.load(std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+Tracer::__Ring *Tracer::__attach () {
+  std::lock_guard<std::mutex> lg(this->__mtx);
+
+  __local = std::make_shared<__Ring>(this->__gen);
+  this->__rings.push_back(__local);
+  return __local.get();
+}
+
+void Tracer::__loop () {
+  std::unique_lock<std::mutex> ul(this->__mtx);
+
+  while (!this->__stopFlag) {
+    size_t n;
+
+    ul.unlock();
+    n = this->__drain();
+    ul.lock();
+    // 옮길 것이 있었으면 바로 다시 봄.
+    if (n == 0 && !this->__stopFlag) {
+      this->__cv.wait_for(ul, std::chrono::milliseconds(1));
+    }
+  }
+}
+
+size_t Tracer::__drain () {
+  std::vector<std::shared_ptr<__Ring>> rings;
+  size_t ret = 0;
+
+  {
+    std::lock_guard<std::mutex> lg(this->__mtx);
+
+    rings = this->__rings;
+  }
+
+  for (const auto &ring : rings) {
+    const auto tail = ring->tail.load(std::memory_order_relaxed);
+    const auto head = ring->head.load(std::memory_order_acquire);
+    const auto n = (size_t)(head - tail);
+    const auto used = sizeof(TraceHeader) + this->__written.load() * sizeof(TraceRecord);
+    size_t first;
+
+    if (n == 0) {
+      continue;
+    }
+    if (!this->__reserve(used + n * sizeof(TraceRecord))) {
+      // 파일을 늘릴 수 없음. 기록은 버린 것으로 셈.
+      ring->tail.store(head, std::memory_order_release);
+      this->__closedDropped.fetch_add(n);
+      continue;
+    }
+
+    // 링 끝에서 잘리면 두 번에 나눠 옮김.
+    first = std::min(n, __Ring::SIZE - (size_t)(tail & (__Ring::SIZE - 1)));
+    std::memcpy(this->__map + used, &ring->buf[tail & (__Ring::SIZE - 1)],
+                first * sizeof(TraceRecord));
+    std::memcpy(this->__map + used + first * sizeof(TraceRecord), &ring->buf[0],
+                (n - first) * sizeof(TraceRecord));
+    ring->tail.store(head, std::memory_order_release);
+    this->__written.fetch_add(n);
+    ret += n;
+  }
+
+  // 스레드가 끝난 링은 비운 뒤 버림.
+  rings.clear();
+  {
+    std::lock_guard<std::mutex> lg(this->__mtx);
+    auto it = this->__rings.begin();
+
+    while (it != this->__rings.end()) {
+      const auto &ring = *it;
+
+      if (ring.use_count() == 1 &&
+          ring->head.load(std::memory_order_acquire) ==
+            ring->tail.load(std::memory_order_relaxed)) {
+        this->__closedDropped.fetch_add(ring->dropped.load(std::memory_order_relaxed));
+        it = this->__rings.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  return ret;
+}
+
+bool Tracer::__reserve (const size_t bytes) {
+  size_t size;
+  void *map;
+
+  if (bytes <= this->__mapSize) {
+    return true;
+  }
+
+  size = this->__mapSize;
+  while (size < bytes) {
+    size += __GROW_BYTES__;
+  }
+  if (::ftruncate(this->__fd, size) != 0) {
+    return false;
+  }
+  map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, this->__fd, 0);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  if (this->__map != nullptr) {
+    ::munmap(this->__map, this->__mapSize);
+  }
+  this->__map = (char*)map;
+  this->__mapSize = size;
+  return true;
+}
@@ -0,0 +1,160 @@
+#ifndef TRACER_H_
+#define TRACER_H_
+#include "Globals.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 기록의 종류.
+enum TraceType {
+  // 명령을 보냄. `peer`는 받는 피어(방송이면 0), `arg`는 `stamp`.
+  TRACE_SEND,
+  // 명령을 받음. `peer`는 보낸 피어, `arg`는 `stamp`.
+  TRACE_RECV,
+  // 엔진에 락을 얻으려 함. `arg`는 `LockMode`.
+  TRACE_REQUEST,
+  // 엔진에서 락을 얻음.
+  TRACE_ACQUIRED,
+  // 엔진에서 얻은 락을 놓음.
+  TRACE_RELEASED,
+  // 엔진에 낸 요청을 얻기 전에 포기함.
+  TRACE_ABANDONED,
+  // 락 API 요청의 기한이 지남.
+  TRACE_TIMEOUT,
+  // 타이머가 만료됨. `arg`는 이번 차례에 발생한 수.
+  TRACE_TIMERS,
+  // 경쟁 상태 같은 이상을 보고함. `arg`는 보고한 소스의 줄 번호.
+  TRACE_REPORT
+};
+
+// 파일에 그대로 쓰는 기록 하나.
+struct TraceRecord {
+  // `steady_clock` 기준 시각(ns). 시뮬레이션 중에는 가상 시계.
+  uint64_t ns;
+  ContextID ctx;
+  ContextID peer;
+  LockKey key;
+  uint32_t arg;
+  uint8_t type;
+  // 명령이면 `OPCode`.
+  uint8_t op;
+  uint8_t reserved[6];
+};
+
+// 파일 머리. 기록들이 바로 뒤따른다.
+struct TraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+  uint64_t records;
+  // 링이 차서 버린 기록 수.
+  uint64_t dropped;
+  uint8_t reserved[32];
+};
+
+static const char TRACE_MAGIC[8] = {'M', 'P', 'L', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t TRACE_VERSION = 1;
+
+// 이진 이벤트 기록기. 기록하는 스레드마다 고정 크기 기록을 담는 단일 생산자/단일
+// 소비자 링을 두므로, 기록하는 쪽은 잠그지도 시스템 콜을 부르지도 않는다. 뒤에서
+// 도는 스레드가 링들을 비워 메모리에 매핑한 파일에 이어 쓴다. 링이 차 있으면 그
+// 기록은 버리고 센다. 파일은 `poc-multiphase_lock-trace`로 풀어 본다.
+class Tracer {
+protected:
+  struct __Ring {
+    static const size_t SIZE = 1 << 16;
+
+    TraceRecord buf[SIZE];
+    // 이 링을 만든 기록기의 세대. 다른 기록기가 만든 링은 쓰지 않음.
+    uint64_t gen;
+    // 생산자만 씀.
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> dropped;
+    char __pad[64];
+    // 소비자만 씀.
+    std::atomic<uint64_t> tail;
+
+    __Ring (const uint64_t g) : gen(g), head(0), dropped(0), tail(0) {}
+  };
+
+  // 이 스레드의 링. 스레드가 끝나면 `__rings`에만 남으므로 비운 뒤 버림.
+  static thread_local std::shared_ptr<__Ring> __local;
+  static std::atomic<uint64_t> __generations;
+
+  const uint64_t __gen;
+  int __fd = -1;
+  char *__map = nullptr;
+  size_t __mapSize = 0;
+  // 이하 뒤에서 도는 스레드만 씀.
+  std::atomic<uint64_t> __written;
+  // 비우고 버린 링에서 버린 기록 수.
+  std::atomic<uint64_t> __closedDropped;
+  // 이하 `__mtx`로 보호.
+  std::mutex __mtx;
+  std::condition_variable __cv;
+  std::vector<std::shared_ptr<__Ring>> __rings;
+  bool __stopFlag = false;
+  std::thread __th;
+
+  __Ring *__attach ();
+  void __loop ();
+  // 모든 링을 비움. 옮긴 기록 수.
+  size_t __drain ();
+  bool __reserve (const size_t bytes);
+
+public:
+  Tracer ();
+  // `close()`.
+  ~Tracer ();
+
+  Tracer (const Tracer&) = delete;
+  Tracer &operator= (const Tracer&) = delete;
+
+  // `path`를 새로 만들어 기록하기 시작함. 실패하면 `errno`를 남기고 거짓.
+  bool open (const std::string &path);
+  // 남은 기록을 모두 쓰고 파일을 닫음. 기록하는 스레드가 없을 때 부를 것.
+  void close ();
+
+  void record (const TraceType type, const ContextID ctx,
+               const std::chrono::steady_clock::time_point &at,
+               const ContextID peer, const LockKey key, const uint8_t op,
+               const uint32_t arg) {
+    auto ring = __local.get();
+    uint64_t head;
+
+    if (ring == nullptr || ring->gen != this->__gen) {
+      ring = this->__attach();
+    }
+
+    head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= __Ring::SIZE) {
+      ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+      return;
+    }
+
+    auto &r = ring->buf[head & (__Ring::SIZE - 1)];
+
+    r.ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      at.time_since_epoch()).count();
+    r.ctx = ctx;
+    r.peer = peer;
+    r.key = key;
+    r.arg = arg;
+    r.type = (uint8_t)type;
+    r.op = op;
+    ring->head.store(head + 1, std::memory_order_release);
+  }
+
+  // 파일에 쓴 기록 수와 버린 기록 수. `close()` 뒤에 정확함.
+  uint64_t written ();
+  uint64_t dropped ();
+};
+
+#endif /* end of include guard: TRACER_H_ */
@@ -0,0 +1,896 @@
+#include "Transport.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+// 프레임(네트워크 바이트 순서):
+//   u8 op, u8 version, u16 words, u32 from, u32 to, u32 key, u32 stamp,
+//   u32 body[words]
+// HELLO 프레임은 op가 `__OP_HELLO`이고 from이 노드 ID, to가 `__MAGIC`.
+// 피어가 생겼다는 프레임은 body가 있으면 body의 피어들이 생긴 것.
+static const size_t __FRAME_SIZE = 20;
+static const uint8_t __OP_HELLO = 0xFF;
+static const uint8_t __VERSION = 4;
+static const size_t __MAX_WORDS = 65535;
+static const uint32_t __MAGIC = 0x4D504C4B; // "MPLK"
+static const size_t __READ_SIZE = 16384;
+static const auto __REDIAL_INTERVAL = std::chrono::milliseconds(500);
+
+static size_t __frameSize (const std::vector<uint32_t> *body) {
+  return __FRAME_SIZE + (body == nullptr ? 0 : body->size() * sizeof(uint32_t));
+}
+
+static void __writeFrame (char *p, const uint8_t op, const uint32_t from,
+                          const uint32_t to, const uint32_t key,
+                          const uint32_t stamp,
+                          const std::vector<uint32_t> *body = nullptr) {
+  const uint32_t words[4] = {htonl(from), htonl(to), htonl(key), htonl(stamp)};
+  const uint16_t n = htons(body == nullptr ? 0 : (uint16_t)body->size());
+
+  p[0] = (char)op;
+  p[1] = (char)__VERSION;
+  std::memcpy(p + 2, &n, sizeof(n));
+  std::memcpy(p + 4, words, sizeof(words));
+  if (body != nullptr) {
+    for (size_t i = 0; i < body->size(); i += 1) {
+      const uint32_t w = htonl((*body)[i]);
+
+      std::memcpy(p + __FRAME_SIZE + i * sizeof(w), &w, sizeof(w));
+    }
+  }
+}
+
+static void __putFrame (std::vector<char> &buf, const uint8_t op,
+                        const uint32_t from, const uint32_t to, const uint32_t key,
+                        const uint32_t stamp = 0,
+                        const std::vector<uint32_t> *body = nullptr) {
+  const size_t off = buf.size();
+
+  buf.resize(off + __frameSize(body));
+  __writeFrame(&buf[off], op, from, to, key, stamp, body);
+}
+
+// `ids`를 프레임 본문 크기만큼씩 나눠 `func(from, body)`를 부름. 하나면 본문 없이.
+template <class F>
+static void __forEachSpawnedFrame (const std::vector<ContextID> &ids, F func) {
+  std::vector<uint32_t> body;
+
+  if (ids.size() == 1) {
+    func(ids.front(), nullptr);
+    return;
+  }
+  for (size_t i = 0; i < ids.size(); i += __MAX_WORDS) {
+    body.assign(ids.begin() + i,
+                ids.begin() + i + std::min(ids.size() - i, __MAX_WORDS));
+    func(body.front(), &body);
+  }
+}
+
+static uint32_t __getWord (const char *p) {
+  uint32_t ret;
+
+  std::memcpy(&ret, p, sizeof(ret));
+  return ntohl(ret);
+}
+
+static void __report (const std::string &msg) {
+  std::lock_guard<std::mutex> lg(::stdioLock);
+  std::cerr << msg << std::endl;
+}
+
+static int64_t __nowTicks () {
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+bool Transport::parseAddress (const std::string &addr, sockaddr_storage &sa, socklen_t &len) {
+  std::memset(&sa, 0, sizeof(sa));
+
+  if (addr.compare(0, 5, "unix:") == 0) {
+    const auto path = addr.substr(5);
+    auto un = (sockaddr_un*)&sa;
+
+    if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+      return false;
+    }
+    un->sun_family = AF_UNIX;
+    std::memcpy(un->sun_path, path.c_str(), path.size() + 1);
+    len = (socklen_t)sizeof(sockaddr_un);
+
+    return true;
+  }
+  if (addr.compare(0, 4, "tcp:") == 0) {
+    const auto pos = addr.rfind(':');
+    std::string host = addr.substr(4, pos - 4);
+    const auto port = addr.substr(pos + 1);
+    addrinfo hints, *res;
+
+    if (pos < 4 || port.empty()) {
+      return false;
+    }
+    // "[::1]" 꼴의 IPv6 주소.
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+      host = host.substr(1, host.size() - 2);
+    }
+
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | (host.empty() ? AI_PASSIVE : 0);
+    if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res) != 0) {
+      return false;
+    }
+    std::memcpy(&sa, res->ai_addr, res->ai_addrlen);
+    len = res->ai_addrlen;
+    ::freeaddrinfo(res);
+
+    return true;
+  }
+
+  return false;
+}
+
+Transport::Transport () : __stopFlag(false) {
+  for (auto &n : this->__nodes) {
+    n.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+Transport::~Transport () {
+  this->stop();
+
+  for (auto &n : this->__nodes) {
+    delete n.load(std::memory_order_relaxed);
+  }
+  for (auto d : this->__dials) {
+    delete d;
+  }
+}
+
+bool Transport::listen (const std::string &addr) {
+  sockaddr_storage sa;
+  socklen_t len;
+  int fd, one = 1;
+
+  if (this->__listenFd >= 0 || !Transport::parseAddress(addr, sa, len)) {
+    errno = EINVAL;
+    return false;
+  }
+
+  fd = ::socket(sa.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  if (sa.ss_family == AF_UNIX) {
+    this->__unixPath = ((sockaddr_un*)&sa)->sun_path;
+    ::unlink(this->__unixPath.c_str());
+  }
+  else {
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  }
+
+  if (::bind(fd, (sockaddr*)&sa, len) != 0 || ::listen(fd, 64) != 0) {
+    const auto e = errno;
+
+    ::close(fd);
+    this->__unixPath.clear();
+    errno = e;
+    return false;
+  }
+  this->__listenFd = fd;
+
+  return true;
+}
+
+bool Transport::connect (const std::string &addr) {
+  sockaddr_storage sa;
+  socklen_t len;
+  __Dial *dial;
+
+  if (!Transport::parseAddress(addr, sa, len)) {
+    return false;
+  }
+
+  dial = new __Dial;
+  dial->addr = addr;
+  this->__dials.push_back(dial);
+
+  return true;
+}
+
+bool Transport::start () {
+  epoll_event ev;
+
+  if (this->__th.joinable()) {
+    throw std::exception();
+  }
+
+  // 끊긴 연결에 쓰면 프로세스가 죽지 않고 `EPIPE`로 실패하도록.
+  ::signal(SIGPIPE, SIG_IGN);
+
+  this->__epfd = ::epoll_create1(EPOLL_CLOEXEC);
+  this->__evfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (this->__epfd < 0 || this->__evfd < 0) {
+    return false;
+  }
+
+  // 이벤트의 `data.ptr`: eventfd는 `nullptr`, 듣는 소켓은 `this`, 그 외에는 `__Link*`.
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;
+  ::epoll_ctl(this->__epfd, EPOLL_CTL_ADD, this->__evfd, &ev);
+  if (this->__listenFd >= 0) {
+    ev.events = EPOLLIN;
+    ev.data.ptr = this;
+    ::epoll_ctl(this->__epfd, EPOLL_CTL_ADD, this->__listenFd, &ev);
+  }
+
+  this->__stopFlag = false;
+  this->__th = std::thread([this]() { this->__run(); });
+
+  return true;
+}
+
+void Transport::stop () {
+  if (this->__th.joinable()) {
+    const uint64_t one = 1;
+
+    this->__stopFlag = true;
+    if (::write(this->__evfd, &one, sizeof(one)) < 0) {
+      // 이미 깨울 값이 쌓여 있음.
+    }
+    this->__th.join();
+  }
+
+  if (this->__listenFd >= 0) {
+    ::close(this->__listenFd);
+    this->__listenFd = -1;
+    if (!this->__unixPath.empty()) {
+      ::unlink(this->__unixPath.c_str());
+    }
+  }
+  if (this->__evfd >= 0) {
+    ::close(this->__evfd);
+    this->__evfd = -1;
+  }
+  if (this->__epfd >= 0) {
+    ::close(this->__epfd);
+    this->__epfd = -1;
+  }
+}
+
+void Transport::__markDirty (__Node *node) {
+  const uint64_t one = 1;
+  bool wake;
+
+  {
+    std::lock_guard<std::mutex> lg(this->__dirtyLock);
+
+    wake = this->__dirty.empty();
+    this->__dirty.push_back(node);
+  }
+
+  // 목록이 비어 있을 때만 깨움. 아니면 I/O 스레드가 이미 깨어날 예정.
+  if (wake && ::write(this->__evfd, &one, sizeof(one)) < 0) {
+    // 이미 깨울 값이 쌓여 있음.
+  }
+}
+
+void Transport::__enqueue (__Node *node, const OPCode op, const ContextID from,
+                           const ContextID to, const LockKey key,
+                           const uint32_t stamp,
+                           const std::vector<uint32_t> *body) {
+  bool mark = false;
+
+  {
+    std::lock_guard<std::mutex> lg(node->mtx);
+
+    if (!node->ready) {
+      return;
+    }
+    __putFrame(node->wbuf, (uint8_t)op, from, to, key, stamp, body);
+    node->txFrames.fetch_add(1, std::memory_order_relaxed);
+    if (!node->dirty) {
+      node->dirty = mark = true;
+    }
+  }
+
+  if (mark) {
+    this->__markDirty(node);
+  }
+}
+
+void Transport::announce (const std::vector<ContextID> &ids) {
+  __forEachSpawnedFrame(ids, [this](const ContextID from,
+                                    const std::vector<uint32_t> *body) {
+    for (auto &n : this->__nodes) {
+      const auto node = n.load(std::memory_order_acquire);
+
+      if (node != nullptr) {
+        this->__enqueue(node, OPC_THREAD_SPAWNED, from, 0, 0, 0, body);
+      }
+    }
+  });
+}
+
+void Transport::forward (const Command &cmd) {
+  if (cmd.context_to == 0) {
+    for (auto &n : this->__nodes) {
+      const auto node = n.load(std::memory_order_acquire);
+
+      if (node != nullptr) {
+        this->__enqueue(node, cmd.op_code, cmd.context_from, 0, cmd.key, cmd.stamp,
+                        &cmd.body);
+      }
+    }
+  }
+  else {
+    const auto node = this->__nodes[::nodeOf(cmd.context_to)].load(std::memory_order_acquire);
+
+    if (node != nullptr) {
+      this->__enqueue(node, cmd.op_code, cmd.context_from, cmd.context_to, cmd.key,
+                      cmd.stamp, &cmd.body);
+    }
+  }
+}
+
+void Transport::forwardChain (const ContextID to, Envelope *newest, Envelope *oldest) {
+  const auto node = this->__nodes[::nodeOf(to)].load(std::memory_order_acquire);
+  Envelope *env;
+  size_t n, i;
+  bool mark = false;
+
+  if (node == nullptr) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lg(node->mtx);
+
+    if (!node->ready) {
+      return;
+    }
+
+    // 목록은 최근 것부터 연결되어 있으므로 뒤에서부터 채움.
+    n = 1;
+    i = node->wbuf.size() + __frameSize(&oldest->cmd->body);
+    for (env = newest; env != oldest; env = env->next) {
+      n += 1;
+      i += __frameSize(&env->cmd->body);
+    }
+    node->wbuf.resize(i);
+    for (env = newest; ; env = env->next) {
+      i -= __frameSize(&env->cmd->body);
+      __writeFrame(&node->wbuf[i], (uint8_t)env->cmd->op_code, env->cmd->context_from,
+                   env->cmd->context_to, env->cmd->key, env->cmd->stamp,
+                   &env->cmd->body);
+      if (env == oldest) {
+        break;
+      }
+    }
+    node->txFrames.fetch_add(n, std::memory_order_relaxed);
+
+    if (!node->dirty) {
+      node->dirty = mark = true;
+    }
+  }
+
+  if (mark) {
+    this->__markDirty(node);
+  }
+}
+
+std::vector<Transport::Stats> Transport::stats () {
+  std::vector<Stats> ret;
+  const auto now = __nowTicks();
+
+  for (auto &n : this->__nodes) {
+    const auto node = n.load(std::memory_order_acquire);
+    Stats s;
+
+    if (node == nullptr) {
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lg(node->mtx);
+      s.connected = node->ready;
+    }
+    s.node = node->id;
+    s.seconds = std::chrono::duration_cast<std::chrono::duration<double>>(
+      std::chrono::steady_clock::duration(now - node->connectedAt.load(std::memory_order_relaxed))).count();
+    s.txFrames = node->txFrames.load(std::memory_order_relaxed);
+    s.rxFrames = node->rxFrames.load(std::memory_order_relaxed);
+    s.writes = node->writes.load(std::memory_order_relaxed);
+    ret.push_back(s);
+  }
+
+  return ret;
+}
+
+void Transport::__watch (__Link *link, const int op) {
+  epoll_event ev;
+
+  ev.events = EPOLLIN | (link->wantOut || link->connecting ? (uint32_t)EPOLLOUT : 0u);
+  ev.data.ptr = link;
+  ::epoll_ctl(this->__epfd, op, link->fd, &ev);
+}
+
+void Transport::__run () {
+  epoll_event evs[64];
+  int i, n;
+
+  while (!this->__stopFlag.load()) {
+    const auto now = std::chrono::steady_clock::now();
+
+    for (auto dial : this->__dials) {
+      if (dial->link == nullptr && now >= dial->nextTry) {
+        this->__dial(dial);
+      }
+    }
+
+    n = ::epoll_wait(this->__epfd, evs, 64, 100);
+    for (i = 0; i < n; i += 1) {
+      const auto ptr = evs[i].data.ptr;
+
+      if (ptr == nullptr) {
+        uint64_t v;
+
+        if (::read(this->__evfd, &v, sizeof(v)) < 0) {
+          // 이미 다른 깨움에서 읽음.
+        }
+        this->__flushDirty();
+      }
+      else if (ptr == this) {
+        this->__accept();
+      }
+      else {
+        const auto link = (__Link*)ptr;
+
+        if (link->fd < 0) {
+          // 이번 묶음 안에서 닫힘.
+          continue;
+        }
+
+        if (link->connecting) {
+          int err = 0;
+          socklen_t len = sizeof(err);
+
+          ::getsockopt(link->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+          if (err != 0) {
+            this->__close(link);
+          }
+          else {
+            link->connecting = false;
+            this->__watch(link, EPOLL_CTL_MOD);
+            this->__onConnected(link);
+          }
+          continue;
+        }
+
+        if ((evs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !this->__read(link)) {
+          this->__close(link);
+          continue;
+        }
+        if ((evs[i].events & EPOLLOUT) && !this->__flush(link)) {
+          this->__close(link);
+        }
+      }
+    }
+
+    for (auto link : this->__dead) {
+      delete link;
+    }
+    this->__dead.clear();
+  }
+
+  // 남은 프레임을 한 번 내보내 보고 닫음.
+  this->__flushDirty();
+  while (!this->__links.empty()) {
+    this->__close(this->__links.back());
+  }
+  for (auto link : this->__dead) {
+    delete link;
+  }
+  this->__dead.clear();
+}
+
+void Transport::__accept () {
+  int fd, one = 1;
+
+  while ((fd = ::accept4(this->__listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    auto link = new __Link;
+
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    link->fd = fd;
+    this->__links.push_back(link);
+    this->__watch(link, EPOLL_CTL_ADD);
+    this->__onConnected(link);
+  }
+}
+
+void Transport::__dial (__Dial *dial) {
+  sockaddr_storage sa;
+  socklen_t len;
+  __Link *link;
+  int fd, one = 1;
+
+  dial->nextTry = std::chrono::steady_clock::now() + __REDIAL_INTERVAL;
+
+  // 상대가 건 연결로 이미 이어져 있음.
+  if (dial->node != UINT32_MAX) {
+    const auto node = this->__nodes[dial->node].load(std::memory_order_relaxed);
+
+    if (node != nullptr && node->link != nullptr) {
+      return;
+    }
+  }
+
+  if (!Transport::parseAddress(dial->addr, sa, len)) {
+    return;
+  }
+  fd = ::socket(sa.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return;
+  }
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  link = new __Link;
+  link->fd = fd;
+  link->dial = dial;
+  dial->link = link;
+  this->__links.push_back(link);
+
+  if (::connect(fd, (sockaddr*)&sa, len) == 0) {
+    this->__watch(link, EPOLL_CTL_ADD);
+    this->__onConnected(link);
+  }
+  else if (errno == EINPROGRESS) {
+    link->connecting = true;
+    this->__watch(link, EPOLL_CTL_ADD);
+  }
+  else {
+    this->__watch(link, EPOLL_CTL_ADD);
+    this->__close(link);
+  }
+}
+
+void Transport::__onConnected (__Link *link) {
+  __putFrame(link->sending, __OP_HELLO, ::nodeID, __MAGIC, 0);
+  if (!this->__flush(link)) {
+    this->__close(link);
+  }
+}
+
+bool Transport::__read (__Link *link) {
+  size_t have, off, len;
+  ssize_t r;
+
+  for (;;) {
+    have = link->rbuf.size();
+    link->rbuf.resize(have + __READ_SIZE);
+    r = ::read(link->fd, &link->rbuf[have], __READ_SIZE);
+    if (r <= 0) {
+      link->rbuf.resize(have);
+      if (r < 0 && errno == EINTR) {
+        continue;
+      }
+      if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        break;
+      }
+      // 끊김.
+      this->__flushChain(link);
+      return false;
+    }
+    link->rbuf.resize(have + (size_t)r);
+
+    for (off = 0; off + __FRAME_SIZE <= link->rbuf.size(); off += len) {
+      uint16_t words;
+
+      std::memcpy(&words, &link->rbuf[off + 2], sizeof(words));
+      len = __FRAME_SIZE + ntohs(words) * sizeof(uint32_t);
+      if (off + len > link->rbuf.size()) {
+        // 본문이 아직 다 오지 않음.
+        break;
+      }
+      if (!this->__onFrame(link, &link->rbuf[off])) {
+        this->__flushChain(link);
+        return false;
+      }
+    }
+    link->rbuf.erase(link->rbuf.begin(), link->rbuf.begin() + off);
+  }
+
+  this->__flushChain(link);
+  return true;
+}
+
+bool Transport::__onFrame (__Link *link, const char *p) {
+  const auto op = (uint8_t)p[0];
+  const auto from = __getWord(p + 4);
+  const auto to = __getWord(p + 8);
+  const auto key = __getWord(p + 12);
+  const auto stamp = __getWord(p + 16);
+  uint16_t words;
+
+  std::memcpy(&words, p + 2, sizeof(words));
+  words = ntohs(words);
+
+  if ((uint8_t)p[1] != __VERSION) {
+    return false;
+  }
+
+  if (link->node == nullptr) {
+    if (op != __OP_HELLO || to != __MAGIC) {
+      return false;
+    }
+    return this->__bind(link, from);
+  }
+
+  link->node->rxFrames.fetch_add(1, std::memory_order_relaxed);
+
+  // 보낸 피어는 반드시 그 노드의 것이어야 함.
+  if (::nodeOf(from) != link->node->id) {
+    return false;
+  }
+
+  switch (op) {
+  case OPC_THREAD_SPAWNED: {
+    std::vector<ContextID> ids;
+    uint16_t i;
+
+    this->__flushChain(link);
+    if (words == 0) {
+      ::addRemoteContext(from);
+      return true;
+    }
+    ids.reserve(words);
+    for (i = 0; i < words; i += 1) {
+      ids.push_back(__getWord(p + __FRAME_SIZE + i * sizeof(uint32_t)));
+      if (::nodeOf(ids.back()) != link->node->id) {
+        return false;
+      }
+    }
+    ::addRemoteContexts(ids);
+    return true;
+  }
+  case OPC_THREAD_DESPAWNED:
+    this->__flushChain(link);
+    ::removeRemoteContext(from);
+    return true;
+  case OPC_MY_LOCK:
+  case OPC_YOUR_LOCK:
+  case OPC_LOCK_RESET:
+  case OPC_LOCK_WAITING:
+  case OPC_LOCK_HANDOFF:
+  case OPC_LOCK_PASSED:
+  case OPC_QUORUM_REQUEST:
+  case OPC_QUORUM_GRANT:
+  case OPC_QUORUM_FAILED:
+  case OPC_QUORUM_INQUIRE:
+  case OPC_QUORUM_RELINQUISH:
+  case OPC_QUORUM_RELEASE:
+  case OPC_TOKEN_REQUEST:
+  case OPC_TOKEN:
+  case OPC_TOKEN_PROBE:
+  case OPC_TOKEN_PROBE_ACK:
+  case OPC_TOKEN_KEEP:
+  case OPC_TOKEN_DROP: {
+    Envelope *env;
+    uint16_t i;
+
+    if (to == 0 || ::nodeOf(to) != ::nodeID) {
+      return false;
+    }
+    if (link->chainTo != to) {
+      this->__flushChain(link);
+      link->chainTo = to;
+    }
+
+    env = Pool<Envelope>::alloc();
+    env->cmd = Command::make((OPCode)op, from, to, key, stamp);
+    for (i = 0; i < words; i += 1) {
+      env->cmd->body.push_back(__getWord(p + __FRAME_SIZE + i * sizeof(uint32_t)));
+    }
+    env->next = link->chainNewest;
+    if (link->chainOldest == nullptr) {
+      link->chainOldest = env;
+    }
+    link->chainNewest = env;
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+void Transport::__flushChain (__Link *link) {
+  if (link->chainNewest != nullptr) {
+    ::sendCommandChain(link->chainTo, link->chainNewest, link->chainOldest);
+  }
+  link->chainTo = 0;
+  link->chainNewest = link->chainOldest = nullptr;
+}
+
+bool Transport::__bind (__Link *link, const uint32_t id) {
+  __Node *node;
+
+  if (id == ::nodeID || id > MAX_NODE_ID) {
+    return false;
+  }
+
+  node = this->__nodes[id].load(std::memory_order_relaxed);
+  if (node == nullptr) {
+    node = new __Node(id);
+    this->__nodes[id].store(node, std::memory_order_release);
+  }
+
+  if (node->link != nullptr) {
+    // 양쪽이 동시에 연결을 걸었음. 노드 ID가 작은 쪽이 건 연결을 남긴다. 양쪽 모두
+    // 같은 결정을 내리므로 하나만 남는다.
+    const auto oldDialer = node->link->dial != nullptr ? ::nodeID : id;
+    const auto newDialer = link->dial != nullptr ? ::nodeID : id;
+
+    if (oldDialer <= newDialer) {
+      return false;
+    }
+    this->__close(node->link);
+  }
+
+  if (link->dial != nullptr) {
+    link->dial->node = id;
+  }
+  node->link = link;
+  link->node = node;
+  node->txFrames = 0;
+  node->rxFrames = 0;
+  node->writes = 0;
+  node->connectedAt = __nowTicks();
+
+  {
+    // 지금 있는 피어들을 알림. 그 사이에 피어가 생기거나 사라지지 않도록
+    // `::globalLock`을 잡음. 이후 생기는 피어는 `announce()`로 알려짐.
+    std::lock_guard<std::mutex> glg(::globalLock);
+    std::lock_guard<std::mutex> lg(node->mtx);
+
+    node->wbuf.clear();
+    __forEachSpawnedFrame(::contextIDs(), [node](const ContextID from,
+                                                 const std::vector<uint32_t> *body) {
+      __putFrame(node->wbuf, OPC_THREAD_SPAWNED, from, 0, 0, 0, body);
+      node->txFrames.fetch_add(1, std::memory_order_relaxed);
+    });
+    node->ready = true;
+  }
+
+  __report("* Node " + std::to_string(id) + " connected.");
+
+  return this->__flush(link);
+}
+
+bool Transport::__flush (__Link *link) {
+  iovec iov[2];
+  size_t total, first;
+  ssize_t r;
+  bool wantOut;
+
+  if (link->node != nullptr) {
+    std::lock_guard<std::mutex> lg(link->node->mtx);
+
+    // 비어 있는 `spare`와 바꾸므로 버퍼의 용량은 양쪽을 오가며 재사용됨.
+    link->spare.swap(link->node->wbuf);
+    link->node->dirty = false;
+  }
+
+  first = link->sending.size() - link->sendOff;
+  total = first + link->spare.size();
+  if (total > 0) {
+    iov[0].iov_base = link->sending.data() + link->sendOff;
+    iov[0].iov_len = first;
+    iov[1].iov_base = link->spare.data();
+    iov[1].iov_len = link->spare.size();
+
+    do {
+      r = ::writev(link->fd, first > 0 ? iov : iov + 1, first > 0 ? 2 : 1);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return false;
+      }
+      r = 0;
+    }
+    else if (link->node != nullptr) {
+      link->node->writes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if ((size_t)r == total) {
+      link->sending.clear();
+      link->sendOff = 0;
+    }
+    else if ((size_t)r < first) {
+      link->sendOff += (size_t)r;
+      link->sending.insert(link->sending.end(), link->spare.begin(), link->spare.end());
+    }
+    else {
+      link->sending.assign(link->spare.begin() + ((size_t)r - first), link->spare.end());
+      link->sendOff = 0;
+    }
+    link->spare.clear();
+  }
+
+  wantOut = link->sendOff < link->sending.size();
+  if (wantOut != link->wantOut) {
+    link->wantOut = wantOut;
+    this->__watch(link, EPOLL_CTL_MOD);
+  }
+
+  return true;
+}
+
+void Transport::__flushDirty () {
+  std::vector<__Node*> dirty;
+
+  {
+    std::lock_guard<std::mutex> lg(this->__dirtyLock);
+    dirty.swap(this->__dirty);
+  }
+
+  for (auto node : dirty) {
+    if (node->link != nullptr) {
+      if (!this->__flush(node->link)) {
+        this->__close(node->link);
+      }
+    }
+    else {
+      std::lock_guard<std::mutex> lg(node->mtx);
+
+      node->wbuf.clear();
+      node->dirty = false;
+    }
+  }
+}
+
+void Transport::__close (__Link *link) {
+  const auto node = link->node;
+
+  if (link->fd < 0) {
+    return;
+  }
+
+  this->__flushChain(link);
+  ::epoll_ctl(this->__epfd, EPOLL_CTL_DEL, link->fd, nullptr);
+  ::close(link->fd);
+  link->fd = -1;
+
+  if (link->dial != nullptr) {
+    link->dial->link = nullptr;
+    link->dial->nextTry = std::chrono::steady_clock::now() + __REDIAL_INTERVAL;
+  }
+  this->__links.erase(std::find(this->__links.begin(), this->__links.end(), link));
+  this->__dead.push_back(link);
+
+  if (node != nullptr && node->link == link) {
+    {
+      std::lock_guard<std::mutex> lg(node->mtx);
+
+      node->ready = false;
+      node->wbuf.clear();
+      node->dirty = false;
+    }
+    node->link = nullptr;
+
+    ::removeRemoteNode(node->id);
+    __report("* Node " + std::to_string(node->id) + " disconnected.");
+  }
+}
@@ -0,0 +1,157 @@
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+#include "Globals.hpp"
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 다른 노드(프로세스)의 피어와 명령을 주고받는 전송 계층.
+// 노드 사이에는 TCP나 Unix 소켓 연결을 하나씩 두고, 명령은 20바이트 머리에 명령
+// 본문을 붙인 프레임으로 보낸다. 피어 스레드는 노드별 송신 버퍼에 프레임을 붙이기만
+// 하고, 실제 읽기와 쓰기는 epoll을 도는 I/O 스레드 하나가 한다. 쓰기는 그동안 쌓인
+// 프레임을 `writev()` 한 번으로 내보낸다.
+// 연결되면 서로 HELLO 프레임으로 노드 ID를 알린 뒤, 지금 있는 피어들을 SPAWNED
+// 프레임으로 알려 준다. 연결이 끊기면 그 노드의 피어가 모두 사라진 것으로 처리한다.
+// 주소 형식: "tcp:HOST:PORT" 또는 "unix:PATH".
+class Transport {
+public:
+  // 연결 하나의 통계. 수치는 지금 연결이 맺어진 뒤부터 셈.
+  struct Stats {
+    uint32_t node;
+    bool connected;
+    double seconds;
+    uint64_t txFrames;
+    uint64_t rxFrames;
+    uint64_t writes;
+  };
+
+protected:
+  struct __Link;
+
+  // 상대 노드 하나. 한 번 만들면 `Transport`가 없어질 때까지 지우지 않으므로 피어
+  // 스레드가 잠금 없이 찾아갈 수 있다.
+  struct __Node {
+    uint32_t id;
+    // 이하 `mtx`로 보호.
+    std::mutex mtx;
+    // 연결되어 처음 피어 목록을 보낸 뒤부터 참.
+    bool ready = false;
+    // 아직 I/O 스레드가 가져가지 않은 프레임들.
+    std::vector<char> wbuf;
+    // `__dirty` 목록에 올라가 있는지.
+    bool dirty = false;
+
+    // I/O 스레드만 접근.
+    __Link *link = nullptr;
+
+    std::atomic<uint64_t> txFrames;
+    std::atomic<uint64_t> rxFrames;
+    std::atomic<uint64_t> writes;
+    std::atomic<int64_t> connectedAt;
+
+    __Node (const uint32_t id) :
+      id(id), txFrames(0), rxFrames(0), writes(0), connectedAt(0) {}
+  };
+
+  // 이 노드가 연결을 거는 주소. 끊기면 다시 건다.
+  struct __Dial {
+    std::string addr;
+    __Link *link = nullptr;
+    // 이 주소의 노드. HELLO를 받기 전에는 `UINT32_MAX`.
+    uint32_t node = UINT32_MAX;
+    std::chrono::steady_clock::time_point nextTry;
+  };
+
+  // 소켓 하나. I/O 스레드만 접근.
+  struct __Link {
+    int fd = -1;
+    // 논블로킹 `connect()`가 끝나기를 기다리는 중.
+    bool connecting = false;
+    bool wantOut = false;
+    // 내가 건 연결이면 그 주소.
+    __Dial *dial = nullptr;
+    // HELLO를 받기 전에는 `nullptr`.
+    __Node *node = nullptr;
+    std::vector<char> rbuf;
+    // 보내다 만 프레임들과 `__Node::wbuf`에서 바꿔 온 프레임들.
+    std::vector<char> sending;
+    size_t sendOff = 0;
+    std::vector<char> spare;
+    // 받은 명령 중 같은 피어에게 가는 것을 모아 한 번에 넣음.
+    ContextID chainTo = 0;
+    Envelope *chainNewest = nullptr;
+    Envelope *chainOldest = nullptr;
+  };
+
+  int __epfd = -1;
+  int __evfd = -1;
+  int __listenFd = -1;
+  std::string __unixPath;
+  std::thread __th;
+  std::atomic<bool> __stopFlag;
+
+  std::atomic<__Node*> __nodes[MAX_NODE_ID + 1];
+  std::vector<__Dial*> __dials;
+  // I/O 스레드만 접근.
+  std::vector<__Link*> __links;
+  std::vector<__Link*> __dead;
+
+  // 보낼 프레임이 생긴 노드들.
+  std::mutex __dirtyLock;
+  std::vector<__Node*> __dirty;
+
+  void __enqueue (__Node *node, const OPCode op, const ContextID from,
+                  const ContextID to, const LockKey key, const uint32_t stamp,
+                  const std::vector<uint32_t> *body);
+  void __markDirty (__Node *node);
+
+  void __run ();
+  void __watch (__Link *link, const int op);
+  void __accept ();
+  void __dial (__Dial *dial);
+  void __onConnected (__Link *link);
+  bool __read (__Link *link);
+  bool __onFrame (__Link *link, const char *p);
+  bool __bind (__Link *link, const uint32_t node);
+  void __flushChain (__Link *link);
+  bool __flush (__Link *link);
+  void __flushDirty ();
+  void __close (__Link *link);
+
+public:
+  Transport ();
+  ~Transport ();
+
+  Transport (const Transport&) = delete;
+  Transport &operator= (const Transport&) = delete;
+
+  // `start()` 전에 부름. 실패하면 거짓(`errno` 참고).
+  bool listen (const std::string &addr);
+  // `start()` 전에 부름. 주소 형식이 틀리면 거짓.
+  bool connect (const std::string &addr);
+  bool start ();
+  // 쌓인 프레임을 내보내고 모든 연결을 닫음.
+  void stop ();
+
+  // 이 노드에 피어들이 생긴 것을 모든 노드에 알림. 프레임 하나에 여럿을 실음.
+  // `::globalLock`을 잡은 채 부름.
+  void announce (const std::vector<ContextID> &ids);
+  // `cmd`를 받을 노드(방송이면 모든 노드)에 보냄. 참조는 가져가지 않음.
+  void forward (const Command &cmd);
+  // 노드 `::nodeOf(to)`에게 명령 여러 개를 한 번에 보냄. `newest`에서 `oldest`까지
+  // `Envelope::next`로 최근 것부터 연결되어 있어야 함. 참조는 가져가지 않음.
+  void forwardChain (const ContextID to, Envelope *newest, Envelope *oldest);
+
+  std::vector<Stats> stats ();
+
+  // "tcp:HOST:PORT" 또는 "unix:PATH"를 소켓 주소로.
+  static bool parseAddress (const std::string &addr, sockaddr_storage &sa, socklen_t &len);
+};
+
+#endif /* end of include guard: TRANSPORT_H_ */
@@ -0,0 +1,82 @@
+#include "Bench.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// 동시에 기다리는 요청 수별로 락 API의 처리량과 지연 시간을 잼. 피어는 스스로 락을
+// 얻지 않고, 바깥 호출자의 요청만 처리함.
+int benchApi (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"lock-keys", required_argument, nullptr, 0},
+    {"inflight", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> inflight = {1, 4, 16, 64};
+  unsigned int nb_peers = 16;
+  double duration = 2.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::nbLockKeys = 16;
+  ::randomWorkload = false;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N: 피어 수. 기본값 16" << std::endl
+                << "--lock-keys=N: 락 키 수. 기본값 16" << std::endl
+                << "--inflight=N,...: 동시에 기다리는 요청 수 목록. 기본값 1,4,16,64"
+                << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl;
+      return 0;
+    case 1:
+      ss >> nb_peers;
+      break;
+    case 2:
+      ss >> ::nbLockKeys;
+      break;
+    case 3:
+      inflight = parseUIntList(optarg);
+      break;
+    case 4:
+      ss >> duration;
+      break;
+    }
+
+    if (ss.fail() || nb_peers == 0 || ::nbLockKeys == 0 || inflight.empty() ||
+        duration <= 0.0) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "inflight,acquire_per_sec,mean_latency_us" << std::endl;
+  for (const auto &n : inflight) {
+    const auto result = runChains(nb_peers, n, duration);
+
+    std::cout << n << ',' << std::fixed << std::setprecision(0)
+              << result.acquirePerSec() << ',' << result.meanLatencyUs()
+              << std::endl;
+  }
+
+  return 0;
+}
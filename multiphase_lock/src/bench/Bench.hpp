@@ -0,0 +1,143 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+struct BenchmarkReport;
+
+typedef std::chrono::steady_clock BenchClock;
+
+// "2,8,32" 같은 목록을 파싱. 실패하면 빈 벡터.
+std::vector<unsigned int> parseUIntList (const std::string &str);
+
+double secondsSince (const BenchClock::time_point &start);
+
+// 프로세스 전체의 CPU 시간(user + sys). 초 단위. `switches`가 있으면 문맥 교환
+// 수도 채움.
+double cpuSeconds (uint64_t *switches = nullptr);
+
+// 락 API로 무작위로 고른 피어에서 서로 다른 키 `nbKeys`개를 얻고 바로 놓기를
+// `stopFlag`가 설 때까지 되풀이하는 바깥 호출자 하나. `all`이면 `acquireAll()`로
+// 한꺼번에, 아니면 키 순서대로 하나씩 얻는다. 한 번에 하나만 기다리므로 여러 개를
+// 띄우면 그만큼 겹쳐서 기다린다.
+struct BenchChain {
+  // 얻을 때마다 놓기 전에 피어의 스레드에서 부름. 얻은 키들과 요청부터 얻기까지
+  // 걸린 시간(us)을 받음.
+  typedef std::function<void(const std::vector<LockKey> &, uint64_t)> Hook;
+
+  const std::vector<ThreadContext*> *peers = nullptr;
+  std::mt19937_64 rnd;
+  unsigned int nbKeys = 1;
+  bool all = false;
+  std::atomic<bool> *stopFlag = nullptr;
+  std::atomic<uint64_t> *acquired = nullptr;
+  // 있으면 얻기까지 걸린 시간(us)을 더함.
+  std::atomic<uint64_t> *latencySum = nullptr;
+  Hook onAcquired;
+  // 이하 지금 얻으려는 것.
+  ThreadContext *peer = nullptr;
+  std::vector<LockKey> keys;
+  BenchClock::time_point start;
+
+  void next ();
+  void __acquireFrom (const size_t i);
+  void __done (const LockResult result);
+};
+
+// 피어 `nbPeers`개를 ID 1부터 띄워 한꺼번에 넣음.
+std::vector<ThreadContext*> addPeers (const unsigned int nbPeers);
+
+// 피어 `nbPeers`개가 락 `nbKeys`개를 스스로 나눠 쓰며 프로토콜을 돌릴 때, 안정된
+// 뒤 `duration`초 동안의 초당 락 획득 수. 끝나면 피어를 모두 치움.
+double runAcquireRate (const unsigned int nbPeers, const unsigned int nbKeys,
+                       const double duration);
+
+// 피어 `nbPeers`개를 스스로 락을 얻게 `duration`초 동안 돌려 `report`에 모은 뒤
+// 피어를 모두 치움. 락 키 수는 `::nbLockKeys`를 따름.
+void runReport (BenchmarkReport &report, const unsigned int nbPeers,
+                const double duration);
+
+// 지금 있는 모든 피어가 보낸 명령 수의 합.
+uint64_t sentByPeers ();
+
+// `runChains()`로 잰 것.
+struct ChainResult {
+  uint64_t acquired = 0;
+  uint64_t latencySum = 0;
+  double elapsed = 0.0;
+
+  double acquirePerSec () const {
+    return this->elapsed > 0.0 ? (double)this->acquired / this->elapsed : 0.0;
+  }
+
+  // 요청부터 얻기까지 걸린 평균 시간(us).
+  double meanLatencyUs () const {
+    return this->acquired > 0 ?
+      (double)this->latencySum / (double)this->acquired : 0.0;
+  }
+};
+
+// 피어 `nbPeers`개를 띄우고 바깥 호출자 `inflight`개를 `duration`초 동안 돌린 뒤
+// 피어를 모두 치움. 락 키 수는 `::nbLockKeys`를 따름. `configure`는 호출자마다
+// 돌리기 전에, `onStart`는 재기 직전에, `onStop`은 재기를 마친 뒤 피어가 아직
+// 살아 있을 때 부름.
+ChainResult runChains (const unsigned int nbPeers, const unsigned int inflight,
+                       const double duration,
+                       const std::function<void(BenchChain &)> &configure = nullptr,
+                       const std::function<void()> &onStart = nullptr,
+                       const std::function<void()> &onStop = nullptr);
+
+// 키마다 마지막으로 놓은 시각을 남겨, 놓은 뒤 다음에 그 키를 얻기까지 걸린 시간을
+// 잼. `hook()`을 `BenchChain::onAcquired`에 넣으면 됨.
+class BenchGap {
+public:
+  BenchGap (const unsigned int nbKeys);
+
+  // 지금부터 다시 잼. 그 전에 놓은 기록은 지움.
+  void reset ();
+  // `key`를 얻어 곧 놓을 때 부름. 지난번에 놓은 때부터의 간격을 더하고, 지금을
+  // 놓은 시각으로 남김.
+  void handOver (const LockKey key);
+  // 지금까지의 평균 간격(us).
+  double meanUs () const;
+  // 얻은 첫 키로 `handOver()`를 부르는 `BenchChain::onAcquired`.
+  BenchChain::Hook hook ();
+
+protected:
+  const unsigned int __nbKeys;
+  // 키마다 마지막으로 놓은 시각. `__origin`부터 ns. 0이면 아직 놓은 적 없음.
+  std::unique_ptr<std::atomic<int64_t>[]> __releasedAt;
+  BenchClock::time_point __origin;
+  std::atomic<uint64_t> __count;
+  std::atomic<uint64_t> __sum;
+
+  int64_t __elapsed () const;
+};
+
+// 각 벤치마크 진입점. 반환값은 프로세스 종료 코드.
+int benchMailbox (const int argc, const char **args);
+int benchRegistry (const int argc, const char **args);
+int benchEvent (const int argc, const char **args);
+int benchKeys (const int argc, const char **args);
+int benchReuse (const int argc, const char **args);
+int benchQuorum (const int argc, const char **args);
+int benchPeerSet (const int argc, const char **args);
+int benchExecutor (const int argc, const char **args);
+int benchApi (const int argc, const char **args);
+int benchRwLock (const int argc, const char **args);
+int benchMultiKey (const int argc, const char **args);
+int benchHandoff (const int argc, const char **args);
+int benchTrace (const int argc, const char **args);
+int benchStartup (const int argc, const char **args);
+int benchPlacement (const int argc, const char **args);
+int benchSpin (const int argc, const char **args);
+
+#endif /* end of include guard: BENCH_H_ */
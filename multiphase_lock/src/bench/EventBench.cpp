@@ -0,0 +1,115 @@
+#include "Bench.hpp"
+#include "LegacyEventContext.hpp"
+#include "../EventContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+struct __EventResult {
+  // 모두 이벤트 하나당 ns.
+  double insert, rearm, expire;
+};
+
+// `nb_events`개의 타이머를 걸어 둔 상태에서
+// - insert: ID가 있는 지연 이벤트 추가
+// - rearm: 같은 ID로 취소 후 다시 추가(기아 타이머를 매번 다시 거는 것과 같음)
+// - expire: 가상 시간을 1ms씩 흘려 모두 발생시킴
+// 을 잼. 지연은 1ms ~ 60s 사이에서 고르게 고름.
+template <class Ctx>
+static __EventResult __run (const uint64_t nb_events, const uint64_t seed) {
+  typedef EventContext::ClockType ClockType;
+  std::unique_ptr<Ctx> ctx(new Ctx);
+  std::mt19937_64 rnd(seed);
+  std::vector<uint32_t> delays(nb_events * 2);
+  ClockType::time_point now = ClockType::now();
+  uint64_t fired = 0;
+  BenchClock::time_point start;
+  __EventResult ret;
+
+  for (auto &d : delays) {
+    d = (uint32_t)(rnd() % 60000) + 1;
+  }
+  ctx->setTime(&now);
+
+  start = BenchClock::now();
+  for (uint64_t i = 0; i < nb_events; i += 1) {
+    ctx->addDelayedEvent(std::chrono::milliseconds(delays[i]), [&fired]() { fired += 1; },
+                         (EventContext::EventID)(i + 1));
+  }
+  ret.insert = secondsSince(start) * 1e9 / (double)nb_events;
+
+  start = BenchClock::now();
+  for (uint64_t i = 0; i < nb_events; i += 1) {
+    const auto id = (EventContext::EventID)(i + 1);
+
+    ctx->cancelEvent(id);
+    ctx->addDelayedEvent(std::chrono::milliseconds(delays[nb_events + i]),
+                         [&fired]() { fired += 1; }, id);
+  }
+  ret.rearm = secondsSince(start) * 1e9 / (double)nb_events;
+
+  start = BenchClock::now();
+  while (fired < nb_events) {
+    now += std::chrono::milliseconds(1);
+    ctx->setTime(&now);
+    ctx->handle();
+  }
+  ret.expire = secondsSince(start) * 1e9 / (double)nb_events;
+
+  return ret;
+}
+
+int benchEvent (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"events", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> events = {1000, 10000, 100000, 1000000};
+  int opt_index, opt_char;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--events=N,...: 걸어 둘 타이머 수 목록. 기본값 "
+                   "1000,10000,100000,1000000"
+                << std::endl;
+      return 0;
+    case 1:
+      events = parseUIntList(optarg);
+      if (events.empty()) {
+        std::cerr << "** 잘못된 'events' 옵션 값 형식." << std::endl;
+        return 2;
+      }
+      break;
+    }
+  }
+
+  std::cout << "events,impl,insert_ns,rearm_ns,expire_ns" << std::endl;
+  for (const auto &n : events) {
+    if (n == 0) {
+      continue;
+    }
+
+    const auto legacy = __run<LegacyEventContext>(n, n);
+    const auto wheel = __run<EventContext>(n, n);
+
+    std::cout << std::fixed << std::setprecision(1)
+              << n << ",legacy," << legacy.insert << ',' << legacy.rearm << ','
+              << legacy.expire << std::endl
+              << n << ",wheel," << wheel.insert << ',' << wheel.rearm << ','
+              << wheel.expire << std::endl;
+  }
+
+  return 0;
+}
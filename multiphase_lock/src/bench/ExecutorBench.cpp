@@ -0,0 +1,221 @@
+#include "Bench.hpp"
+#include "../Executor.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+struct __Usage {
+  uint64_t acquired = 0;
+  // 프로세스 전체의 CPU 시간(user + sys)과 문맥 교환 수.
+  double cpuSeconds = 0.0;
+  uint64_t switches = 0;
+
+  void collect () {
+    ::forEachContext([this](ThreadContext *ctx) {
+      this->acquired += ctx->acquiredCount();
+    });
+
+    this->cpuSeconds = ::cpuSeconds(&this->switches);
+  }
+};
+
+struct __Result {
+  double acquirePerSec;
+  double cpuUtil;
+  double cpuUsPerAcquire;
+  double switchesPerSec;
+};
+
+// 피어 `nb_peers`개를 띄워, 안정된 뒤 `duration`초 동안의 증가분을 잼.
+// `nb_workers`가 0이면 피어마다 스레드, 아니면 그만큼의 작업 스레드에서 돌림.
+static void __run (__Result &result, const unsigned int nb_peers,
+                   const unsigned int nb_workers, const double duration) {
+  __Usage before, after;
+  BenchClock::time_point start;
+  double elapsed, cpu;
+  uint64_t acquired;
+
+  std::vector<std::atomic<uint32_t>>(::nbLockKeys).swap(::resources);
+  if (nb_workers > 0) {
+    ::executor = new Executor(nb_workers);
+  }
+
+  for (unsigned int i = 0; i < nb_peers; i += 1) {
+    auto ctx = new ThreadContext();
+
+    ctx->start(i + 1);
+    ::addContext(ctx);
+  }
+
+  // 첫 획득 시도(100ms 뒤)와 피어가 들어올 때 몰린 명령이 빠질 때까지 기다림.
+  std::this_thread::sleep_for(std::chrono::milliseconds(1600));
+  before.collect();
+  start = BenchClock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  after.collect();
+  elapsed = secondsSince(start);
+
+  ::clearContexts();
+  if (::executor != nullptr) {
+    delete ::executor;
+    ::executor = nullptr;
+  }
+
+  acquired = after.acquired - before.acquired;
+  cpu = after.cpuSeconds - before.cpuSeconds;
+  result.acquirePerSec = (double)acquired / elapsed;
+  result.cpuUtil = cpu / elapsed;
+  result.cpuUsPerAcquire = acquired > 0 ? cpu * 1e6 / (double)acquired : 0.0;
+  result.switchesPerSec = (double)(after.switches - before.switches) / elapsed;
+}
+
+// `__run()`을 자식 프로세스에서 돌림. 피어가 많으면 스레드나 메모리가 모자라거나
+// 기아 감지에 걸려 죽을 수 있으므로, 그래도 다음 측정을 계속하려고 따로 돌림.
+// 자식이 결과를 못 남기고 끝나면 거짓.
+static bool __runIsolated (__Result &result, const unsigned int nb_peers,
+                           const unsigned int nb_workers, const double duration) {
+  int fds[2], status;
+  pid_t pid;
+  ssize_t len;
+
+  if (::pipe(fds) != 0) {
+    return false;
+  }
+  // 측정 사이에는 main 스레드 말고는 스레드가 없으므로 fork해도 됨.
+  pid = ::fork();
+  if (pid < 0) {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    ::close(fds[0]);
+    __run(result, nb_peers, nb_workers, duration);
+    len = ::write(fds[1], &result, sizeof(result));
+    ::_exit(len == (ssize_t)sizeof(result) ? 0 : 1);
+  }
+
+  ::close(fds[1]);
+  len = ::read(fds[0], &result, sizeof(result));
+  ::close(fds[0]);
+  ::waitpid(pid, &status, 0);
+
+  return len == (ssize_t)sizeof(result) && WIFEXITED(status) &&
+    WEXITSTATUS(status) == 0;
+}
+
+// 피어 수별로 피어마다 스레드를 둘 때와 작업 스레드 몇 개에서 돌릴 때의 처리량과
+// CPU 사용량을 비교.
+int benchExecutor (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"workers", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"lock-engine", required_argument, nullptr, 0},
+    {"max-lock-hold-time", required_argument, nullptr, 0},
+    {"max-acquire-delay", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> peers = {1000, 10000};
+  unsigned int nb_workers = std::thread::hardware_concurrency();
+  double duration = 5.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  // 피어가 많을 때 처음에 몰리는 요청이 기아 감지에 걸리지 않을 만큼 길게.
+  ::maxLockHoldTime = 5;
+  ::maxAcquireDelay = 50;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+  // 피어마다 스레드를 둘 때 모든 피어의 허락을 받는 방식은 피어가 수천이면 들어오는
+  // 동안 기아 감지에 걸리므로 토큰 방식으로 잼.
+  ::lockEngine = LOCK_ENGINE_TOKEN;
+  if (nb_workers == 0) {
+    nb_workers = 1;
+  }
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N,...: 피어 수 목록. 기본값 1000,10000" << std::endl
+                << "--workers=N: 작업 스레드 수. 기본값 CPU 수" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 5" << std::endl
+                << "--lock-engine=E: \"multiphase\", \"quorum\" 또는 \"token\". "
+                   "기본값 token" << std::endl
+                << "--max-lock-hold-time=N: 락을 가지고 있을 최대 시간(ms). 기본값 5"
+                << std::endl
+                << "--max-acquire-delay=N: 다시 락을 얻기 전 최대 대기 시간(ms). "
+                   "기본값 50" << std::endl;
+      return 0;
+    case 1:
+      peers = parseUIntList(optarg);
+      break;
+    case 2:
+      ss >> nb_workers;
+      break;
+    case 3:
+      ss >> duration;
+      break;
+    case 4:
+      if (!::parseLockEngine(optarg, ::lockEngine)) {
+        ss.setstate(std::ios::failbit);
+      }
+      break;
+    case 5:
+      ss >> ::maxLockHoldTime;
+      break;
+    case 6:
+      ss >> ::maxAcquireDelay;
+      break;
+    }
+
+    if (ss.fail() || peers.empty() || nb_workers == 0 || duration <= 0.0 ||
+        ::maxLockHoldTime == UINT32_MAX || ::maxAcquireDelay == UINT32_MAX) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "peers,mode,os_threads,acquire_per_sec,cpu_util,"
+               "cpu_us_per_acquire,switches_per_sec" << std::endl;
+  for (const auto &n : peers) {
+    if (n == 0) {
+      continue;
+    }
+
+    for (const auto workers : {0u, nb_workers}) {
+      __Result result;
+
+      std::cout << n << ',' << (workers == 0 ? "thread" : "executor") << ','
+                << (workers == 0 ? n : workers) << ',' << std::flush;
+      if (!__runIsolated(result, n, workers, duration)) {
+        std::cout << "-,-,-,-" << std::endl;
+        continue;
+      }
+      std::cout << std::fixed << std::setprecision(0) << result.acquirePerSec
+                << ',' << std::setprecision(2) << result.cpuUtil << ','
+                << std::setprecision(0) << result.cpuUsPerAcquire << ','
+                << result.switchesPerSec << std::endl;
+    }
+  }
+
+  return 0;
+}
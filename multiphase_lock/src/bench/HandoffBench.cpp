@@ -0,0 +1,114 @@
+#include "Bench.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// 키 수별로, 락을 놓을 때 기다리는 피어에게 바로 넘길 때와 다시 물어보게 할 때의
+// 처리량, 메시지 수, 지연 시간과 놓은 뒤 다음 피어가 얻기까지 걸린 시간을 비교.
+// 동시에 기다리는 요청이 키보다 많아 락이 늘 몰림. 피어는 스스로 락을 얻지 않음.
+int benchHandoff (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"lock-keys", required_argument, nullptr, 0},
+    {"inflight", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> keys = {1, 4};
+  unsigned int nb_peers = 8, inflight = 16;
+  double duration = 2.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::randomWorkload = false;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+  ::lockEngine = LOCK_ENGINE_MULTIPHASE;
+  ::reusePermissions = false;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N: 피어 수. 기본값 8" << std::endl
+                << "--lock-keys=N,...: 락 키 수 목록. 기본값 1,4" << std::endl
+                << "--inflight=N: 동시에 기다리는 요청 수. 기본값 16" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl;
+      return 0;
+    case 1:
+      ss >> nb_peers;
+      break;
+    case 2:
+      keys = parseUIntList(optarg);
+      break;
+    case 3:
+      ss >> inflight;
+      break;
+    case 4:
+      ss >> duration;
+      break;
+    }
+
+    if (ss.fail() || nb_peers == 0 || keys.empty() || inflight == 0 ||
+        duration <= 0.0) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+  for (const auto &k : keys) {
+    if (k == 0) {
+      std::cerr << "** 잘못된 'lock-keys' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "lock_keys,handoff,acquire_per_sec,msgs_per_acquire,"
+               "mean_latency_us,mean_gap_us"
+            << std::endl;
+  for (const auto &k : keys) {
+    for (const auto handoff : {false, true}) {
+      BenchGap gap(k);
+      uint64_t sent = 0;
+      double meanGap = 0.0;
+      ChainResult result;
+
+      ::nbLockKeys = k;
+      ::lockHandoff = handoff;
+      result = runChains(nb_peers, inflight, duration,
+        [&gap](BenchChain &chain) { chain.onAcquired = gap.hook(); },
+        [&]() {
+          sent = sentByPeers();
+          gap.reset();
+        },
+        [&]() {
+          meanGap = gap.meanUs();
+          sent = sentByPeers() - sent;
+        });
+
+      std::cout << k << ',' << (handoff ? "on" : "off") << ',' << std::fixed
+                << std::setprecision(0) << result.acquirePerSec() << ','
+                << std::setprecision(2)
+                << (result.acquired > 0 ?
+                    (double)sent / (double)result.acquired : 0.0) << ','
+                << std::setprecision(0) << result.meanLatencyUs() << ','
+                << std::setprecision(1) << meanGap << std::endl;
+    }
+  }
+  ::lockHandoff = false;
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "Bench.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// 락 키 수별로, 실제 피어들이 락을 나눠 쓰며 프로토콜을 돌릴 때의 초당 락 획득 수.
+int benchKeys (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"keys", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"max-lock-hold-time", required_argument, nullptr, 0},
+    {"max-acquire-delay", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> keys = {1, 2, 4, 8, 16};
+  unsigned int nb_peers = 8;
+  double duration = 2.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::maxLockHoldTime = 1;
+  ::maxAcquireDelay = 1;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N: 피어 수. 기본값 8" << std::endl
+                << "--keys=N,...: 락 키 수 목록. 기본값 1,2,4,8,16" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl
+                << "--max-lock-hold-time=N: 락을 가지고 있을 최대 시간(ms). 기본값 1"
+                << std::endl
+                << "--max-acquire-delay=N: 다시 락을 얻기 전 최대 대기 시간(ms). 기본값 1"
+                << std::endl;
+      return 0;
+    case 1:
+      ss >> nb_peers;
+      break;
+    case 2:
+      keys = parseUIntList(optarg);
+      break;
+    case 3:
+      ss >> duration;
+      break;
+    case 4:
+      ss >> ::maxLockHoldTime;
+      break;
+    case 5:
+      ss >> ::maxAcquireDelay;
+      break;
+    }
+
+    if (ss.fail() || keys.empty() || duration <= 0.0 || nb_peers == 0 ||
+        ::maxLockHoldTime == UINT32_MAX || ::maxAcquireDelay == UINT32_MAX) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "peers,keys,acquire_per_sec" << std::endl;
+  for (const auto &k : keys) {
+    if (k == 0) {
+      continue;
+    }
+    std::cout << nb_peers << ',' << k << ',' << std::fixed << std::setprecision(0)
+              << runAcquireRate(nb_peers, k, duration) << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef LEGACYCOMMANDQUEUE_H_
+#define LEGACYCOMMANDQUEUE_H_
+#include "../Globals.hpp"
+
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+
+// 비교용. 풀을 쓰기 전의 `Command`.
+struct LegacyCommand {
+  OPCode op_code;
+  ContextID context_from;
+  ContextID context_to;
+};
+
+// 비교용. lock-free 우편함으로 바꾸기 전의 `CommandQueue`와
+// `ThreadContext::pushCommand()`를 그대로 옮긴 것.
+struct LegacyCommandQueue {
+  std::mutex mtx;
+  std::condition_variable cv_despatch;
+  std::queue<LegacyCommand*> q;
+
+  ~LegacyCommandQueue () {
+    this->clear();
+  }
+
+  void push (LegacyCommand *cmd) {
+    std::unique_lock<std::mutex> ul(this->mtx);
+
+    this->q.push(cmd);
+    this->cv_despatch.notify_all();
+  }
+
+  void clear () {
+    while (!q.empty()) {
+      delete q.front();
+      q.pop();
+    }
+  }
+};
+
+#endif /* end of include guard: LEGACYCOMMANDQUEUE_H_ */
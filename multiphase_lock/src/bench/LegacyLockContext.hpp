@@ -0,0 +1,16 @@
+#ifndef LEGACYLOCKCONTEXT_H_
+#define LEGACYLOCKCONTEXT_H_
+#include "../Globals.hpp"
+
+#include <set>
+
+// 비교용. 피어 집합을 비트맵으로 바꾸기 전의 `LockContext`. 상태와 주석은 뺐음.
+struct LegacyLockContext {
+  std::set<ContextID> sentMyLock;
+  std::set<ContextID> yourLockToRcv;
+  std::set<ContextID> yourLockToSend;
+  std::set<ContextID> rcvMyLock;
+  std::set<ContextID> permissions;
+};
+
+#endif /* end of include guard: LEGACYLOCKCONTEXT_H_ */
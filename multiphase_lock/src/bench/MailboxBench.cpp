@@ -0,0 +1,194 @@
+#include "Bench.hpp"
+#include "LegacyCommandQueue.hpp"
+#include "../CommandQueue.hpp"
+
+#include <getopt.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// 피어 `nb_peers`개가 한 피어의 우편함에 동시에 메시지를 보내는 상황(MyLock,
+// LockReset 방송 폭주)을 흉내냄. 소비자는 `ThreadContext::__run()`처럼 큐가 비면
+// 잠든다.
+template <class Q, class Produce, class Consume>
+static double __runFanIn (Q &q, const unsigned int nb_peers,
+                          const uint64_t nb_msg, Produce produce,
+                          Consume consume) {
+  std::vector<std::thread> producers;
+  std::atomic<bool> go(false);
+  BenchClock::time_point start;
+  const uint64_t perPeer = nb_msg / nb_peers;
+
+  for (unsigned int i = 0; i < nb_peers; i += 1) {
+    producers.emplace_back([&q, &go, perPeer, produce, i]() {
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (uint64_t n = 0; n < perPeer; n += 1) {
+        produce(q, i + 1);
+      }
+    });
+  }
+
+  start = BenchClock::now();
+  go.store(true, std::memory_order_release);
+  consume(q, perPeer * nb_peers);
+  const auto ret = secondsSince(start);
+
+  for (auto &th : producers) {
+    th.join();
+  }
+
+  return (double)(perPeer * nb_peers) / ret;
+}
+
+static void __produceLegacy (LegacyCommandQueue &q, const ContextID from) {
+  auto cmd = new LegacyCommand;
+
+  cmd->op_code = OPC_MY_LOCK;
+  cmd->context_from = from;
+  cmd->context_to = 0;
+  q.push(cmd);
+}
+
+static void __consumeLegacy (LegacyCommandQueue &q, const uint64_t nb_msg) {
+  LegacyCommand *cmd;
+
+  for (uint64_t n = 0; n < nb_msg; n += 1) {
+    {
+      std::unique_lock<std::mutex> ul(q.mtx);
+
+      while (q.q.empty()) {
+        q.cv_despatch.wait(ul);
+      }
+      cmd = q.q.front();
+      q.q.pop();
+    }
+    delete cmd;
+  }
+}
+
+static void __produceLockFree (CommandQueue &q, const ContextID from) {
+  auto env = Pool<Envelope>::alloc();
+
+  env->cmd = Command::make(OPC_MY_LOCK, from, 0);
+  q.push(env);
+}
+
+static void __consumeLockFree (CommandQueue &q, const uint64_t nb_msg) {
+  Envelope *env;
+
+  for (uint64_t n = 0; n < nb_msg; n += 1) {
+    while ((env = q.pop()) == nullptr) {
+      q.wait();
+    }
+    env->cmd->release();
+    Pool<Envelope>::free(env);
+  }
+}
+
+// `ThreadContext::__run()`처럼 `EventLoop`에 붙여 `epoll_wait()`로 잠듦.
+static void __consumeEventLoop (CommandQueue &q, const uint64_t nb_msg) {
+  Envelope *env;
+
+  for (uint64_t n = 0; n < nb_msg; n += 1) {
+    while ((env = q.pop()) == nullptr) {
+      q.waitUntil(EventLoop::ClockType::time_point::max());
+    }
+    env->cmd->release();
+    Pool<Envelope>::free(env);
+  }
+}
+
+int benchMailbox (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"messages", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> peers = {2, 8, 32, 128};
+  uint64_t nb_msg = 2000000;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N,...: 동시에 보내는 피어 수 목록. 기본값 2,8,32,128"
+                << std::endl
+                << "--messages=N: 측정마다 보낼 메시지 수." << std::endl;
+      return 0;
+    case 1:
+      peers = parseUIntList(optarg);
+      if (peers.empty()) {
+        std::cerr << "** 잘못된 'peers' 옵션 값 형식." << std::endl;
+        return 2;
+      }
+      break;
+    case 2:
+      ss.clear();
+      ss.str(optarg);
+      ss >> nb_msg;
+      if (ss.fail() || nb_msg == 0) {
+        std::cerr << "** 잘못된 'messages' 옵션 값 형식." << std::endl;
+        return 2;
+      }
+      break;
+    }
+  }
+
+  std::cout << "peers,legacy_msg_per_sec,lockfree_msg_per_sec,speedup,"
+               "eventloop_msg_per_sec,wakeups_per_msg,syscalls_per_msg"
+            << std::endl;
+  for (const auto &p : peers) {
+    double legacy, lockFree, eventLoop, wakeups, syscalls;
+
+    if (p == 0) {
+      continue;
+    }
+    {
+      LegacyCommandQueue q;
+      legacy = __runFanIn(q, p, nb_msg, __produceLegacy, __consumeLegacy);
+    }
+    {
+      CommandQueue q;
+      lockFree =
+        __runFanIn(q, p, nb_msg, __produceLockFree, __consumeLockFree);
+    }
+    {
+      CommandQueue q;
+      EventLoop loop;
+
+      if (!loop.open()) {
+        std::cerr << "** EventLoop를 만들 수 없음: " << std::strerror(errno)
+                  << std::endl;
+        return 2;
+      }
+      q.attach(&loop);
+      eventLoop =
+        __runFanIn(q, p, nb_msg, __produceLockFree, __consumeEventLoop);
+      wakeups = (double)loop.wakeups() / (double)(nb_msg / p * p);
+      syscalls = (double)loop.syscalls() / (double)(nb_msg / p * p);
+    }
+
+    std::cout << p << ',' << std::fixed << std::setprecision(0) << legacy
+              << ',' << lockFree << ',' << std::setprecision(2)
+              << lockFree / legacy << ',' << std::setprecision(0) << eventLoop
+              << ',' << std::setprecision(4) << wakeups << ',' << syscalls
+              << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include "Bench.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// 한 번에 얻는 키 수별로, 한꺼번에 얻을 때와 키 순서대로 하나씩 얻을 때의 처리량,
+// 메시지 수와 지연 시간을 비교. 피어는 스스로 락을 얻지 않음.
+int benchMultiKey (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"lock-keys", required_argument, nullptr, 0},
+    {"keys", required_argument, nullptr, 0},
+    {"inflight", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"lock-engine", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> keys = {1, 2, 4};
+  unsigned int nb_peers = 8, inflight = 8;
+  double duration = 2.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::nbLockKeys = 16;
+  ::randomWorkload = false;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N: 피어 수. 기본값 8" << std::endl
+                << "--lock-keys=N: 락 키 수. 기본값 16" << std::endl
+                << "--keys=N,...: 한 번에 얻는 키 수 목록. 기본값 1,2,4"
+                << std::endl
+                << "--inflight=N: 동시에 기다리는 요청 수. 기본값 8" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl
+                << "--lock-engine=E: \"multiphase\", \"quorum\" 또는 \"token\". "
+                   "기본값 multiphase" << std::endl;
+      return 0;
+    case 1:
+      ss >> nb_peers;
+      break;
+    case 2:
+      ss >> ::nbLockKeys;
+      break;
+    case 3:
+      keys = parseUIntList(optarg);
+      break;
+    case 4:
+      ss >> inflight;
+      break;
+    case 5:
+      ss >> duration;
+      break;
+    case 6:
+      if (!::parseLockEngine(optarg, ::lockEngine)) {
+        ss.setstate(std::ios::failbit);
+      }
+      break;
+    }
+
+    if (ss.fail() || nb_peers == 0 || ::nbLockKeys == 0 || keys.empty() ||
+        inflight == 0 || duration <= 0.0) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+  for (const auto &k : keys) {
+    if (k == 0 || k > ::nbLockKeys) {
+      std::cerr << "** 잘못된 'keys' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "keys,mode,acquire_per_sec,msgs_per_acquire,mean_latency_us"
+            << std::endl;
+  for (const auto &k : keys) {
+    for (const auto all : {true, false}) {
+      uint64_t sent = 0;
+      ChainResult result;
+
+      result = runChains(nb_peers, inflight, duration,
+        [k, all](BenchChain &chain) {
+          chain.nbKeys = k;
+          chain.all = all;
+        },
+        [&sent]() { sent = sentByPeers(); },
+        [&sent]() { sent = sentByPeers() - sent; });
+
+      std::cout << k << ',' << (all ? "all" : "serial") << ',' << std::fixed
+                << std::setprecision(0) << result.acquirePerSec() << ','
+                << std::setprecision(2)
+                << (result.acquired > 0 ?
+                    (double)sent / (double)result.acquired : 0.0) << ','
+                << std::setprecision(0) << result.meanLatencyUs() << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,216 @@
+#include "Bench.hpp"
+#include "LegacyLockContext.hpp"
+#include "../LockContext.hpp"
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+// `MultiphaseEngine`이 락 한 번에 하는 집합 처리를 메시지 없이 흉내 냄. 보낼
+// 명령은 받는 피어 ID를 더하기만 함.
+// - solicit: 모든 다른 피어에게 "MyLock"을 보낼 곳으로 기록
+// - grant: 다른 피어들의 "YourLock"을 무작위 순서로 받으며 다 받았는지 확인
+// - defer: 피어 1/4에게서 "MyLock"을 받아 미뤄 둠
+// - release: 미뤄 둔 곳에 "YourLock", 보냈던 곳에 "LockReset"을 보내고 비움
+// - reset: 그 1/4에게서 "LockReset"을 받음
+struct __LegacyBook {
+  std::vector<ContextID> others;
+  LegacyLockContext lc;
+
+  void solicit (uint64_t &sink) {
+    this->lc.yourLockToRcv.clear();
+    for (const auto &other : this->others) {
+      if (this->lc.permissions.count(other) > 0) {
+        continue;
+      }
+      sink += other;
+      this->lc.sentMyLock.insert(other);
+      this->lc.yourLockToRcv.insert(other);
+    }
+  }
+
+  bool yourLock (const ContextID from) {
+    this->lc.yourLockToRcv.erase(from);
+    return this->lc.yourLockToRcv.empty();
+  }
+
+  void myLock (const ContextID from) {
+    this->lc.rcvMyLock.insert(from);
+    this->lc.yourLockToSend.insert(from);
+  }
+
+  void release (uint64_t &sink) {
+    for (const auto &other : this->lc.yourLockToSend) {
+      sink += other;
+    }
+    this->lc.yourLockToSend.clear();
+    for (const auto &other : this->lc.sentMyLock) {
+      sink += other;
+    }
+    this->lc.sentMyLock.clear();
+  }
+
+  void lockReset (const ContextID from) {
+    this->lc.rcvMyLock.erase(from);
+    this->lc.yourLockToSend.erase(from);
+  }
+};
+
+struct __BitmapBook {
+  std::vector<ContextID> others;
+  PeerSlots slots;
+  PeerSet members;
+  LockContext lc;
+
+  void prepare () {
+    for (const auto &other : this->others) {
+      this->members.insert(this->slots.slotOf(other));
+    }
+  }
+
+  void solicit (uint64_t &sink) {
+    this->lc.yourLockToRcv.assignDifference(this->members, this->lc.permissions);
+    this->lc.sentMyLock.unite(this->lc.yourLockToRcv);
+    this->lc.yourLockToRcv.forEach([&](const uint32_t slot) {
+      sink += this->slots.idOf(slot);
+    });
+  }
+
+  bool yourLock (const ContextID from) {
+    this->lc.yourLockToRcv.erase(this->slots.slotOf(from));
+    return this->lc.yourLockToRcv.empty();
+  }
+
+  void myLock (const ContextID from) {
+    const auto slot = this->slots.slotOf(from);
+
+    this->lc.rcvMyLock.insert(slot);
+    this->lc.yourLockToSend.insert(slot);
+  }
+
+  void release (uint64_t &sink) {
+    this->lc.yourLockToSend.forEach([&](const uint32_t slot) {
+      sink += this->slots.idOf(slot);
+    });
+    this->lc.yourLockToSend.clear();
+    this->lc.sentMyLock.forEach([&](const uint32_t slot) {
+      sink += this->slots.idOf(slot);
+    });
+    this->lc.sentMyLock.clear();
+  }
+
+  void lockReset (const ContextID from) {
+    const auto slot = this->slots.slotOf(from);
+
+    this->lc.rcvMyLock.erase(slot);
+    this->lc.yourLockToSend.erase(slot);
+  }
+};
+
+static void __prepare (__LegacyBook &) {}
+
+static void __prepare (__BitmapBook &book) {
+  book.prepare();
+}
+
+// 락 한 번당 ns.
+template <class Book>
+static double __run (const unsigned int nb_peers, const uint64_t rounds,
+                     uint64_t &sink) {
+  Book book;
+  std::mt19937_64 rnd(nb_peers);
+  // 섞는 비용은 재지 않도록 미리 섞어 둔 순서들을 돌려 씀.
+  std::vector<std::vector<ContextID>> orders(8);
+  BenchClock::time_point start;
+  size_t nb_deferred = nb_peers / 4;
+
+  for (unsigned int i = 0; i < nb_peers; i += 1) {
+    // 나는 ID 1. 다른 피어는 2부터.
+    book.others.push_back(i + 2);
+  }
+  __prepare(book);
+  for (auto &order : orders) {
+    order = book.others;
+    std::shuffle(order.begin(), order.end(), rnd);
+  }
+
+  start = BenchClock::now();
+  for (uint64_t r = 0; r < rounds; r += 1) {
+    const auto &order = orders[r % orders.size()];
+
+    book.solicit(sink);
+    for (const auto &from : order) {
+      if (book.yourLock(from)) {
+        sink += 1;
+      }
+    }
+    for (size_t i = 0; i < nb_deferred; i += 1) {
+      book.myLock(order[i]);
+    }
+    book.release(sink);
+    for (size_t i = 0; i < nb_deferred; i += 1) {
+      book.lockReset(order[i]);
+    }
+  }
+
+  return secondsSince(start) * 1e9 / (double)rounds;
+}
+
+int benchPeerSet (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> peers = {64, 256, 1024, 4096};
+  int opt_index, opt_char;
+  uint64_t sink = 0;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N,...: 다른 피어 수 목록. 기본값 64,256,1024,4096"
+                << std::endl;
+      return 0;
+    case 1:
+      peers = parseUIntList(optarg);
+      if (peers.empty()) {
+        std::cerr << "** 잘못된 'peers' 옵션 값 형식." << std::endl;
+        return 2;
+      }
+      break;
+    }
+  }
+
+  std::cout << "peers,impl,ns_per_acquire,ns_per_peer" << std::endl;
+  for (const auto &n : peers) {
+    if (n == 0) {
+      continue;
+    }
+
+    // 피어 수와 상관없이 한 번에 비슷한 시간이 걸리도록.
+    const uint64_t rounds = std::max<uint64_t>(4000000 / n, 10);
+    const auto legacy = __run<__LegacyBook>(n, rounds, sink);
+    const auto bitmap = __run<__BitmapBook>(n, rounds, sink);
+
+    std::cout << std::fixed << std::setprecision(1)
+              << n << ",legacy," << legacy << ',' << legacy / n << std::endl
+              << n << ",bitmap," << bitmap << ',' << bitmap / n << std::endl;
+  }
+
+  // 계산을 지우지 못하게.
+  if (sink == 0) {
+    std::cerr << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,162 @@
+#include "Bench.hpp"
+#include "../Affinity.hpp"
+#include "../Executor.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// "a,b,c" 같은 이름 목록을 `parse`로 파싱. 하나라도 모르는 이름이면 빈 벡터.
+template <class T, class F>
+static std::vector<T> __parseNames (const std::string &str, F parse) {
+  std::vector<T> ret;
+  std::stringstream ss(str);
+  std::string token;
+
+  while (std::getline(ss, token, ',')) {
+    T v;
+
+    if (!parse(token, v)) {
+      return std::vector<T>();
+    }
+    ret.push_back(v);
+  }
+
+  return ret;
+}
+
+// 피어(또는 작업 스레드)를 CPU에 묶는 방식별로 락이 몰릴 때의 처리량, 획득 지연
+// 시간과 놓은 뒤 다음 피어가 얻기까지 걸린 시간을 비교. 묶지 않는 방식은 단위와
+// 상관없으므로 한 번만 돌림.
+int benchPlacement (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"lock-keys", required_argument, nullptr, 0},
+    {"inflight", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"workers", required_argument, nullptr, 0},
+    {"policies", required_argument, nullptr, 0},
+    {"scopes", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<AffinityPolicy> policies = {AFFINITY_NONE, AFFINITY_ROUND_ROBIN,
+                                          AFFINITY_COMPACT, AFFINITY_SCATTER};
+  std::vector<AffinityScope> scopes = {AFFINITY_SCOPE_CPU, AFFINITY_SCOPE_NODE};
+  unsigned int nb_peers = 8, nb_keys = 1, inflight = 16, nb_workers = 0;
+  double duration = 2.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::randomWorkload = false;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+  ::lockEngine = LOCK_ENGINE_MULTIPHASE;
+  ::reusePermissions = false;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N: 피어 수. 기본값 8" << std::endl
+                << "--lock-keys=N: 락 키 수. 기본값 1" << std::endl
+                << "--inflight=N: 동시에 기다리는 요청 수. 기본값 16" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl
+                << "--workers=N: 작업 스레드 수. 0이면 피어마다 스레드. 기본값 0"
+                << std::endl
+                << "--policies=P,...: 묶는 방식 목록. 기본값 "
+                   "none,round-robin,compact,scatter"
+                << std::endl
+                << "--scopes=S,...: 묶는 단위 목록. 기본값 cpu,node" << std::endl;
+      return 0;
+    case 1:
+      ss >> nb_peers;
+      break;
+    case 2:
+      ss >> nb_keys;
+      break;
+    case 3:
+      ss >> inflight;
+      break;
+    case 4:
+      ss >> duration;
+      break;
+    case 5:
+      ss >> nb_workers;
+      break;
+    case 6:
+      policies = __parseNames<AffinityPolicy>(optarg, ::parseAffinityPolicy);
+      break;
+    case 7:
+      scopes = __parseNames<AffinityScope>(optarg, ::parseAffinityScope);
+      break;
+    }
+
+    if (ss.fail() || nb_peers == 0 || nb_keys == 0 || inflight == 0 ||
+        duration <= 0.0 || policies.empty() || scopes.empty()) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  ::nbLockKeys = nb_keys;
+
+  std::cerr << "* " << CpuTopology::get().cpuCount() << " CPUs in "
+            << CpuTopology::get().nodeCount() << " NUMA nodes." << std::endl;
+  std::cout << "affinity,scope,acquire_per_sec,p50_us,p99_us,mean_gap_us"
+            << std::endl;
+  for (const auto &policy : policies) {
+    for (const auto &scope : scopes) {
+      BenchGap gap(nb_keys);
+      LatencyHistogram latency;
+      double meanGap = 0.0;
+      ChainResult result;
+
+      if (policy == AFFINITY_NONE && &scope != &scopes.front()) {
+        continue;
+      }
+
+      ::affinityPolicy = policy;
+      ::affinityScope = scope;
+      if (nb_workers > 0) {
+        ::executor = new Executor(nb_workers);
+      }
+      result = runChains(nb_peers, inflight, duration,
+        [&gap](BenchChain &chain) { chain.onAcquired = gap.hook(); },
+        [&gap]() { gap.reset(); },
+        [&]() {
+          meanGap = gap.meanUs();
+          ::forEachContext([&latency](ThreadContext *ctx) {
+            latency.merge(ctx->latency());
+          });
+        });
+      if (::executor != nullptr) {
+        delete ::executor;
+        ::executor = nullptr;
+      }
+
+      std::cout << ::affinityPolicyName(policy) << ','
+                << (policy == AFFINITY_NONE ? "" : ::affinityScopeName(scope))
+                << ',' << std::fixed << std::setprecision(0)
+                << result.acquirePerSec() << ',' << latency.percentile(0.5)
+                << ',' << latency.percentile(0.99) << ',' << std::setprecision(1)
+                << meanGap << std::endl;
+    }
+  }
+  ::affinityPolicy = AFFINITY_NONE;
+  ::affinityScope = AFFINITY_SCOPE_CPU;
+
+  return 0;
+}
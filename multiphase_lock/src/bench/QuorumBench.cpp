@@ -0,0 +1,151 @@
+#include "Bench.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+struct __Totals {
+  uint64_t acquired = 0;
+  uint64_t sent = 0;
+  uint64_t latencyCount = 0;
+  uint64_t latencySum = 0;
+
+  void collect () {
+    ::forEachContext([this](ThreadContext *ctx) {
+      this->acquired += ctx->acquiredCount();
+      this->sent += ctx->sentCount();
+      this->latencyCount += ctx->latency().count();
+      this->latencySum += ctx->latency().sum();
+    });
+  }
+};
+
+// 실제 피어 `nb_peers`개를 띄워, 안정된 뒤 `duration`초 동안의 증가분을 잼.
+// 피어가 들어온 직후에는 쿼럼 엔진이 모든 피어를 쿼럼으로 삼으므로 그 구간은 뺌.
+static void __run (__Totals &diff, double &elapsed, const unsigned int nb_peers,
+                   const double duration) {
+  __Totals before, after;
+  BenchClock::time_point start;
+
+  std::vector<std::atomic<uint32_t>>(::nbLockKeys).swap(::resources);
+
+  for (unsigned int i = 0; i < nb_peers; i += 1) {
+    auto ctx = new ThreadContext();
+
+    ctx->start(i + 1);
+    ::addContext(ctx);
+  }
+
+  // 첫 획득 시도(100ms 뒤), 쿼럼 엔진이 격자를 쓰기 시작할 때(500ms 뒤)와 그 동안
+  // 밀린 요청이 빠질 때까지 기다림.
+  std::this_thread::sleep_for(std::chrono::milliseconds(1600));
+  before.collect();
+  start = BenchClock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  after.collect();
+  elapsed = secondsSince(start);
+
+  ::clearContexts();
+
+  diff.acquired = after.acquired - before.acquired;
+  diff.sent = after.sent - before.sent;
+  diff.latencyCount = after.latencyCount - before.latencyCount;
+  diff.latencySum = after.latencySum - before.latencySum;
+}
+
+// 피어 수별로 락 엔진마다(모든 피어의 허락, 쿼럼, 토큰) 락 획득당 메시지 수와
+// 처리량을 비교.
+int benchQuorum (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"max-lock-hold-time", required_argument, nullptr, 0},
+    {"max-acquire-delay", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> peers = {4, 8, 16, 32, 64, 128, 256};
+  double duration = 2.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  // 피어가 많을 때 처음에 몰리는 요청이 기아 감지에 걸리지 않을 만큼 길게.
+  ::maxLockHoldTime = 5;
+  ::maxAcquireDelay = 50;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N,...: 피어 수 목록. 기본값 4,8,16,32,64,128,256"
+                << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl
+                << "--max-lock-hold-time=N: 락을 가지고 있을 최대 시간(ms). 기본값 5"
+                << std::endl
+                << "--max-acquire-delay=N: 다시 락을 얻기 전 최대 대기 시간(ms). "
+                   "기본값 50" << std::endl;
+      return 0;
+    case 1:
+      peers = parseUIntList(optarg);
+      break;
+    case 2:
+      ss >> duration;
+      break;
+    case 3:
+      ss >> ::maxLockHoldTime;
+      break;
+    case 4:
+      ss >> ::maxAcquireDelay;
+      break;
+    }
+
+    if (ss.fail() || peers.empty() || duration <= 0.0 ||
+        ::maxLockHoldTime == UINT32_MAX || ::maxAcquireDelay == UINT32_MAX) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "peers,lock_engine,acquire_per_sec,msgs_per_acquire,"
+               "mean_latency_us" << std::endl;
+  for (const auto &n : peers) {
+    if (n == 0) {
+      continue;
+    }
+
+    for (const auto engine :
+         {LOCK_ENGINE_MULTIPHASE, LOCK_ENGINE_QUORUM, LOCK_ENGINE_TOKEN}) {
+      __Totals diff;
+      double elapsed;
+
+      ::lockEngine = engine;
+      __run(diff, elapsed, n, duration);
+      std::cout << n << ',' << ::lockEngineName(engine) << ',' << std::fixed
+                << std::setprecision(0) << (double)diff.acquired / elapsed
+                << ',' << std::setprecision(2)
+                << (diff.acquired > 0 ? (double)diff.sent / (double)diff.acquired : 0.0)
+                << ',' << std::setprecision(0)
+                << (diff.latencyCount > 0
+                        ? (double)diff.latencySum / (double)diff.latencyCount
+                        : 0.0)
+                << std::endl;
+    }
+  }
+
+  return 0;
+}
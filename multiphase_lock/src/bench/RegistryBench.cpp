@@ -0,0 +1,167 @@
+#include "Bench.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// 프로토콜을 돌리지 않고 받은 명령을 버리기만 하는 피어.
+class __SinkContext : public ThreadContext {
+public:
+  __SinkContext (const ContextID id) {
+    this->__id = id;
+  }
+
+  uint64_t drain () {
+    Envelope *env;
+    uint64_t ret = 0;
+
+    while ((env = this->__cmdQueue.pop()) != nullptr) {
+      env->cmd->release();
+      Pool<Envelope>::free(env);
+      ret += 1;
+    }
+
+    return ret;
+  }
+};
+
+// 모든 피어가 임의의 다른 피어에게 `sendCommand()`로 계속 메시지를 보내는 상황.
+// `churnInterval`이 0이 아니면 그 간격(ms)마다 피어 하나를 넣었다 뺀다.
+static double __run (const unsigned int nb_peers, const double duration,
+                     const unsigned int churnInterval) {
+  std::vector<__SinkContext*> ctxs;
+  std::vector<std::thread> ths;
+  std::atomic<bool> go(false), stop(false);
+  std::atomic<uint64_t> sent(0);
+  std::thread churn;
+  BenchClock::time_point start;
+  double elapsed;
+
+  for (unsigned int i = 0; i < nb_peers; i += 1) {
+    ctxs.push_back(new __SinkContext(i + 1));
+    ::addContext(ctxs.back());
+  }
+
+  for (unsigned int i = 0; i < nb_peers; i += 1) {
+    ths.emplace_back([&, i]() {
+      const ContextID me = i + 1;
+      uint64_t x = me * 0x9E3779B97F4A7C15ULL, n = 0;
+      ContextID to;
+
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      while (!stop.load(std::memory_order_relaxed)) {
+        for (unsigned int k = 0; k < 64; k += 1) {
+          x ^= x << 13;
+          x ^= x >> 7;
+          x ^= x << 17;
+          to = (ContextID)(x % nb_peers) + 1;
+          if (to == me) {
+            to = to % nb_peers + 1;
+          }
+          ::sendCommand(Command::make(OPC_MY_LOCK, me, to));
+        }
+        n += 64;
+        ctxs[i]->drain();
+      }
+      sent.fetch_add(n);
+    });
+  }
+
+  if (churnInterval > 0) {
+    churn = std::thread([&]() {
+      const ContextID id = nb_peers + 1;
+
+      while (!stop.load(std::memory_order_relaxed)) {
+        auto ctx = new __SinkContext(id);
+
+        ::addContext(ctx);
+        std::this_thread::sleep_for(std::chrono::milliseconds(churnInterval));
+        delete ::popContext(id);
+      }
+    });
+  }
+
+  start = BenchClock::now();
+  go.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  stop.store(true);
+  for (auto &th : ths) {
+    th.join();
+  }
+  elapsed = secondsSince(start);
+  if (churn.joinable()) {
+    churn.join();
+  }
+
+  ::clearContexts();
+
+  return (double)sent.load() / elapsed;
+}
+
+int benchRegistry (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"churn-interval", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> peers = {8, 32, 128, 512};
+  double duration = 1.0;
+  unsigned int churnInterval = 0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N,...: 피어 수 목록. 기본값 8,32,128,512" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 1" << std::endl
+                << "--churn-interval=N: N ms마다 피어 하나를 넣었다 뺌. 기본값 0(안 함)"
+                << std::endl;
+      return 0;
+    case 1:
+      peers = parseUIntList(optarg);
+      break;
+    case 2:
+      ss >> duration;
+      break;
+    case 3:
+      ss >> churnInterval;
+      break;
+    }
+
+    if (ss.fail() || peers.empty() || duration <= 0.0) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "peers,send_per_sec" << std::endl;
+  for (const auto &p : peers) {
+    if (p < 2) {
+      continue;
+    }
+    std::cout << p << ',' << std::fixed << std::setprecision(0)
+              << __run(p, duration, churnInterval) << std::endl;
+  }
+
+  return 0;
+}
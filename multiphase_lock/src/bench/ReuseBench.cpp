@@ -0,0 +1,95 @@
+#include "Bench.hpp"
+#include "../BenchmarkReport.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// 경쟁 정도(락을 놓은 뒤 다시 얻으려 하기까지의 최대 대기 시간)별로, 받은 허락을
+// 재사용할 때와 안 할 때의 메시지 수와 지연 시간을 비교.
+int benchReuse (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"delays", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"max-lock-hold-time", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> delays = {0, 5, 20, 100};
+  unsigned int nb_peers = 8;
+  double duration = 2.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::maxLockHoldTime = 1;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N: 피어 수. 기본값 8" << std::endl
+                << "--delays=N,...: 다시 락을 얻기 전 최대 대기 시간(ms) 목록. "
+                   "클수록 경쟁이 적음. 기본값 0,5,20,100" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl
+                << "--max-lock-hold-time=N: 락을 가지고 있을 최대 시간(ms). 기본값 1"
+                << std::endl;
+      return 0;
+    case 1:
+      ss >> nb_peers;
+      break;
+    case 2:
+      delays = parseUIntList(optarg);
+      break;
+    case 3:
+      ss >> duration;
+      break;
+    case 4:
+      ss >> ::maxLockHoldTime;
+      break;
+    }
+
+    if (ss.fail() || delays.empty() || duration <= 0.0 || nb_peers == 0 ||
+        ::maxLockHoldTime == UINT32_MAX) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "peers,max_acquire_delay,permission_reuse,acquire_per_sec,"
+               "msgs_per_acquire,p50_us,p99_us" << std::endl;
+  for (const auto &d : delays) {
+    if (d == UINT32_MAX) {
+      continue;
+    }
+    ::maxAcquireDelay = d;
+
+    for (const auto reuse : {false, true}) {
+      BenchmarkReport report;
+
+      ::reusePermissions = reuse;
+      runReport(report, nb_peers, duration);
+      std::cout << nb_peers << ',' << d << ',' << (reuse ? 1 : 0) << ','
+                << std::fixed << std::setprecision(0) << report.throughput()
+                << ',' << std::setprecision(2) << report.messagesPerAcquisition()
+                << ',' << report.latency.percentile(0.5) << ','
+                << report.latency.percentile(0.99) << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include "Bench.hpp"
+#include "../BenchmarkReport.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// 공유 모드로 얻는 비율별로 처리량, 메시지 수와 지연 시간을 잼. 공유 요청끼리는
+// 서로 기다리지 않으므로 비율이 높을수록 락을 가지고 있는 시간이 겹친다.
+int benchRwLock (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"read-percents", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"max-lock-hold-time", required_argument, nullptr, 0},
+    {"max-acquire-delay", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> percents = {0, 50, 90, 99, 100};
+  unsigned int nb_peers = 8;
+  double duration = 2.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::maxLockHoldTime = 5;
+  ::maxAcquireDelay = 5;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N: 피어 수. 기본값 8" << std::endl
+                << "--read-percents=N,...: 공유 모드로 얻는 비율(%) 목록. "
+                   "기본값 0,50,90,99,100" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl
+                << "--max-lock-hold-time=N: 락을 가지고 있을 최대 시간(ms). 기본값 5"
+                << std::endl
+                << "--max-acquire-delay=N: 다시 락을 얻기 전 최대 대기 시간(ms). "
+                   "기본값 5" << std::endl;
+      return 0;
+    case 1:
+      ss >> nb_peers;
+      break;
+    case 2:
+      percents = parseUIntList(optarg);
+      break;
+    case 3:
+      ss >> duration;
+      break;
+    case 4:
+      ss >> ::maxLockHoldTime;
+      break;
+    case 5:
+      ss >> ::maxAcquireDelay;
+      break;
+    }
+
+    if (ss.fail() || percents.empty() || duration <= 0.0 || nb_peers == 0 ||
+        ::maxLockHoldTime == UINT32_MAX || ::maxAcquireDelay == UINT32_MAX) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "peers,read_ratio,acquire_per_sec,msgs_per_acquire,p50_us,p99_us"
+            << std::endl;
+  for (const auto &p : percents) {
+    BenchmarkReport report;
+
+    if (p > 100) {
+      continue;
+    }
+    ::readRatio = (double)p / 100.0;
+
+    runReport(report, nb_peers, duration);
+    std::cout << nb_peers << ',' << std::fixed << std::setprecision(2)
+              << ::readRatio << ',' << std::setprecision(0)
+              << report.throughput() << ',' << std::setprecision(2)
+              << report.messagesPerAcquisition() << ','
+              << report.latency.percentile(0.5) << ','
+              << report.latency.percentile(0.99) << std::endl;
+  }
+
+  return 0;
+}
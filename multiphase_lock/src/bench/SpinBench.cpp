@@ -0,0 +1,122 @@
+#include "Bench.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// 잠들기 전에 돌 수 있는 최대 시간별로 락이 몰릴 때의 처리량, 획득 지연 시간, 놓은
+// 뒤 다음 피어가 얻기까지 걸린 시간과 CPU 사용량을 비교. 0은 바로 잠드는 방식.
+int benchSpin (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"lock-keys", required_argument, nullptr, 0},
+    {"inflight", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"spin-wait", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> spins = {0, 5, 20, 100};
+  unsigned int nb_peers = 8, nb_keys = 1, inflight = 8;
+  double duration = 2.0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::randomWorkload = false;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+  ::lockEngine = LOCK_ENGINE_MULTIPHASE;
+  ::reusePermissions = false;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N: 피어 수. 기본값 8" << std::endl
+                << "--lock-keys=N: 락 키 수. 기본값 1" << std::endl
+                << "--inflight=N: 동시에 기다리는 요청 수. 기본값 8" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl
+                << "--spin-wait=N,...: 잠들기 전에 돌 최대 시간(us) 목록. 0은 "
+                   "바로 잠듦. 기본값 0,5,20,100"
+                << std::endl;
+      return 0;
+    case 1:
+      ss >> nb_peers;
+      break;
+    case 2:
+      ss >> nb_keys;
+      break;
+    case 3:
+      ss >> inflight;
+      break;
+    case 4:
+      ss >> duration;
+      break;
+    case 5:
+      spins = parseUIntList(optarg);
+      break;
+    }
+
+    if (ss.fail() || nb_peers == 0 || nb_keys == 0 || inflight == 0 ||
+        duration <= 0.0 || spins.empty()) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  ::nbLockKeys = nb_keys;
+
+  std::cout << "spin_wait_us,acquire_per_sec,p50_us,p99_us,mean_gap_us,"
+               "cpu_util,cpu_us_per_acquire,spin_hit_ratio"
+            << std::endl;
+  for (const auto &spin : spins) {
+    BenchGap gap(nb_keys);
+    LatencyHistogram latency;
+    uint64_t hits = 0, misses = 0;
+    double meanGap = 0.0, cpu = 0.0;
+    ChainResult result;
+
+    ::spinWait = spin;
+    result = runChains(nb_peers, inflight, duration,
+      [&gap](BenchChain &chain) { chain.onAcquired = gap.hook(); },
+      [&]() {
+        gap.reset();
+        cpu = cpuSeconds();
+      },
+      [&]() {
+        meanGap = gap.meanUs();
+        cpu = cpuSeconds() - cpu;
+        ::forEachContext([&](ThreadContext *ctx) {
+          latency.merge(ctx->latency());
+          hits += ctx->spinHitCount();
+          misses += ctx->spinMissCount();
+        });
+      });
+
+    std::cout << spin << ',' << std::fixed << std::setprecision(0)
+              << result.acquirePerSec() << ',' << latency.percentile(0.5)
+              << ',' << latency.percentile(0.99) << ',' << std::setprecision(1)
+              << meanGap << ',' << std::setprecision(2)
+              << cpu / result.elapsed << ',' << std::setprecision(1)
+              << (result.acquired > 0 ?
+                  cpu * 1e6 / (double)result.acquired : 0.0) << ','
+              << std::setprecision(2)
+              << (hits + misses > 0 ? (double)hits / (double)(hits + misses) : 0.0)
+              << std::endl;
+  }
+  ::spinWait = 0;
+
+  return 0;
+}
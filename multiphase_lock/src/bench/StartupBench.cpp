@@ -0,0 +1,133 @@
+#include "Bench.hpp"
+#include "../Executor.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+
+#include <getopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// 피어 `nb_peers`개를 띄워 넣은 순간부터, 마지막 피어가 락 API로 처음 락을 얻기까지
+// 걸린 시간을 잼. 그 피어는 모든 피어의 허락을 받아야 하고, 피어들은 우편함의
+// 명령을 순서대로 처리하므로 앞서 받은 피어 목록을 모두 처리한 뒤에야 답한다.
+static void __run (const unsigned int nb_peers, const bool bulk,
+                   const unsigned int nb_workers) {
+  std::vector<ThreadContext*> ctxs;
+  BenchClock::time_point start;
+  double spawned, acquired, teardown;
+  uint64_t processed = 0;
+
+  if (nb_workers > 0) {
+    ::executor = new Executor(nb_workers);
+  }
+
+  start = BenchClock::now();
+  for (unsigned int i = 0; i < nb_peers; i += 1) {
+    auto ctx = new ThreadContext();
+
+    ctx->start(i + 1);
+    ctxs.push_back(ctx);
+    if (!bulk) {
+      ::addContext(ctx);
+    }
+  }
+  if (bulk) {
+    ::addContexts(ctxs);
+  }
+  spawned = secondsSince(start);
+
+  ctxs.back()->acquire(0).get();
+  acquired = secondsSince(start);
+  ::forEachContext([&processed](ThreadContext *ctx) {
+    processed += ctx->processedCount();
+  });
+  ctxs.back()->release(0);
+
+  start = BenchClock::now();
+  ::clearContexts();
+  teardown = secondsSince(start);
+
+  if (::executor != nullptr) {
+    delete ::executor;
+    ::executor = nullptr;
+  }
+
+  std::cout << nb_peers << ',' << (bulk ? "bulk" : "one") << ',' << std::fixed
+            << std::setprecision(1) << spawned * 1000.0 << ','
+            << acquired * 1000.0 << ',' << processed << ','
+            << teardown * 1000.0 << std::endl;
+}
+
+// 피어 수별로, 피어를 하나씩 넣을 때와 한꺼번에 넣을 때 첫 획득까지 걸린 시간과
+// 그때까지 피어들이 처리한 명령 수, 모두 치우는 데 걸린 시간을 비교.
+int benchStartup (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"workers", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> peers = {64, 256, 1024};
+  unsigned int nb_workers = 0;
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::randomWorkload = false;
+  ::fixedSeed = true;
+  ::rngSeed = 1;
+  ::lockEngine = LOCK_ENGINE_MULTIPHASE;
+  ::nbLockKeys = 1;
+  // 기아 감지 기한이 피어 수에 비례하도록. 피어가 많으면 첫 획득이 1초를 넘을 수
+  // 있음.
+  ::maxLockHoldTime = 1;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N,...: 피어 수 목록. 기본값 64,256,1024" << std::endl
+                << "--workers=N: 작업 스레드 수. 0이면 피어마다 스레드. 기본값 0"
+                << std::endl;
+      return 0;
+    case 1:
+      peers = parseUIntList(optarg);
+      break;
+    case 2:
+      ss >> nb_workers;
+      break;
+    }
+
+    if (ss.fail() || peers.empty()) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+  for (const auto &n : peers) {
+    if (n == 0) {
+      std::cerr << "** 잘못된 'peers' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::vector<std::atomic<uint32_t>>(::nbLockKeys).swap(::resources);
+
+  std::cout << "peers,spawn,spawn_ms,first_acquire_ms,commands,teardown_ms"
+            << std::endl;
+  for (const auto &n : peers) {
+    for (const auto bulk : {false, true}) {
+      __run(n, bulk, nb_workers);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,155 @@
+#include "Bench.hpp"
+#include "../Globals.hpp"
+#include "../ThreadContext.hpp"
+#include "../Tracer.hpp"
+
+#include <getopt.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+struct __TraceRun {
+  double acquirePerSec;
+  uint64_t records;
+  uint64_t dropped;
+  // 바깥 스레드에서 잰 `Tracer::record()` 한 번의 비용.
+  double recordNs;
+};
+
+// 링이 넘치지 않도록 반씩 나눠 쓰고, 사이사이 뒤에서 도는 스레드가 비울 때까지 쉼.
+static double __recordCost (Tracer &tracer) {
+  static const unsigned int BATCH = 1 << 15, ROUNDS = 16;
+  const auto at = BenchClock::now();
+  double sum = 0.0;
+
+  for (unsigned int r = 0; r < ROUNDS; r += 1) {
+    const auto start = BenchClock::now();
+
+    for (unsigned int i = 0; i < BATCH; i += 1) {
+      tracer.record(TRACE_TIMERS, 0, at, 0, i, 0, r);
+    }
+    sum += secondsSince(start);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  return sum * 1e9 / (double)(BATCH * ROUNDS);
+}
+
+// 실제 피어 `nb_peers`개가 락 `nb_keys`개를 쉬지 않고 나눠 쓸 때의 초당 락 획득 수.
+// `path`가 비어 있지 않으면 그 파일에 기록하며 돌림.
+static bool __run (const unsigned int nb_peers, const unsigned int nb_keys,
+                   const double duration, const std::string &path,
+                   __TraceRun &result) {
+  Tracer tracer;
+
+  if (!path.empty()) {
+    if (!tracer.open(path)) {
+      return false;
+    }
+    ::tracer = &tracer;
+  }
+
+  result.acquirePerSec = runAcquireRate(nb_peers, nb_keys, duration);
+  result.records = 0;
+  result.dropped = 0;
+  result.recordNs = 0.0;
+  if (!path.empty()) {
+    result.recordNs = __recordCost(tracer);
+    ::tracer = nullptr;
+    tracer.close();
+    result.records = tracer.written();
+    result.dropped = tracer.dropped();
+  }
+
+  return true;
+}
+
+// 키 수별로, 기록하지 않을 때와 `--trace`처럼 파일에 기록할 때의 초당 락 획득 수와
+// 기록 수를 비교. 피어는 락을 쥐지도 쉬지도 않으므로 메시지를 가장 많이 주고받음.
+int benchTrace (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"peers", required_argument, nullptr, 0},
+    {"keys", required_argument, nullptr, 0},
+    {"duration", required_argument, nullptr, 0},
+    {"file", required_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  std::vector<unsigned int> keys = {1, 4};
+  unsigned int nb_peers = 8;
+  double duration = 2.0;
+  std::string path = "trace-bench.bin";
+  int opt_index, opt_char;
+  std::stringstream ss;
+
+  ::maxLockHoldTime = 0;
+  ::maxAcquireDelay = 0;
+
+  optind = 1;
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    ss.clear();
+    ss.str(optarg == nullptr ? "" : optarg);
+    switch (opt_index) {
+    case 0:
+      std::cerr << "--help: 이 메시지를 출력." << std::endl
+                << "--peers=N: 피어 수. 기본값 8" << std::endl
+                << "--keys=N,...: 락 키 수 목록. 기본값 1,4" << std::endl
+                << "--duration=S: 측정마다 돌릴 시간(초). 기본값 2" << std::endl
+                << "--file=PATH: 기록할 파일. 끝나면 지움. 기본값 trace-bench.bin"
+                << std::endl;
+      return 0;
+    case 1:
+      ss >> nb_peers;
+      break;
+    case 2:
+      keys = parseUIntList(optarg);
+      break;
+    case 3:
+      ss >> duration;
+      break;
+    case 4:
+      path = optarg;
+      break;
+    }
+
+    if (ss.fail() || keys.empty() || duration <= 0.0 || nb_peers == 0 ||
+        path.empty()) {
+      std::cerr << "** 잘못된 '" << __OPTS__[opt_index].name
+                << "' 옵션 값 형식." << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "keys,trace,acquire_per_sec,records_per_sec,dropped,record_ns"
+            << std::endl;
+  for (const auto &k : keys) {
+    if (k == 0) {
+      continue;
+    }
+    for (const auto trace : {false, true}) {
+      __TraceRun result;
+
+      if (!__run(nb_peers, k, duration, trace ? path : std::string(), result)) {
+        std::cerr << "** '" << path << "' 파일에 기록할 수 없음: "
+                  << std::strerror(errno) << std::endl;
+        return 2;
+      }
+      std::cout << k << ',' << (trace ? "on" : "off") << ',' << std::fixed
+                << std::setprecision(0) << result.acquirePerSec << ','
+                << (double)result.records / duration << ',' << result.dropped
+                << ',' << std::setprecision(1) << result.recordNs << std::endl;
+    }
+  }
+  std::remove(path.c_str());
+
+  return 0;
+}
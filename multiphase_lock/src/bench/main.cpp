@@ -0,0 +1,325 @@
+#include "Bench.hpp"
+#include "../BenchmarkReport.hpp"
+#include "../EventLoop.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+struct BenchEntry {
+  const char *name;
+  int (*func)(const int, const char **);
+  const char *desc;
+};
+
+static const BenchEntry __BENCHES__[] = {
+  {"mailbox", benchMailbox,
+   "피어 우편함(CommandQueue)의 초당 메시지 처리량과 깨우는 비용을 이전 구현과 비교."},
+  {"registry", benchRegistry,
+   "모든 피어가 sendCommand()로 동시에 보낼 때의 초당 송신량."},
+  {"event", benchEvent,
+   "EventContext의 타이머 추가/재설정/만료 비용을 이전 구현과 비교."},
+  {"keys", benchKeys,
+   "락 키 수에 따른 전체 피어의 초당 락 획득 수."},
+  {"reuse", benchReuse,
+   "경쟁 정도별로 받은 허락을 재사용할 때의 메시지 수와 지연 시간을 비교."},
+  {"quorum", benchQuorum,
+   "피어 수별로 기본, 쿼럼, 토큰 방식의 획득당 메시지 수와 처리량을 비교."},
+  {"peerset", benchPeerSet,
+   "피어 수별로 락 한 번에 드는 피어 집합 처리 비용을 이전 구현과 비교."},
+  {"executor", benchExecutor,
+   "피어 수별로 피어마다 스레드를 둘 때와 작업 스레드에서 돌릴 때의 처리량과 CPU 사용량을 비교."},
+  {"api", benchApi,
+   "동시에 기다리는 요청 수별로 락 API의 처리량과 지연 시간."},
+  {"rwlock", benchRwLock,
+   "공유 모드로 얻는 비율별로 처리량과 지연 시간."},
+  {"multikey", benchMultiKey,
+   "한 번에 얻는 키 수별로 한꺼번에 얻을 때와 하나씩 얻을 때를 비교."},
+  {"handoff", benchHandoff,
+   "락이 몰릴 때 기다리는 피어에게 바로 넘길 때와 아닐 때를 비교."},
+  {"trace", benchTrace,
+   "--trace로 기록할 때와 아닐 때의 처리량과 기록 한 번의 비용을 비교."},
+  {"startup", benchStartup,
+   "피어 수별로 피어를 하나씩 넣을 때와 한꺼번에 넣을 때 첫 획득까지 걸린 시간을 비교."},
+  {"placement", benchPlacement,
+   "피어를 CPU나 NUMA 노드에 묶는 방식별로 처리량과 지연 시간을 비교."},
+  {"spin", benchSpin,
+   "잠들기 전에 우편함을 기다리며 돌 때와 바로 잠들 때의 지연 시간과 CPU 사용량을 비교."},
+  {nullptr, nullptr, nullptr}
+};
+
+std::vector<unsigned int> parseUIntList (const std::string &str) {
+  std::vector<unsigned int> ret;
+  std::stringstream ss(str);
+  std::string token;
+
+  while (std::getline(ss, token, ',')) {
+    std::stringstream ts(token);
+    unsigned int v;
+
+    ts >> v;
+    if (ts.fail() || !ts.eof()) {
+      return std::vector<unsigned int>();
+    }
+    ret.push_back(v);
+  }
+
+  return ret;
+}
+
+double secondsSince (const BenchClock::time_point &start) {
+  return std::chrono::duration_cast<std::chrono::duration<double>>(
+    BenchClock::now() - start).count();
+}
+
+double cpuSeconds (uint64_t *switches) {
+  struct rusage ru;
+
+  ::getrusage(RUSAGE_SELF, &ru);
+  if (switches != nullptr) {
+    *switches = (uint64_t)ru.ru_nvcsw + (uint64_t)ru.ru_nivcsw;
+  }
+  return (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1e6 +
+    (double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1e6;
+}
+
+void BenchChain::next () {
+  if (this->stopFlag->load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  this->peer = (*this->peers)[this->rnd() % this->peers->size()];
+  this->keys.clear();
+  while (this->keys.size() < this->nbKeys) {
+    const auto key = (LockKey)(this->rnd() % ::nbLockKeys);
+
+    if (std::find(this->keys.begin(), this->keys.end(), key) == this->keys.end()) {
+      this->keys.push_back(key);
+    }
+  }
+  std::sort(this->keys.begin(), this->keys.end());
+  this->start = BenchClock::now();
+
+  // 콜백은 피어의 스레드에서 불리지만 락 API는 어느 스레드에서든 부를 수 있음.
+  if (this->all) {
+    this->peer->acquireAll(this->keys, [this](const LockResult result) {
+      this->__done(result);
+    });
+  } else {
+    this->__acquireFrom(0);
+  }
+}
+
+void BenchChain::__acquireFrom (const size_t i) {
+  this->peer->acquire(this->keys[i], [this, i](const LockResult result) {
+    if (result == LOCK_ACQUIRED && i + 1 < this->keys.size()) {
+      this->__acquireFrom(i + 1);
+    } else {
+      this->__done(result);
+    }
+  });
+}
+
+void BenchChain::__done (const LockResult result) {
+  uint64_t latency;
+
+  if (result != LOCK_ACQUIRED) {
+    return;
+  }
+
+  latency = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    BenchClock::now() - this->start).count();
+  this->acquired->fetch_add(1, std::memory_order_relaxed);
+  if (this->latencySum != nullptr) {
+    this->latencySum->fetch_add(latency, std::memory_order_relaxed);
+  }
+  if (this->onAcquired) {
+    this->onAcquired(this->keys, latency);
+  }
+  for (const auto key : this->keys) {
+    this->peer->release(key);
+  }
+  this->next();
+}
+
+std::vector<ThreadContext*> addPeers (const unsigned int nbPeers) {
+  std::vector<ThreadContext*> ret;
+
+  for (unsigned int i = 0; i < nbPeers; i += 1) {
+    auto ctx = new ThreadContext();
+
+    ctx->start(i + 1);
+    ret.push_back(ctx);
+  }
+  ::addContexts(ret);
+
+  return ret;
+}
+
+double runAcquireRate (const unsigned int nbPeers, const unsigned int nbKeys,
+                       const double duration) {
+  uint64_t before = 0, after = 0;
+  BenchClock::time_point start;
+  double elapsed;
+
+  ::nbLockKeys = nbKeys;
+  std::vector<std::atomic<uint32_t>>(nbKeys).swap(::resources);
+  addPeers(nbPeers);
+
+  // 첫 획득 시도(100ms 뒤)가 시작되고 안정될 때까지 기다림.
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  ::forEachContext([&](ThreadContext *ctx) { before += ctx->acquiredCount(); });
+  start = BenchClock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  ::forEachContext([&](ThreadContext *ctx) { after += ctx->acquiredCount(); });
+  elapsed = secondsSince(start);
+
+  ::clearContexts();
+
+  return (double)(after - before) / elapsed;
+}
+
+void runReport (BenchmarkReport &report, const unsigned int nbPeers,
+                const double duration) {
+  BenchClock::time_point start;
+
+  std::vector<std::atomic<uint32_t>>(::nbLockKeys).swap(::resources);
+
+  start = BenchClock::now();
+  addPeers(nbPeers);
+
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  report.seconds = secondsSince(start);
+  report.collect();
+
+  ::clearContexts();
+}
+
+uint64_t sentByPeers () {
+  uint64_t ret = 0;
+
+  ::forEachContext([&ret](ThreadContext *ctx) {
+    ret += ctx->sentCount();
+  });
+  return ret;
+}
+
+ChainResult runChains (const unsigned int nbPeers, const unsigned int inflight,
+                       const double duration,
+                       const std::function<void(BenchChain &)> &configure,
+                       const std::function<void()> &onStart,
+                       const std::function<void()> &onStop) {
+  std::unique_ptr<BenchChain[]> chains(new BenchChain[inflight]);
+  std::atomic<bool> stopFlag(false);
+  std::atomic<uint64_t> acquired(0), latencySum(0);
+  std::vector<ThreadContext*> peers;
+  BenchClock::time_point start;
+  ChainResult ret;
+
+  std::vector<std::atomic<uint32_t>>(::nbLockKeys).swap(::resources);
+  peers = addPeers(nbPeers);
+  // 모든 피어가 서로를 알 때까지 기다림.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  if (onStart) {
+    onStart();
+  }
+  start = BenchClock::now();
+  for (unsigned int i = 0; i < inflight; i += 1) {
+    chains[i].peers = &peers;
+    chains[i].rnd.seed(i + 1);
+    chains[i].stopFlag = &stopFlag;
+    chains[i].acquired = &acquired;
+    chains[i].latencySum = &latencySum;
+    if (configure) {
+      configure(chains[i]);
+    }
+    chains[i].next();
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  ret.acquired = acquired.load();
+  ret.latencySum = latencySum.load();
+  ret.elapsed = secondsSince(start);
+  if (onStop) {
+    onStop();
+  }
+  stopFlag.store(true);
+
+  // 남은 요청은 피어가 멈추며 끝냄. 그 콜백이 `chains`를 보므로 먼저 치움.
+  ::clearContexts();
+
+  return ret;
+}
+
+BenchGap::BenchGap (const unsigned int nbKeys)
+  : __nbKeys(nbKeys), __releasedAt(new std::atomic<int64_t>[nbKeys]),
+    __count(0), __sum(0) {
+  this->reset();
+}
+
+void BenchGap::reset () {
+  this->__origin = BenchClock::now();
+  for (unsigned int i = 0; i < this->__nbKeys; i += 1) {
+    this->__releasedAt[i].store(0);
+  }
+  this->__count.store(0);
+  this->__sum.store(0);
+}
+
+void BenchGap::handOver (const LockKey key) {
+  const auto now = this->__elapsed();
+  const auto released = this->__releasedAt[key].load(std::memory_order_relaxed);
+
+  if (released > 0) {
+    this->__count.fetch_add(1, std::memory_order_relaxed);
+    this->__sum.fetch_add((uint64_t)(now - released), std::memory_order_relaxed);
+  }
+  this->__releasedAt[key].store(this->__elapsed(), std::memory_order_relaxed);
+}
+
+double BenchGap::meanUs () const {
+  const auto count = this->__count.load();
+  const auto sum = this->__sum.load();
+
+  return count > 0 ? (double)sum / (double)count / 1000.0 : 0.0;
+}
+
+BenchChain::Hook BenchGap::hook () {
+  return [this](const std::vector<LockKey> &keys, uint64_t) {
+    this->handOver(keys.front());
+  };
+}
+
+int64_t BenchGap::__elapsed () const {
+  return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    BenchClock::now() - this->__origin).count() + 1;
+}
+
+static void printUsage (const char *prog) {
+  std::cerr << "사용법: " << prog << " <벤치마크> [옵션...]" << std::endl;
+  for (auto p = __BENCHES__; p->name != nullptr; p += 1) {
+    std::cerr << "  " << p->name << ": " << p->desc << std::endl;
+  }
+}
+
+int main (const int argc, const char **args) {
+  if (argc < 2) {
+    printUsage(args[0]);
+    return 2;
+  }
+
+  // 스레드를 가진 피어를 많이 띄우는 벤치마크가 있음.
+  ::raiseFileLimit();
+  for (auto p = __BENCHES__; p->name != nullptr; p += 1) {
+    if (std::strcmp(p->name, args[1]) == 0) {
+      return p->func(argc - 1, args + 1);
+    }
+  }
+
+  printUsage(args[0]);
+  return 2;
+}
@@ -1,7 +1,15 @@
+#include "BenchmarkReport.hpp"
+#include "EventLoop.hpp"
+#include "Executor.hpp"
 #include "Globals.hpp"
+#include "Simulator.hpp"
 #include "ThreadContext.hpp"
+#include "Tracer.hpp"
+#include "Transport.hpp"
 
+#include <cerrno>
 #include <csignal>
+#include <cstring>
 #include <getopt.h>
 #include <unistd.h>
 
@@ -11,6 +19,19 @@
 
 static int caughtSignal;
 
+// 기록기가 있으면 남은 기록을 모두 쓰고 닫음. 모든 피어가 멈춘 뒤 부를 것.
+static void closeTracer() {
+  if (::tracer == nullptr) {
+    return;
+  }
+
+  ::tracer->close();
+  std::cerr << "* Traced " << ::tracer->written() << " records ("
+            << ::tracer->dropped() << " dropped)." << std::endl;
+  delete ::tracer;
+  ::tracer = nullptr;
+}
+
 int main(const int argc, const char **args) {
   const auto PROGRAM_START = std::chrono::steady_clock::now();
   const auto signalHandler = [](int SN) { caughtSignal = SN; };
@@ -19,6 +40,25 @@ int main(const int argc, const char **args) {
       {"initial-threads", required_argument, nullptr, 0},
       {"max-acquire-delay", required_argument, nullptr, 0},
       {"max-lock-hold-time", required_argument, nullptr, 0},
+      {"lock-keys", required_argument, nullptr, 0},
+      {"node-id", required_argument, nullptr, 0},
+      {"listen", required_argument, nullptr, 0},
+      {"connect", required_argument, nullptr, 0},
+      {"benchmark", required_argument, nullptr, 0},
+      {"seed", required_argument, nullptr, 0},
+      {"report-format", required_argument, nullptr, 0},
+      {"permission-reuse", no_argument, nullptr, 0},
+      {"lock-engine", required_argument, nullptr, 0},
+      {"simulate", required_argument, nullptr, 0},
+      {"sim-latency", required_argument, nullptr, 0},
+      {"workers", required_argument, nullptr, 0},
+      {"read-ratio", required_argument, nullptr, 0},
+      {"acquire-timeout", required_argument, nullptr, 0},
+      {"lock-handoff", no_argument, nullptr, 0},
+      {"trace", required_argument, nullptr, 0},
+      {"affinity", required_argument, nullptr, 0},
+      {"affinity-scope", required_argument, nullptr, 0},
+      {"spin-wait", required_argument, nullptr, 0},
       {nullptr, 0, nullptr, 0}};
   unsigned int i, nb_initialThreads;
   int ec;
@@ -26,6 +66,15 @@ int main(const int argc, const char **args) {
   bool loopFlag;
   ThreadContext *ctx;
   std::string signalAckMsg, signalName;
+  std::string listenAddr;
+  std::vector<std::string> connectAddrs;
+  double benchmarkDuration = 0.0;
+  double simulateDuration = 0.0;
+  uint32_t simLatency = 100;
+  unsigned int nb_workers = 0;
+  std::chrono::steady_clock::time_point spawnedAt;
+  std::string reportFormat = "json";
+  std::string tracePath;
   std::stringstream ss;
 
   nb_initialThreads = std::thread::hardware_concurrency();
@@ -60,8 +109,81 @@ int main(const int argc, const char **args) {
                     << "--max-lock-hold-time=N:(uint32_t) 스레드가 락을 "
                        "획득했을 때, N ms 이후 "
                        "락을 해제함. 0 <= N < UINT32_MAX"
+                    << std::endl
+                    << "--lock-keys=N:(uint32_t) 피어들이 나눠 쓰는 락의 "
+                       "개수. 기본값 1. 0 < N"
+                    << std::endl
+                    << "--node-id=N:(uint32_t) 이 프로세스의 노드 ID. 노드마다 "
+                       "달라야 함. 기본값 0. 0 <= N <= "
+                    << MAX_NODE_ID << std::endl
+                    << "--listen=ADDR: 다른 노드의 연결을 받을 주소. "
+                       "\"tcp:HOST:PORT\" 또는 \"unix:PATH\""
+                    << std::endl
+                    << "--connect=ADDR: 연결할 노드의 주소. 여러 번 줄 수 "
+                       "있음. 끊기면 다시 연결함."
+                    << std::endl
+                    << "--benchmark=S:(double) S초 동안 돌린 뒤 결과를 표준 "
+                       "출력에 쓰고 끝냄. 시드를 주지 않으면 1로 고정."
+                    << std::endl
+                    << "--seed=N:(uint64_t) 피어의 랜덤 엔진 시드. 주지 않으면 "
+                       "실행마다 다름."
+                    << std::endl
+                    << "--report-format=F: --benchmark 결과 형식. \"json\" "
+                       "또는 \"csv\". 기본값 json"
+                    << std::endl
+                    << "--permission-reuse: 받은 YourLock을 상대가 다시 "
+                       "원할 때까지 재사용함. 모든 노드가 같이 써야 함."
+                    << std::endl
+                    << "--lock-engine=E: 락을 얻는 방식. \"multiphase\"(모든 "
+                       "피어의 허락), \"quorum\"(Maekawa 쿼럼) 또는 "
+                       "\"token\"(Suzuki-Kasami 토큰). 기본값 multiphase. "
+                       "모든 노드가 같이 써야 함."
+                    << std::endl
+                    << "--simulate=S:(double) 스레드 하나에서 가상 시계로 S초를 "
+                       "시뮬레이션한 뒤 --benchmark처럼 결과를 씀. 시드를 주지 "
+                       "않으면 1로 고정. 같은 시드면 같은 결과."
+                    << std::endl
+                    << "--sim-latency=N:(uint32_t) --simulate에서 명령 하나의 "
+                       "최대 전달 지연(us). 기본값 100"
+                    << std::endl
+                    << "--workers=N:(uint) 피어마다 스레드를 띄우지 않고 N개의 "
+                       "작업 스레드에서 피어를 돌림. 0이면 피어마다 스레드. "
+                       "기본값 0"
+                    << std::endl
+                    << "--read-ratio=R:(double) 락을 공유 모드로 얻는 비율. "
+                       "0 <= R <= 1. 기본값 0(모두 배타)"
+                    << std::endl
+                    << "--acquire-timeout=N:(uint32_t) 락을 N ms 안에 얻지 못하면 "
+                       "포기하고 다른 키를 얻으려 함. 0이면 끝까지 기다림. "
+                       "기본값 0"
+                    << std::endl
+                    << "--lock-handoff: multiphase 엔진에서 배타로 가진 락을 "
+                       "놓을 때 기다리는 피어에게 바로 넘김. "
+                       "--permission-reuse와 같이 쓸 수 없음. 모든 노드가 같이 "
+                       "써야 함."
+                    << std::endl
+                    << "--trace=FILE: 명령, 락 요청과 타이머를 FILE에 이진 "
+                       "기록으로 남김. poc-multiphase_lock-trace로 풀어 봄."
+                    << std::endl
+                    << "--affinity=P: 피어의 스레드(--workers면 작업 스레드)를 "
+                       "CPU에 묶는 방식. \"none\", \"round-robin\"(CPU 번호 "
+                       "순), \"compact\"(NUMA 노드를 채워 가며) 또는 "
+                       "\"scatter\"(NUMA 노드를 돌아가며). 기본값 none"
+                    << std::endl
+                    << "--affinity-scope=S: --affinity로 묶는 단위. \"cpu\" "
+                       "또는 \"node\"(그 CPU의 NUMA 노드 전체). 기본값 cpu"
+                    << std::endl
+                    << "--spin-wait=N:(uint32_t) 우편함이 비었을 때 바로 잠들지 "
+                       "않고 최대 N us 동안 명령을 기다리며 돎. 최근 명령 사이의 "
+                       "빈 시간에 맞춰 줄이거나 늘림. 0이면 바로 잠듦. 기본값 0"
                     << std::endl;
           return 0;
+        case 11:
+          ::reusePermissions = true;
+          break;
+        case 18:
+          ::lockHandoff = true;
+          break;
         }
       } else {
         ss.clear();
@@ -77,6 +199,67 @@ int main(const int argc, const char **args) {
         case 3:
           ss >> ::maxLockHoldTime;
           break;
+        case 4:
+          ss >> ::nbLockKeys;
+          break;
+        case 5:
+          ss >> ::nodeID;
+          break;
+        case 6:
+          listenAddr = optarg;
+          break;
+        case 7:
+          connectAddrs.push_back(optarg);
+          break;
+        case 8:
+          ss >> benchmarkDuration;
+          break;
+        case 9:
+          ss >> ::rngSeed;
+          ::fixedSeed = true;
+          break;
+        case 10:
+          reportFormat = optarg;
+          break;
+        case 12:
+          if (!::parseLockEngine(optarg, ::lockEngine)) {
+            std::cerr << "잘못된 'lock-engine' 옵션 값 범위." << std::endl;
+            return 2;
+          }
+          break;
+        case 13:
+          ss >> simulateDuration;
+          break;
+        case 14:
+          ss >> simLatency;
+          break;
+        case 15:
+          ss >> nb_workers;
+          break;
+        case 16:
+          ss >> ::readRatio;
+          break;
+        case 17:
+          ss >> ::acquireTimeout;
+          break;
+        case 19:
+          tracePath = optarg;
+          break;
+        case 20:
+          if (!::parseAffinityPolicy(optarg, ::affinityPolicy)) {
+            std::cerr << "잘못된 'affinity' 옵션 값 범위." << std::endl;
+            return 2;
+          }
+          break;
+        case 21:
+          if (!::parseAffinityScope(optarg, ::affinityScope)) {
+            std::cerr << "잘못된 'affinity-scope' 옵션 값 범위." << std::endl;
+            return 2;
+          }
+          break;
+        case 22:
+          ss >> ::spinWait;
+          break;
         default:
           ::abort();
         }
@@ -99,16 +282,191 @@ int main(const int argc, const char **args) {
     if (::maxLockHoldTime == UINT32_MAX) {
       throw std::string("--max-acquire-delay");
     }
+    if (::nbLockKeys == 0) {
+      throw std::string("--lock-keys");
+    }
+    if (::nodeID > MAX_NODE_ID) {
+      throw std::string("--node-id");
+    }
+    if (benchmarkDuration < 0.0) {
+      throw std::string("--benchmark");
+    }
+    // 시뮬레이션은 다른 노드와 연결하지 않고, 실제 시간으로 돌리지도 않음.
+    if (simulateDuration < 0.0 ||
+        (simulateDuration > 0.0 &&
+         (benchmarkDuration > 0.0 || !listenAddr.empty() ||
+          !connectAddrs.empty()))) {
+      throw std::string("--simulate");
+    }
+    if (nb_workers > 0 && simulateDuration > 0.0) {
+      throw std::string("--workers");
+    }
+    // 시뮬레이션은 스레드 하나에서 돎.
+    if (::affinityPolicy != AFFINITY_NONE && simulateDuration > 0.0) {
+      throw std::string("--affinity");
+    }
+    // 스레드를 가진 피어만 잠듦.
+    if (::spinWait > 0 && (simulateDuration > 0.0 || nb_workers > 0)) {
+      throw std::string("--spin-wait");
+    }
+    if (!(::readRatio >= 0.0 && ::readRatio <= 1.0)) {
+      throw std::string("--read-ratio");
+    }
+    // 재사용하는 허락은 다시 물어보지 않고 쓰므로 넘겨준 피어가 막아 줄 수 없음.
+    if (::lockHandoff && ::reusePermissions) {
+      throw std::string("--lock-handoff");
+    }
+    if (reportFormat != "json" && reportFormat != "csv") {
+      throw std::string("--report-format");
+    }
   } catch (std::string &msg) {
     std::cerr << "잘못된 '" << msg << "' 옵션 값 범위." << std::endl;
     return 2;
   }
 
+  if (!tracePath.empty()) {
+    ::tracer = new Tracer();
+    if (!::tracer->open(tracePath)) {
+      std::cerr << "** '" << tracePath << "' 파일에 기록할 수 없음: "
+                << std::strerror(errno) << std::endl;
+      delete ::tracer;
+      ::tracer = nullptr;
+      return 2;
+    }
+  }
+
+  std::vector<std::atomic<uint32_t>>(::nbLockKeys).swap(::resources);
+  if ((benchmarkDuration > 0.0 || simulateDuration > 0.0) && !::fixedSeed) {
+    ::fixedSeed = true;
+    ::rngSeed = 1;
+  }
+
+  // 가상 시계로 시뮬레이션
+  if (simulateDuration > 0.0) {
+    BenchmarkReport report;
+    Simulator sim(::rngSeed, simLatency);
+    const auto wallStart = std::chrono::steady_clock::now();
+    double wallSeconds;
+
+    // 중단되더라도 이 시드로 다시 돌려 볼 수 있도록 먼저 알림.
+    std::cerr << "* Simulating " << nb_initialThreads << " contexts for "
+              << simulateDuration << "s (seed " << ::rngSeed << ")."
+              << std::endl;
+
+    ::simulator = &sim;
+    {
+      std::vector<ContextID> ids;
+
+      for (i = 0; i < nb_initialThreads; i += 1) {
+        ids.push_back(::makeContextID(::nodeID, ++counter));
+      }
+      sim.spawnAll(ids);
+    }
+    sim.run(std::chrono::duration_cast<Simulator::ClockType::duration>(
+        std::chrono::duration<double>(simulateDuration)));
+
+    report.seconds = simulateDuration;
+    report.seed = ::rngSeed;
+    report.collect();
+    // 피어가 나가며 보내는 명령은 시뮬레이터가 치움.
+    ::clearContexts();
+    ::simulator = nullptr;
+    closeTracer();
+
+    wallSeconds = std::chrono::duration_cast<std::chrono::duration<double>>(
+                      std::chrono::steady_clock::now() - wallStart)
+                      .count();
+    std::cerr << "* Simulated " << simulateDuration << "s in " << wallSeconds
+              << "s (" << sim.steps() << " steps, " << sim.delivered()
+              << " deliveries)." << std::endl;
+
+    if (reportFormat == "csv") {
+      report.writeCSV(std::cout);
+    } else {
+      report.writeJSON(std::cout);
+    }
+
+    return 0;
+  }
+
+  // 다른 노드와 연결
+  if (!listenAddr.empty() || !connectAddrs.empty()) {
+    auto transport = new Transport();
+
+    if (!listenAddr.empty() && !transport->listen(listenAddr)) {
+      std::cerr << "** '" << listenAddr << "' 주소에서 연결을 받을 수 없음: "
+                << std::strerror(errno) << std::endl;
+      delete transport;
+      closeTracer();
+      return 2;
+    }
+    for (const auto &addr : connectAddrs) {
+      if (!transport->connect(addr)) {
+        std::cerr << "** 잘못된 주소 형식: '" << addr << "'" << std::endl;
+        delete transport;
+        closeTracer();
+        return 2;
+      }
+    }
+    if (!transport->start()) {
+      std::cerr << "** 전송 계층을 시작할 수 없음: " << std::strerror(errno)
+                << std::endl;
+      delete transport;
+      closeTracer();
+      return 2;
+    }
+    ::transport = transport;
+  }
+
+  if (nb_workers > 0) {
+    ::executor = new Executor(nb_workers);
+  } else {
+    // 피어마다 `EventLoop`의 fd를 셋 씀.
+    ::raiseFileLimit();
+  }
+
   // 스레드 생성
-  for (i = 0; i < nb_initialThreads; i += 1) {
-    ctx = new ThreadContext();
-    ctx->start(++counter);
-    ::addContext(ctx);
+  spawnedAt = std::chrono::steady_clock::now();
+  {
+    std::vector<ThreadContext*> ctxs;
+
+    for (i = 0; i < nb_initialThreads; i += 1) {
+      ctx = new ThreadContext();
+      ctx->start(::makeContextID(::nodeID, ++counter));
+      ctxs.push_back(ctx);
+    }
+    ::addContexts(ctxs);
+  }
+
+  if (benchmarkDuration > 0.0) {
+    BenchmarkReport report;
+
+    std::this_thread::sleep_for(
+        std::chrono::duration<double>(benchmarkDuration));
+    report.seconds = std::chrono::duration_cast<std::chrono::duration<double>>(
+                         std::chrono::steady_clock::now() - spawnedAt)
+                         .count();
+    report.seed = ::rngSeed;
+    report.collect();
+
+    ::clearContexts();
+    if (::transport != nullptr) {
+      delete ::transport;
+      ::transport = nullptr;
+    }
+    if (::executor != nullptr) {
+      delete ::executor;
+      ::executor = nullptr;
+    }
+    closeTracer();
+
+    if (reportFormat == "csv") {
+      report.writeCSV(std::cout);
+    } else {
+      report.writeJSON(std::cout);
+    }
+
+    return 0;
   }
 
   loopFlag = true;
@@ -155,10 +513,88 @@ int main(const int argc, const char **args) {
                     .count()
              << "s." << std::endl;
 
-          ss << "[Lock Acquire Count]" << std::endl;
-          for (const auto &p : ::threads) {
-            ss << p.second->id() << ": " << p.second->acquiredCount()
-               << std::endl;
+          {
+            uint64_t acquired = 0, mallocs = 0;
+            uint64_t batches = 0, processed = 0, wakeups = 0, syscalls = 0;
+            uint64_t spinHits = 0, spinMisses = 0;
+            LatencyHistogram latency;
+
+            ss << "[Lock Acquire Count]" << std::endl;
+            ::forEachContext([&](ThreadContext *ctx) {
+              ss << ctx->id() << ": " << ctx->acquiredCount();
+              if (ctx->latency().count() > 0) {
+                ss << " (p99 " << ctx->latency().percentile(0.99) << "us)";
+              }
+              ss << std::endl;
+              acquired += ctx->acquiredCount();
+              mallocs += ctx->mallocCount();
+              batches += ctx->batchCount();
+              processed += ctx->processedCount();
+              wakeups += ctx->wakeupCount();
+              syscalls += ctx->syscallCount();
+              spinHits += ctx->spinHitCount();
+              spinMisses += ctx->spinMissCount();
+              latency.merge(ctx->latency());
+            });
+
+            if (batches > 0) {
+              ss << "[Average Batch Size] "
+                 << (double)processed / (double)batches << std::endl;
+            }
+            // 작업 스레드에서 도는 피어는 스스로 잠들지 않음.
+            if (processed > 0 && ::executor == nullptr) {
+              ss << "[Wakeups Per Command] "
+                 << (double)wakeups / (double)processed << std::endl
+                 << "[Syscalls Per Command] "
+                 << (double)syscalls / (double)processed << std::endl;
+            }
+            // 빈 시간이 길면 돌지 않으므로 0번일 수 있음.
+            if (::spinWait > 0) {
+              ss << "[Spin Hit Ratio] "
+                 << (spinHits + spinMisses > 0
+                         ? (double)spinHits / (double)(spinHits + spinMisses)
+                         : 0.0)
+                 << " (" << spinHits + spinMisses << " spins)" << std::endl;
+            }
+
+            ss << "[Malloc Per Acquisition] ";
+            if (acquired == 0) {
+              ss << '-';
+            } else {
+              ss << (double)mallocs / (double)acquired;
+            }
+            ss << std::endl;
+
+            if (latency.count() > 0) {
+              ss << "[Acquire Latency] avg " << latency.mean() << "us, p50 "
+                 << latency.percentile(0.5) << "us, p99 "
+                 << latency.percentile(0.99) << "us, max " << latency.max()
+                 << "us" << std::endl;
+            }
+
+            if (::executor != nullptr) {
+              ss << "[Executor] " << ::executor->size() << " workers, "
+                 << ::executor->steals() << " steals" << std::endl;
+            }
+
+            if (::transport != nullptr) {
+              ss << "[Connections]" << std::endl;
+              for (const auto &st : ::transport->stats()) {
+                ss << "node " << st.node << ": ";
+                if (!st.connected) {
+                  ss << "disconnected" << std::endl;
+                  continue;
+                }
+                ss << (double)st.txFrames / st.seconds << " tx/s, "
+                   << (double)st.rxFrames / st.seconds << " rx/s, ";
+                if (st.writes == 0) {
+                  ss << '-';
+                } else {
+                  ss << (double)st.txFrames / (double)st.writes;
+                }
+                ss << " frames/writev" << std::endl;
+              }
+            }
           }
 
           signalAckMsg = ss.str();
@@ -173,16 +609,19 @@ int main(const int argc, const char **args) {
           ss.str("");
 
           ctx = new ThreadContext();
-          ctx->start(++counter);
+          ctx->start(::makeContextID(::nodeID, ++counter));
           ::addContext(ctx);
           break;
-        case 2:
-          if (::threads.empty()) {
+        case 2: {
+          const auto ids = ::contextIDs();
+
+          if (ids.empty()) {
             ss << signalName << " caught, but no context to delete.";
           } else {
             ss << signalName << " caught. Deleting one context ...";
 
-            ctx = ::popContext(::threads.begin()->first);
+            ::retireContext(ids.front());
+            ctx = ::popContext(ids.front());
             delete ctx;
           }
           signalAckMsg = ss.str();
@@ -190,6 +629,7 @@ int main(const int argc, const char **args) {
           ss.str("");
           break;
         }
+        }
       }
     }
 
@@ -202,10 +642,16 @@ int main(const int argc, const char **args) {
     }
   } while (loopFlag);
 
-  for (const auto &p : ::threads) {
-    delete ::popContext(p.first);
+  ::clearContexts();
+  if (::transport != nullptr) {
+    delete ::transport;
+    ::transport = nullptr;
+  }
+  if (::executor != nullptr) {
+    delete ::executor;
+    ::executor = nullptr;
   }
-  ::threads.clear();
+  closeTracer();
 
   return ec;
 }
@@ -0,0 +1,281 @@
+// `--trace`로 남긴 기록 파일을 풀어 봄. 기본으로는 락을 얻으려 할 때마다 한 줄씩,
+// 기다린 시간과 가진 시간, 그동안 주고받은 메시지 수를 CSV로 출력한다.
+#include "../Tracer.hpp"
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+static const char *__TYPE_NAMES__[] = {
+  "send", "recv", "request", "acquired", "released", "abandoned", "timeout",
+  "timers", "report"};
+
+static const char *__OP_NAMES__[] = {
+  "SHUTDOWN", "THREAD_SPAWNED", "THREAD_DESPAWNED", "MY_LOCK", "YOUR_LOCK",
+  "LOCK_RESET", "QUORUM_REQUEST", "QUORUM_GRANT", "QUORUM_FAILED",
+  "QUORUM_INQUIRE", "QUORUM_RELINQUISH", "QUORUM_RELEASE", "TOKEN_REQUEST",
+  "TOKEN", "TOKEN_PROBE", "TOKEN_PROBE_ACK", "TOKEN_KEEP", "TOKEN_DROP", "CALL",
+  "LOCK_WAITING", "LOCK_HANDOFF", "LOCK_PASSED", "MEMBERSHIP_VIEW"};
+
+static const char *__typeName (const uint8_t type) {
+  if (type < sizeof(__TYPE_NAMES__) / sizeof(__TYPE_NAMES__[0])) {
+    return __TYPE_NAMES__[type];
+  }
+  return "?";
+}
+
+static const char *__opName (const uint8_t op) {
+  if (op < sizeof(__OP_NAMES__) / sizeof(__OP_NAMES__[0])) {
+    return __OP_NAMES__[op];
+  }
+  return "?";
+}
+
+// 락을 얻으려 한 번. 얻기 전에는 `acquiredAt`이 0.
+struct __Acquisition {
+  uint32_t mode;
+  uint64_t requestedAt;
+  uint64_t acquiredAt;
+  uint64_t sent;
+  uint64_t received;
+  bool timedOut;
+};
+
+// 나머지 피어와 주고받는 명령. 락과 상관없는 명령은 세지 않음.
+static bool __isLockMessage (const uint8_t op) {
+  switch (op) {
+  case OPC_SHUTDOWN:
+  case OPC_THREAD_SPAWNED:
+  case OPC_THREAD_DESPAWNED:
+  case OPC_CALL:
+  case OPC_MEMBERSHIP_VIEW:
+    return false;
+  default:
+    return true;
+  }
+}
+
+static bool __load (const std::string &path, TraceHeader &header,
+                    std::vector<TraceRecord> &records) {
+  FILE *f = std::fopen(path.c_str(), "rb");
+  size_t n;
+
+  if (f == nullptr) {
+    std::cerr << "** '" << path << "' 파일을 열 수 없음: "
+              << std::strerror(errno) << std::endl;
+    return false;
+  }
+  if (std::fread(&header, sizeof(header), 1, f) != 1 ||
+      std::memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != TRACE_VERSION ||
+      header.recordSize != sizeof(TraceRecord)) {
+    std::cerr << "** '" << path << "' 기록 파일 형식이 아님." << std::endl;
+    std::fclose(f);
+    return false;
+  }
+
+  records.resize(header.records);
+  n = std::fread(records.data(), sizeof(TraceRecord), records.size(), f);
+  std::fclose(f);
+  if (n < records.size()) {
+    std::cerr << "* '" << path << "' 파일이 잘림. " << n << '/'
+              << records.size() << "개만 읽음." << std::endl;
+    records.resize(n);
+  }
+
+  // 스레드마다 링에 따로 모았으므로 시각 순서대로 합침.
+  std::stable_sort(records.begin(), records.end(),
+                   [](const TraceRecord &a, const TraceRecord &b) {
+                     return a.ns < b.ns;
+                   });
+  return true;
+}
+
+static void __dumpEvents (const std::vector<TraceRecord> &records,
+                          const uint64_t origin) {
+  std::cout << "ns,ctx,type,peer,key,op,arg" << std::endl;
+  for (const auto &r : records) {
+    const bool isCommand = r.type == TRACE_SEND || r.type == TRACE_RECV;
+
+    std::cout << r.ns - origin << ',' << r.ctx << ',' << __typeName(r.type)
+              << ',' << r.peer << ',' << r.key << ','
+              << (isCommand ? __opName(r.op) : "") << ',' << r.arg << std::endl;
+  }
+}
+
+static double __percentile (std::vector<uint64_t> &v, const double p) {
+  size_t i;
+
+  if (v.empty()) {
+    return 0.0;
+  }
+  i = (size_t)(p * (double)(v.size() - 1));
+  std::nth_element(v.begin(), v.begin() + i, v.end());
+  return (double)v[i];
+}
+
+static void __dumpAcquisitions (const std::vector<TraceRecord> &records,
+                                const uint64_t origin) {
+  std::map<std::pair<ContextID, LockKey>, __Acquisition> open;
+  std::map<std::string, uint64_t> outcomes;
+  std::vector<uint64_t> waits;
+  uint64_t holdSum = 0, messages = 0, reports = 0, timeouts = 0;
+
+  const auto emit = [&](const std::pair<ContextID, LockKey> &id,
+                        const __Acquisition &a, const uint64_t endAt,
+                        const char *outcome) {
+    const bool acquired = a.acquiredAt > 0;
+
+    std::cout << id.first << ',' << id.second << ','
+              << (a.mode == LOCK_SHARED ? "shared" : "exclusive") << ','
+              << a.requestedAt - origin << ',';
+    if (acquired) {
+      std::cout << a.acquiredAt - a.requestedAt << ',';
+    } else {
+      std::cout << ',';
+    }
+    if (acquired && endAt > 0) {
+      std::cout << endAt - a.acquiredAt;
+    }
+    std::cout << ',' << a.sent << ',' << a.received << ',' << outcome
+              << std::endl;
+
+    outcomes[outcome] += 1;
+    if (acquired) {
+      waits.push_back(a.acquiredAt - a.requestedAt);
+      if (endAt > 0) {
+        holdSum += endAt - a.acquiredAt;
+      }
+    }
+  };
+
+  std::cout << "ctx,key,mode,request_ns,wait_ns,hold_ns,sent,received,outcome"
+            << std::endl;
+  for (const auto &r : records) {
+    const auto id = std::make_pair(r.ctx, r.key);
+    auto it = open.find(id);
+
+    switch (r.type) {
+    case TRACE_SEND:
+    case TRACE_RECV:
+      if (!__isLockMessage(r.op)) {
+        break;
+      }
+      messages += 1;
+      if (it != open.end()) {
+        (r.type == TRACE_SEND ? it->second.sent : it->second.received) += 1;
+      }
+      break;
+    case TRACE_REQUEST:
+      // 한꺼번에 얻지 못해 하나씩 다시 요청하면 앞의 것을 덮어씀.
+      open[id] = __Acquisition{r.arg, r.ns, 0, 0, 0, false};
+      break;
+    case TRACE_ACQUIRED:
+      if (it != open.end()) {
+        it->second.acquiredAt = r.ns;
+      }
+      break;
+    case TRACE_RELEASED:
+      if (it != open.end()) {
+        emit(id, it->second, r.ns, "released");
+        open.erase(it);
+      }
+      break;
+    case TRACE_ABANDONED:
+      if (it != open.end()) {
+        emit(id, it->second, 0, it->second.timedOut ? "timeout" : "abandoned");
+        open.erase(it);
+      }
+      break;
+    case TRACE_TIMEOUT:
+      timeouts += 1;
+      if (it != open.end()) {
+        it->second.timedOut = true;
+      }
+      break;
+    case TRACE_REPORT:
+      reports += 1;
+      break;
+    }
+  }
+  // 기록이 끝날 때까지 놓지 않았거나 얻지 못함.
+  for (const auto &p : open) {
+    emit(p.first, p.second, 0, "open");
+  }
+
+  std::cerr << "* " << waits.size() << " acquisitions, " << messages
+            << " lock messages, " << timeouts << " timeouts, " << reports
+            << " reports." << std::endl;
+  for (const auto &p : outcomes) {
+    std::cerr << "*   " << p.first << ": " << p.second << std::endl;
+  }
+  if (!waits.empty()) {
+    const auto released = outcomes["released"];
+
+    std::cerr << "* wait p50 " << __percentile(waits, 0.5) / 1000.0
+              << "us, p99 " << __percentile(waits, 0.99) / 1000.0
+              << "us, max " << __percentile(waits, 1.0) / 1000.0
+              << "us; mean hold "
+              << (released > 0 ? (double)holdSum / (double)released / 1000.0
+                               : 0.0)
+              << "us." << std::endl;
+  }
+}
+
+int main (const int argc, const char **args) {
+  static const option __OPTS__[] = {
+    {"help", no_argument, nullptr, 0},
+    {"events", no_argument, nullptr, 0},
+    {nullptr, 0, nullptr, 0}};
+  TraceHeader header;
+  std::vector<TraceRecord> records;
+  bool events = false;
+  int opt_index, opt_char;
+
+  while ((opt_char = getopt_long_only(argc, (char **)args, "", __OPTS__,
+                                      &opt_index)) >= 0) {
+    if (opt_char == '?') {
+      return 2;
+    }
+
+    switch (opt_index) {
+    case 0:
+      std::cerr << "사용법: " << args[0] << " [옵션...] <기록 파일>" << std::endl
+                << "--help: 이 메시지를 출력." << std::endl
+                << "--events: 락마다 묶지 않고 모든 기록을 시각 순서대로 출력."
+                << std::endl;
+      return 0;
+    case 1:
+      events = true;
+      break;
+    }
+  }
+  if (optind + 1 != argc) {
+    std::cerr << "사용법: " << args[0] << " [옵션...] <기록 파일>" << std::endl;
+    return 2;
+  }
+
+  if (!__load(args[optind], header, records)) {
+    return 2;
+  }
+  std::cerr << "* " << records.size() << " records (" << header.dropped
+            << " dropped)." << std::endl;
+  if (records.empty()) {
+    return 0;
+  }
+
+  if (events) {
+    __dumpEvents(records, records.front().ns);
+  } else {
+    __dumpAcquisitions(records, records.front().ns);
+  }
+
+  return 0;
+}